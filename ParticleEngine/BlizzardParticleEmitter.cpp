@@ -3,9 +3,18 @@
 
 using namespace DirectX::SimpleMath;
 
-BlizzardParticleEmitter::BlizzardParticleEmitter(ParticleWorld* particleWorld, const std::vector<ParticleManagement*>& manageParticlesInThis, const DirectX::SimpleMath::Vector3& gravity, const DirectX::SimpleMath::Vector3& position, const float& rotationSpeed)
-	: m_particleWorld(particleWorld), m_manageParticlesInThis(manageParticlesInThis), m_position(position), m_gravity(gravity), m_rotationSpeed(rotationSpeed)
+BlizzardParticleEmitter::BlizzardParticleEmitter(ParticleWorld* particleWorld, const std::vector<ParticleManagement*>& manageParticlesInThis, const DirectX::SimpleMath::Vector3& gravity, const DirectX::SimpleMath::Vector3& position, const float& rotationSpeed, const unsigned& seed)
+	: ParticleEmitter(particleWorld, manageParticlesInThis, seed), m_rotationSpeed(rotationSpeed)
 {
+	SetRate(60);
+	SetPoint(position);
+	SetBallistic(true);
+
+	m_prototype.SetMass(0.0001);
+	m_prototype.SetWorldSpaceRadius(2);
+	m_prototype.SetAcceleration(gravity);
+	m_prototype.SetBouncinessFactor(0.0001f);
+	m_prototype.SetType(ParticleTypes::Snow);
 }
 
 BlizzardParticleEmitter::~BlizzardParticleEmitter()
@@ -16,39 +25,22 @@ void BlizzardParticleEmitter::Update(const float& deltaTime)
 {
 	Matrix rotationMatrix = Matrix::CreateRotationZ(DirectX::XMConvertToRadians(m_rotationSpeed*deltaTime));
 	m_currentEmitDirection = Vector3::Transform(m_currentEmitDirection, rotationMatrix);
+	SetVelocity(m_currentEmitDirection, 0, 35, 35);
 
-	emitParticle();
+	ParticleEmitter::Update(deltaTime);
 }
+
 void BlizzardParticleEmitter::SetPosition(const DirectX::SimpleMath::Vector3& position)
 {
-	m_position = position;
+	SetPoint(position);
 }
 
 void BlizzardParticleEmitter::SetGravity(const DirectX::SimpleMath::Vector3& gravity)
 {
-	m_gravity = gravity;
+	m_prototype.SetAcceleration(gravity);
 }
 
 void BlizzardParticleEmitter::SetRotationSpeed(const float& rotationSpeed)
 {
 	m_rotationSpeed = rotationSpeed;
 }
-
-void BlizzardParticleEmitter::emitParticle()
-{
-	Particle* particle = m_particleWorld->GetNewParticle();
-	if (!particle)
-		return;
-	particle->SetPosition(m_position);
-	particle->SetMass(0.0001);
-	particle->SetWorldSpaceRadius(2);
-	particle->SetVelocity(m_currentEmitDirection*35);
-	particle->SetAcceleration(m_gravity);
-	particle->SetBouncinessFactor(0.0001f);
-	particle->SetType(ParticleTypes::Snow);
-
-	for(auto& particleManager : m_manageParticlesInThis)
-	{
-		particleManager->AddParticle(particle);
-	}
-}
@@ -21,6 +21,7 @@ Game::Game()
 Game::~Game()
 {
 	delete m_particleRenderer;
+	delete m_rewindRecorder;
 	delete m_particleWorld;
 	for (ParticleForceGenerator* forceGenerator : m_particleForceGenerators)
 	{
@@ -67,6 +68,34 @@ void Game::Initialize(HWND window, int width, int height)
 	LevelBounds bounds{ -(width*10), (width*10), -height, (height*2) };
 
 	m_particleWorld = new ParticleWorld(50000, 5000, bounds);
+	m_particleWorld->SetContactResolutionTolerance(0.01f, 0.01f);
+	m_particleWorld->SetContactResolutionBudget(0.004f);
+	m_particleWorld->SetParticleReorderLocalityThreshold(0.5f);
+	m_particleWorld->SetLodEnabled(true);
+	m_particleWorld->SetLodTypeEnabled(ParticleTypes::Ball, false);
+	m_particleWorld->SetLodTypeEnabled(ParticleTypes::Cloth, false);
+
+	// The blizzard must never starve the balls and the cloth: snow makes
+	// room among its oldest flakes once it has its share of the pool,
+	// balls have slots of their own and recycle the snow furthest away
+	ParticlePoolPolicy snowPolicy;
+	snowPolicy.Quota = 4500;
+	snowPolicy.OnExhausted = ParticlePoolExhaustionPolicy::RecycleOldest;
+	m_particleWorld->SetPoolPolicy(ParticleTypes::Snow, snowPolicy);
+	ParticlePoolPolicy ballPolicy;
+	ballPolicy.Reserved = 200;
+	ballPolicy.Priority = 1;
+	ballPolicy.OnExhausted = ParticlePoolExhaustionPolicy::RecycleFurthest;
+	m_particleWorld->SetPoolPolicy(ParticleTypes::Ball, ballPolicy);
+	ParticlePoolPolicy clothPolicy;
+	clothPolicy.Priority = 2;
+	m_particleWorld->SetPoolPolicy(ParticleTypes::Cloth, clothPolicy);
+	// Blows on every particle while E is held
+	ParticleForceField fan;
+	fan.Acceleration = m_fanAcceleration*static_cast<float>(m_fanAccelerationMultiplier);
+	fan.Enabled = false;
+	m_fanField = m_particleWorld->AddForceField(fan);
+	m_rewindRecorder = new ParticleRewindRecorder(m_particleWorld, m_rewindMemoryBudget);
 	m_particleRenderer = new ParticleRenderer(Colors::White);
 	m_particleRenderer->Initialize(m_deviceResources->GetD3DDevice(), m_deviceResources->GetD3DDeviceContext(), m_particleWorld);
 
@@ -75,6 +104,7 @@ void Game::Initialize(HWND window, int width, int height)
 	createFlyingPlatformsAndContactGenerator();
 	createSlopePlatformAndContactGenerator(cameraLevelBounds);
 	createParticleVsParticleContactGenerator();
+	createSnowDepositContactGenerator(cameraLevelBounds);
 	createBlizzardParticleEmitter(cameraLevelBounds);
 }
 
@@ -101,6 +131,19 @@ void Game::Update(DX::StepTimer const& timer)
 	if (kb.Escape)
 		PostQuitMessage(0);
 
+	// Steps back one recorded frame per update instead of running the
+	// world, which records on from there once R is let go
+	if (kb.IsKeyDown(Keyboard::Keys::R))
+	{
+		if (m_rewindFrame < 0)
+			m_rewindFrame = m_rewindRecorder->GetLastFrame();
+		if (m_rewindFrame > m_rewindRecorder->GetFirstFrame())
+			m_rewindRecorder->Restore(--m_rewindFrame);
+		m_camera.UpdateViewMatrix();
+		return;
+	}
+	m_rewindFrame = -1;
+
 	checkAndProcessKeyboardInput(elapsedTime);
 	checkAndProcessMouseInput(elapsedTime);
 
@@ -109,7 +152,14 @@ void Game::Update(DX::StepTimer const& timer)
 		blizzard->Update(elapsedTime);
 	}
 
+	// Full detail for what the camera shows
+	const Vector3 cameraPosition = m_camera.GetPosition();
+	const D3D11_VIEWPORT viewport = m_deviceResources->GetScreenViewport();
+	m_particleWorld->SetLodView(LevelBounds{ cameraPosition.x - viewport.Width / 2, cameraPosition.x + viewport.Width / 2,
+		cameraPosition.y - viewport.Height / 2, cameraPosition.y + viewport.Height / 2 });
+
 	m_particleWorld->RunPhysics(elapsedTime);
+	m_rewindRecorder->Capture();
 
 	m_camera.UpdateViewMatrix();
 }
@@ -120,58 +170,81 @@ void Game::checkAndProcessKeyboardInput(const float& deltaTime)
 	if (kb.Escape)
 		PostQuitMessage(0);
 
+	// The world applies the commands when the physics step starts
+	ParticleCommandBuffer& commands = m_particleWorld->GetCommandBuffer();
 	if(kb.IsKeyDown(Keyboard::Keys::F1))
 	{
-		m_particleWorld->DestroyAllSnow();
+		commands.DespawnAll(ParticleTypes::Snow);
+		m_snowDeposit->Clear();
 	}
 	if (kb.IsKeyDown(Keyboard::Keys::F2))
 	{
-		m_particleWorld->DestroyAllBalls();
+		commands.DespawnAll(ParticleTypes::Ball);
+	}
+
+	static bool f3Down = false;
+	if (kb.IsKeyDown(Keyboard::Keys::F3) && !f3Down)
+	{
+		f3Down = true;
+		m_particleWorld->SetContactResolverMode(m_particleWorld->GetContactResolverMode() == ParticleContactResolverMode::Iterative ?
+			ParticleContactResolverMode::GraphColored : ParticleContactResolverMode::Iterative);
+	}
+	else if (kb.IsKeyUp(Keyboard::Keys::F3))
+		f3Down = false;
+
+	static bool f5Down = false;
+	if (kb.IsKeyDown(Keyboard::Keys::F5) && !f5Down)
+	{
+		f5Down = true;
+		ParticleBenchmark::RunAll();
 	}
+	else if (kb.IsKeyUp(Keyboard::Keys::F5))
+		f5Down = false;
+
+	static bool f6Down = false;
+	if (kb.IsKeyDown(Keyboard::Keys::F6) && !f6Down)
+	{
+		f6Down = true;
+		m_particleWorld->SaveSnapshot(m_snapshot);
+		ParticleSnapshotFile::Write(m_snapshotPath, m_snapshot);
+	}
+	else if (kb.IsKeyUp(Keyboard::Keys::F6))
+		f6Down = false;
+
+	static bool f7Down = false;
+	if (kb.IsKeyDown(Keyboard::Keys::F7) && !f7Down)
+	{
+		f7Down = true;
+		ParticleSnapshotFile snapshotFile;
+		if (snapshotFile.Open(m_snapshotPath))
+			m_particleWorld->RestoreSnapshot(snapshotFile.GetData(), snapshotFile.GetSize());
+	}
+	else if (kb.IsKeyUp(Keyboard::Keys::F7))
+		f7Down = false;
 
 	static bool qDown = false;
 	if (kb.IsKeyDown(Keyboard::Keys::Q) && !qDown)
 	{
 		qDown = true;
+		Particle ball;
+		ball.SetMass(10);
+		ball.SetAcceleration(m_gravity);
+		ball.SetWorldSpaceRadius(ball.GetMass());
+		ball.SetBouncinessFactor(0.2f);
+		ball.SetType(ParticleTypes::Ball);
 		for (int i = 1; i <= 20; ++i)
 		{
-			Particle* particle = m_particleWorld->GetNewParticle();
-			particle->SetPosition(Vector3(-330, 300, 0) + Vector3::UnitX * static_cast<float>(i)*30.f);
-			particle->SetMass(10);
-			particle->SetVelocity(Vector3::Down *(rand() % 300) + Vector3::Left *(rand() % 100) + Vector3::Right *(rand() % 100));
-			particle->SetAcceleration(m_gravity);
-			particle->SetWorldSpaceRadius(particle->GetMass());
-			particle->SetBouncinessFactor(0.2f);
-			particle->SetType(ParticleTypes::Ball);
-			for (ParticleContactGenerator* particleGenerator : m_particleContactGenerators)
-			{
-				particleGenerator->AddParticle(particle);
-			}
+			ball.SetPosition(Vector3(-330, 300, 0) + Vector3::UnitX * static_cast<float>(i)*30.f);
+			ball.SetVelocity(Vector3::Down *(rand() % 300) + Vector3::Left *(rand() % 100) + Vector3::Right *(rand() % 100));
+			commands.Spawn(ball);
 		}
 	}
 	else if (kb.IsKeyUp(Keyboard::Keys::Q))
 		qDown = false;
 
 	static bool eDown = false;
-	if (kb.IsKeyDown(Keyboard::Keys::E))
-	{
-		eDown = true;
-
-		for(auto particle : m_particleWorld->GetActiveParticles())
-		{
-			particle->SetAcceleration((particle->GetType() == ParticleTypes::Snow ? m_snowGravity : m_gravity) + m_fanAcceleration*m_fanAccelerationMultiplier);
-		}
-	}
-	else if (kb.IsKeyUp(Keyboard::Keys::E)&& eDown)
-	{
-		for (auto particle : m_particleWorld->GetActiveParticles())
-		{
-			particle->SetAcceleration(particle->GetType() == ParticleTypes::Snow ? m_snowGravity : m_gravity);
-		}
-		eDown = false;
-	}
-
-
+	const bool fanOn = kb.IsKeyDown(Keyboard::Keys::E);
+	const int fanAccelerationMultiplier = m_fanAccelerationMultiplier;
 	if (kb.IsKeyDown(Keyboard::Keys::Up))
 	{
 		++m_fanAccelerationMultiplier;
@@ -180,11 +253,42 @@ void Game::checkAndProcessKeyboardInput(const float& deltaTime)
 	{
 		--m_fanAccelerationMultiplier;
 	}
+
+	if (fanOn != eDown || fanAccelerationMultiplier != m_fanAccelerationMultiplier)
+	{
+		eDown = fanOn;
+		ParticleForceField fan;
+		fan.Acceleration = m_fanAcceleration*static_cast<float>(m_fanAccelerationMultiplier);
+		fan.Enabled = fanOn;
+		commands.SetForceField(m_fanField, fan);
+	}
 }
 
 void Game::checkAndProcessMouseInput(const float& deltaTime)
 {
 	auto mouse = m_mouse->GetState();
+	if (!mouse.leftButton)
+		return;
+
+	// The orthographic camera shows one unit per pixel around its position
+	const Vector3 cameraPosition = m_camera.GetPosition();
+	const D3D11_VIEWPORT viewport = m_deviceResources->GetScreenViewport();
+	const Vector3 cursor(cameraPosition.x + mouse.x - viewport.Width / 2, cameraPosition.y + viewport.Height / 2 - mouse.y, 0);
+
+	m_pushedParticles.clear();
+	m_particleWorld->QueryRadius(cursor, m_pushRadius, m_pushedParticles);
+	ParticleCommandBuffer& commands = m_particleWorld->GetCommandBuffer();
+	for (Particle* particle : m_pushedParticles)
+	{
+		Vector3 away = particle->GetPosition() - cursor;
+		away.z = 0;
+		const float distance = away.Length();
+		if (distance <= 0)
+			continue;
+		// Strongest at the cursor, fading out towards the edge
+		const float falloff = 1 - distance / m_pushRadius;
+		commands.AddParticleVelocity(particle, away / distance * (m_pushAcceleration * falloff * deltaTime));
+	}
 }
 
 #pragma endregion
@@ -359,7 +463,7 @@ void Game::createClothParticle()
 		ParticleAnchoredFakeStiffSpringForceGenerator* anchoredSpringForceGenerator = new ParticleAnchoredFakeStiffSpringForceGenerator(&m_particleAnchor[x], springConstant, damping);
 		m_particleForceGenerators.push_back(anchoredSpringForceGenerator);
 
-		Particle* anchoredSpringParticle = m_particleWorld->GetNewParticle();
+		Particle* anchoredSpringParticle = m_particleWorld->GetNewParticle(ParticleTypes::Cloth);
 		anchoredSpringParticle->SetPosition(m_particleAnchor[x]);
 		anchoredSpringParticle->SetMass(10);
 		anchoredSpringParticle->SetAcceleration(m_gravity);
@@ -375,7 +479,7 @@ void Game::createClothParticle()
 			ParticleFakeStiffSpringForceGenerator* gen1 = new ParticleFakeStiffSpringForceGenerator(particle[x][y - 1], springConstant / 2, damping);
 			m_particleForceGenerators.push_back(gen1);
 
-			Particle* springParticle = m_particleWorld->GetNewParticle();
+			Particle* springParticle = m_particleWorld->GetNewParticle(ParticleTypes::Cloth);
 			springParticle->SetPosition(m_particleAnchor[x] + Vector3::Down * 30 * y);
 			springParticle->SetMass(10);
 			springParticle->SetAcceleration(m_gravity);
@@ -426,7 +530,7 @@ void Game::createLevelBoundPlatformsAndContactGenerator(Vector2 cameraLevelBound
 		ParticlePlatformContactsGenerator* platformContactsGenerator = new ParticlePlatformContactsGenerator(levelBoundPlatformStartEnd[i][0], levelBoundPlatformStartEnd[i][1]);
 		platformContactsGenerator->AddParticle(m_particleWorld->GetActiveParticles());
 		m_particleContactGenerators.push_back(platformContactsGenerator);
-		m_particleWorld->GetContactGenerators().push_back(platformContactsGenerator);
+		m_particleWorld->AddContactGenerator(platformContactsGenerator);
 	}
 }
 
@@ -446,7 +550,7 @@ void Game::createFlyingPlatformsAndContactGenerator()
 		ParticlePlatformContactsGenerator* platformContactsGenerator = new ParticlePlatformContactsGenerator(flyingPlatformStartEnd[i][0], flyingPlatformStartEnd[i][1]);
 		platformContactsGenerator->AddParticle(m_particleWorld->GetActiveParticles());
 		m_particleContactGenerators.push_back(platformContactsGenerator);
-		m_particleWorld->GetContactGenerators().push_back(platformContactsGenerator);
+		m_particleWorld->AddContactGenerator(platformContactsGenerator);
 	}
 }
 
@@ -461,15 +565,32 @@ void Game::createSlopePlatformAndContactGenerator(Vector2 cameraLevelBounds)
 	ParticlePlatformContactsGenerator* platformContactsGenerator = new ParticlePlatformContactsGenerator(slopePlatformStartEnd[0], slopePlatformStartEnd[1]);
 	platformContactsGenerator->AddParticle(m_particleWorld->GetActiveParticles());
 	m_particleContactGenerators.push_back(platformContactsGenerator);
-	m_particleWorld->GetContactGenerators().push_back(platformContactsGenerator);
+	m_particleWorld->AddContactGenerator(platformContactsGenerator);
 }
 
 void Game::createParticleVsParticleContactGenerator()
 {
 	ParticleParticleContactGenerator* particleContactGenerator = new ParticleParticleContactGenerator();
+	particleContactGenerator->SetNeighbourListEnabled(true);
+	particleContactGenerator->SetNeighbourListSkin(4.f);
 	particleContactGenerator->AddParticle(m_particleWorld->GetActiveParticles());
 	m_particleContactGenerators.push_back(particleContactGenerator);
-	m_particleWorld->GetContactGenerators().push_back(particleContactGenerator);
+	m_particleWorld->AddContactGenerator(particleContactGenerator);
+}
+
+void Game::createSnowDepositContactGenerator(Vector2 cameraLevelBounds)
+{
+	m_snowDeposit = new ParticleSnowDeposit(-cameraLevelBounds.x, cameraLevelBounds.x, 4.f);
+	for (ParticleContactGenerator* contactGenerator : m_particleContactGenerators)
+	{
+		ParticlePlatformContactsGenerator* platformContactsGenerator = dynamic_cast<ParticlePlatformContactsGenerator*>(contactGenerator);
+		if (platformContactsGenerator)
+			m_snowDeposit->AddSupport(platformContactsGenerator);
+	}
+	m_snowDeposit->AddParticle(m_particleWorld->GetActiveParticles());
+	m_particleContactGenerators.push_back(m_snowDeposit);
+	m_particleWorld->AddContactGenerator(m_snowDeposit);
+	m_particleRenderer->SetSnowDeposit(m_snowDeposit);
 }
 
 void Game::createBlizzardParticleEmitter(Vector2 cameraLevelBounds)
@@ -480,6 +601,6 @@ void Game::createBlizzardParticleEmitter(Vector2 cameraLevelBounds)
 		manageParticleIn.push_back(contactGenerator);
 	}
 	Vector2 deltaBounds = cameraLevelBounds / 2;
-	m_blizzardParticleEmitter.push_back(new BlizzardParticleEmitter(m_particleWorld, manageParticleIn, m_snowGravity, Vector3(-cameraLevelBounds.x + deltaBounds.x, cameraLevelBounds.y - deltaBounds.y, 0), 1500));
-	m_blizzardParticleEmitter.push_back(new BlizzardParticleEmitter(m_particleWorld, manageParticleIn, m_snowGravity, Vector3(cameraLevelBounds.x - deltaBounds.x, cameraLevelBounds.y - deltaBounds.y, 0), -1500));
+	m_blizzardParticleEmitter.push_back(new BlizzardParticleEmitter(m_particleWorld, manageParticleIn, m_snowGravity, Vector3(-cameraLevelBounds.x + deltaBounds.x, cameraLevelBounds.y - deltaBounds.y, 0), 1500, 1));
+	m_blizzardParticleEmitter.push_back(new BlizzardParticleEmitter(m_particleWorld, manageParticleIn, m_snowGravity, Vector3(cameraLevelBounds.x - deltaBounds.x, cameraLevelBounds.y - deltaBounds.y, 0), -1500, 2));
 }
\ No newline at end of file
@@ -55,6 +55,7 @@ private:
 	void createSlopePlatformAndContactGenerator(DirectX::SimpleMath::Vector2 cameraLevelBounds);
 	void createFlyingPlatformsAndContactGenerator();
 	void createParticleVsParticleContactGenerator();
+	void createSnowDepositContactGenerator(DirectX::SimpleMath::Vector2 cameraLevelBounds);
 	void createBlizzardParticleEmitter(DirectX::SimpleMath::Vector2 cameraLevelBounds);
 
 
@@ -77,6 +78,7 @@ private:
 	std::vector<ParticleForceGenerator*> m_particleForceGenerators;
 	std::vector<ParticleContactGenerator*> m_particleContactGenerators;
 	ParticleRenderer* m_particleRenderer = nullptr;
+	ParticleSnowDeposit* m_snowDeposit = nullptr;
 	ParticleWorld* m_particleWorld;
 	std::vector<Platform*> m_platforms;
 	std::vector<BlizzardParticleEmitter*> m_blizzardParticleEmitter;
@@ -84,6 +86,18 @@ private:
 	DirectX::SimpleMath::Vector3 m_snowGravity = DirectX::SimpleMath::Vector3::Down * 5;
 	DirectX::SimpleMath::Vector3 m_fanAcceleration = DirectX::SimpleMath::Vector3::Left * 100;
 	int m_fanAccelerationMultiplier = 1;
+	int m_fanField = 0;
+	// Particles around the mouse while the left button is held
+	std::vector<Particle*> m_pushedParticles;
+	float m_pushRadius = 60;
+	float m_pushAcceleration = 2000;
+	// F6 saves the world to the snapshot file, F7 restores it
+	std::vector<uint8_t> m_snapshot;
+	const wchar_t* m_snapshotPath = L"ParticleWorld.snapshot";
+	// Records every step, R rewinds through the recorded frames while held
+	ParticleRewindRecorder* m_rewindRecorder = nullptr;
+	size_t m_rewindMemoryBudget = 256 << 20;
+	int m_rewindFrame = -1;
 	DirectX::SimpleMath::Vector3 m_particleAnchor[3];
 
 };
\ No newline at end of file
@@ -7,21 +7,25 @@ Particle::Particle()
 {
 }
 
-Particle::~Particle()
+void Particle::Integrate(const float& deltaTime)
 {
+	Integrate(deltaTime, Vector3::Zero);
 }
 
-void Particle::Integrate(const float& deltaTime)
+void Particle::Integrate(const float& deltaTime, const DirectX::SimpleMath::Vector3& fieldAcceleration)
 {
+	m_fieldAcceleration = fieldAcceleration;
+
 	//don't integrate things with infite mass
 	if (m_inverseMass <= 0.0f) return;
 	assert(deltaTime > 0.0f);
 
 	//update linear pos
+	m_previousPosition = m_position;
 	m_position += m_velocity * deltaTime;
 
 	//work out acceleration from the force
-	Vector3 resultingAcc = m_acceleration;
+	Vector3 resultingAcc = m_acceleration + fieldAcceleration;
 	resultingAcc += m_forceAccumulated * m_inverseMass;
 
 	//update linear velocity from the acceleration
@@ -36,7 +40,13 @@ void Particle::Integrate(const float& deltaTime)
 
 void Particle::SetPosition(const DirectX::SimpleMath::Vector3& position)
 {
+	if (position != m_position)
+	{
+		SetAwake(true);
+		EndFlight();
+	}
 	m_position = position;
+	m_previousPosition = position;
 }
 
 DirectX::SimpleMath::Vector3 Particle::GetPosition() const
@@ -44,8 +54,18 @@ DirectX::SimpleMath::Vector3 Particle::GetPosition() const
 	return m_position;
 }
 
+DirectX::SimpleMath::Vector3 Particle::GetPreviousPosition() const
+{
+	return m_previousPosition;
+}
+
 void Particle::SetVelocity(const DirectX::SimpleMath::Vector3& velocity)
 {
+	if (velocity != m_velocity)
+	{
+		SetAwake(true);
+		EndFlight();
+	}
 	m_velocity = velocity;
 }
 
@@ -56,6 +76,11 @@ DirectX::SimpleMath::Vector3 Particle::GetVelocity() const
 
 void Particle::SetAcceleration(const DirectX::SimpleMath::Vector3& acceleration)
 {
+	if (acceleration != m_acceleration)
+	{
+		SetAwake(true);
+		EndFlight();
+	}
 	m_acceleration = acceleration;
 }
 
@@ -64,6 +89,11 @@ DirectX::SimpleMath::Vector3 Particle::GetAcceleration() const
 	return m_acceleration;
 }
 
+DirectX::SimpleMath::Vector3 Particle::GetEffectiveAcceleration() const
+{
+	return m_acceleration + m_fieldAcceleration;
+}
+
 void Particle::SetMass(const float& mass)
 {
 	m_mass = mass;
@@ -125,6 +155,253 @@ ParticleTypes Particle::GetType() const
 	return m_type;
 }
 
+void Particle::SetAwake(const bool& awake, const bool& keepResting)
+{
+	if (awake == m_isAwake)
+		return;
+
+	m_isAwake = awake;
+	if (awake && !keepResting)
+		m_restingFrames = 0;
+	if (!awake)
+	{
+		m_velocity = Vector3::Zero;
+		m_forceAccumulated = Vector3::Zero;
+		m_deferredTime = 0;
+		m_isBallistic = false;
+	}
+}
+
+bool Particle::IsAwake() const
+{
+	return m_isAwake;
+}
+
+void Particle::SetCanSleep(const bool& canSleep)
+{
+	m_canSleep = canSleep;
+	if (!canSleep)
+		SetAwake(true);
+}
+
+bool Particle::CanSleep() const
+{
+	return m_canSleep;
+}
+
+void Particle::UpdateRestingFrames(const float& maxDrift)
+{
+	if (m_canSleep && m_restingFrames > 0 && (m_position - m_restingPosition).LengthSquared() < maxDrift * maxDrift)
+	{
+		++m_restingFrames;
+		return;
+	}
+
+	m_restingFrames = m_canSleep ? 1 : 0;
+	m_restingPosition = m_position;
+}
+
+int Particle::GetRestingFrames() const
+{
+	return m_restingFrames;
+}
+
+void Particle::SetLodInterval(const int& interval)
+{
+	assert(interval > 0);
+	m_lodInterval = interval;
+}
+
+int Particle::GetLodInterval() const
+{
+	return m_lodInterval;
+}
+
+void Particle::SetLodStagger(const unsigned& stagger)
+{
+	m_lodStagger = stagger;
+}
+
+unsigned Particle::GetLodStagger() const
+{
+	return m_lodStagger;
+}
+
+void Particle::DeferIntegration(const float& deltaTime)
+{
+	m_deferredTime += deltaTime;
+}
+
+float Particle::TakeDeferredTime()
+{
+	const float deferredTime = m_deferredTime;
+	m_deferredTime = 0;
+	return deferredTime;
+}
+
+// The velocity decays by the damping per second, so with k = -ln(damping)
+// dv/dt = a - k v, which gives
+// v(t) = a / k + (v0 - a / k) e^(-k t)
+// x(t) = x0 + a / k t + (v0 - a / k) (1 - e^(-k t)) / k
+// and the usual parabola without damping. decay is e^(-k t), which all
+// axes share
+static void flightAxis(const float& position, const float& velocity, const float& acceleration, const float& k, const float& t, const float& decay, float& outPosition, float& outVelocity)
+{
+	if (k < 1e-6f)
+	{
+		outPosition = position + velocity * t + 0.5f * acceleration * t * t;
+		outVelocity = velocity + acceleration * t;
+		return;
+	}
+	const float terminal = acceleration / k;
+	outPosition = position + terminal * t + (velocity - terminal) * (1.f - decay) / k;
+	outVelocity = terminal + (velocity - terminal) * decay;
+}
+
+// Time at which the velocity of an axis is zero, false if it never is
+static bool flightTurningPoint(const float& velocity, const float& acceleration, const float& k, float& outTime)
+{
+	if (k < 1e-6f)
+	{
+		if (acceleration == 0)
+			return false;
+		outTime = -velocity / acceleration;
+		return outTime > 0;
+	}
+	const float terminal = acceleration / k;
+	if (velocity == terminal)
+		return false;
+	// e^(-k t) = -terminal / (velocity - terminal) has to be in (0, 1)
+	const float decay = -terminal / (velocity - terminal);
+	if (decay <= 0 || decay >= 1)
+		return false;
+	outTime = -std::log(decay) / k;
+	return true;
+}
+
+void Particle::Launch(const float& time, const DirectX::SimpleMath::Vector3& fieldAcceleration)
+{
+	m_isBallistic = true;
+	m_fieldAcceleration = fieldAcceleration;
+	m_launchPosition = m_position;
+	m_launchVelocity = m_velocity;
+	m_launchTime = time;
+	m_flightClearUntil = time;
+}
+
+void Particle::EndFlight()
+{
+	m_isBallistic = false;
+}
+
+bool Particle::IsBallistic() const
+{
+	return m_isBallistic;
+}
+
+void Particle::EvaluateFlight(const float& time)
+{
+	const float k = -std::log(m_damping);
+	const float t = time - m_launchTime;
+	const float decay = std::exp(-k * t);
+	m_previousPosition = m_position;
+	const Vector3 acceleration = m_acceleration + m_fieldAcceleration;
+	flightAxis(m_launchPosition.x, m_launchVelocity.x, acceleration.x, k, t, decay, m_position.x, m_velocity.x);
+	flightAxis(m_launchPosition.y, m_launchVelocity.y, acceleration.y, k, t, decay, m_position.y, m_velocity.y);
+	flightAxis(m_launchPosition.z, m_launchVelocity.z, acceleration.z, k, t, decay, m_position.z, m_velocity.z);
+}
+
+void Particle::GetFlightBounds(const float& from, const float& to, DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const
+{
+	// Every axis turns around at most once, so its extremes are at the
+	// ends of the time span or at the turning point
+	const float k = -std::log(m_damping);
+	const float start = from - m_launchTime;
+	const float end = to - m_launchTime;
+	const float startDecay = std::exp(-k * start);
+	const float endDecay = std::exp(-k * end);
+	const float* position = &m_launchPosition.x;
+	const float* velocity = &m_launchVelocity.x;
+	const Vector3 effectiveAcceleration = m_acceleration + m_fieldAcceleration;
+	const float* acceleration = &effectiveAcceleration.x;
+	float* minimum = &outMin.x;
+	float* maximum = &outMax.x;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float first, last, unused;
+		flightAxis(position[axis], velocity[axis], acceleration[axis], k, start, startDecay, first, unused);
+		flightAxis(position[axis], velocity[axis], acceleration[axis], k, end, endDecay, last, unused);
+		minimum[axis] = std::min(first, last);
+		maximum[axis] = std::max(first, last);
+
+		float turn;
+		if (flightTurningPoint(velocity[axis], acceleration[axis], k, turn) && turn > start && turn < end)
+		{
+			float turnPosition;
+			flightAxis(position[axis], velocity[axis], acceleration[axis], k, turn, std::exp(-k * turn), turnPosition, unused);
+			minimum[axis] = std::min(minimum[axis], turnPosition);
+			maximum[axis] = std::max(maximum[axis], turnPosition);
+		}
+		minimum[axis] -= m_worldSpaceRadius;
+		maximum[axis] += m_worldSpaceRadius;
+	}
+}
+
+void Particle::SetFlightClearUntil(const float& time)
+{
+	m_flightClearUntil = time;
+}
+
+float Particle::GetFlightClearUntil() const
+{
+	return m_flightClearUntil;
+}
+
+void Particle::SetExpiryTime(const float& time)
+{
+	m_expiryTime = time;
+}
+
+void Particle::ClearExpiryTime()
+{
+	m_expiryTime = std::numeric_limits<float>::max();
+}
+
+float Particle::GetExpiryTime() const
+{
+	return m_expiryTime;
+}
+
+bool Particle::HasLifetime() const
+{
+	return m_expiryTime < std::numeric_limits<float>::max();
+}
+
+void Particle::AddMembershipTags(const uint32_t& tags)
+{
+	m_membershipTags |= tags;
+}
+
+void Particle::RemoveMembershipTags(const uint32_t& tags)
+{
+	m_membershipTags &= ~tags;
+}
+
+uint32_t Particle::GetMembershipTags() const
+{
+	return m_membershipTags;
+}
+
+void Particle::SetSpawnTime(const float& time)
+{
+	m_spawnTime = time;
+}
+
+float Particle::GetSpawnTime() const
+{
+	return m_spawnTime;
+}
+
 float Particle::GetBouncinessFactor() const
 {
 	return m_bouncinessFactor;
@@ -135,17 +412,53 @@ void Particle::AddForce(const DirectX::SimpleMath::Vector3& force)
 	m_forceAccumulated += force;
 }
 
+ParticleRemap::ParticleRemap(Particle* storage, const std::vector<int>& newIndices)
+	: m_storage(storage), m_newStorage(storage), m_newIndices(&newIndices)
+{
+}
+
+ParticleRemap::ParticleRemap(Particle* storage, Particle* newStorage, const std::vector<int>& newIndices)
+	: m_storage(storage), m_newStorage(newStorage), m_newIndices(&newIndices)
+{
+}
+
+Particle* ParticleRemap::operator()(Particle* particle) const
+{
+	// Compare as integers, pointers into different arrays can't be
+	// compared directly
+	const uintptr_t address = reinterpret_cast<uintptr_t>(particle);
+	const uintptr_t begin = reinterpret_cast<uintptr_t>(m_storage);
+	const uintptr_t end = reinterpret_cast<uintptr_t>(m_storage + m_newIndices->size());
+	if (address < begin || address >= end)
+		return particle;
+
+	return m_newStorage + (*m_newIndices)[particle - m_storage];
+}
+
 void ParticleManagement::AddParticle(Particle* particle)
 {
-	m_particles.push_back(particle);
+	AddParticle(&particle, 1);
 }
 
 void ParticleManagement::AddParticle(const std::vector<Particle*>& particles)
 {
-	for(Particle* particle : particles)
+	AddParticle(particles.data(), particles.size());
+}
+
+void ParticleManagement::AddParticle(Particle* const* particles, const size_t& count)
+{
+	const size_t before = m_particles.size();
+	for (size_t index = 0; index < count; ++index)
 	{
-		AddParticle(particle);
+		Particle* particle = particles[index];
+		if (particle->GetMembershipTags() & m_tag)
+			continue;
+
+		particle->AddMembershipTags(m_tag);
+		m_particles.push_back(particle);
 	}
+	if (m_particles.size() != before)
+		++m_membershipVersion;
 }
 
 void ParticleManagement::RemoveParticle(Particle* particle)
@@ -154,13 +467,82 @@ void ParticleManagement::RemoveParticle(Particle* particle)
 	{
 		if (m_particles[index] == particle)
 		{
+			particle->RemoveMembershipTags(m_tag);
 			m_particles.erase(m_particles.begin() + index);
+			++m_membershipVersion;
 			break;
 		}
 	}
 }
 
+void ParticleManagement::RemoveInactiveParticles()
+{
+	const uint32_t tag = m_tag;
+	auto firstInactive = std::remove_if(m_particles.begin(), m_particles.end(), [tag](Particle* particle)
+	{
+		if (particle->IsActive())
+			return false;
+		particle->RemoveMembershipTags(tag);
+		return true;
+	});
+	if (firstInactive != m_particles.end())
+	{
+		m_particles.erase(firstInactive, m_particles.end());
+		++m_membershipVersion;
+	}
+}
+
 std::vector<Particle*>& ParticleManagement::GetParticles()
 {
 	return m_particles;
+}
+
+unsigned ParticleManagement::GetMembershipVersion() const
+{
+	return m_membershipVersion;
+}
+
+void ParticleManagement::SetTag(const uint32_t& tag)
+{
+	for (Particle* particle : m_particles)
+	{
+		particle->RemoveMembershipTags(m_tag);
+	}
+	m_tag = tag;
+	if (m_tag == 0)
+		return;
+
+	const size_t before = m_particles.size();
+	const uint32_t newTag = m_tag;
+	auto firstDuplicate = std::remove_if(m_particles.begin(), m_particles.end(), [newTag](Particle* particle)
+	{
+		if (particle->GetMembershipTags() & newTag)
+			return true;
+		particle->AddMembershipTags(newTag);
+		return false;
+	});
+	m_particles.erase(firstDuplicate, m_particles.end());
+	if (m_particles.size() != before)
+		++m_membershipVersion;
+}
+
+uint32_t ParticleManagement::GetTag() const
+{
+	return m_tag;
+}
+
+void ParticleManagement::RemapParticles(const ParticleRemap& remap)
+{
+	for (Particle*& particle : m_particles)
+	{
+		particle = remap(particle);
+	}
+	std::sort(m_particles.begin(), m_particles.end(), std::less<Particle*>());
+	++m_membershipVersion;
+}
+
+void ParticleManagement::ReplaceParticles(Particle* const* particles, const size_t& count)
+{
+	m_particles.assign(particles, particles + count);
+	++m_membershipVersion;
 }
\ No newline at end of file
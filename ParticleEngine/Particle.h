@@ -8,23 +8,44 @@ enum class ParticleTypes : int
 	Cloth
 };
 
+/**
+* Particles are trivially copyable, world snapshots copy the particle
+* storage as it is.
+*/
 class Particle
 {
 public:
 	Particle();
-	~Particle();
 
 	void Integrate(const float& deltaTime);
 
+	/**
+	* Integrates with the acceleration of the force fields of the world
+	* on top of the particle's own, see GetEffectiveAcceleration.
+	*/
+	void Integrate(const float& deltaTime, const DirectX::SimpleMath::Vector3& fieldAcceleration);
+
 	void SetPosition(const DirectX::SimpleMath::Vector3& position);
 	DirectX::SimpleMath::Vector3 GetPosition() const;
 
+	/**
+	* The position before the last Integrate. SetPosition moves both, so
+	* a particle which was placed somewhere didn't travel there.
+	*/
+	DirectX::SimpleMath::Vector3 GetPreviousPosition() const;
+
 	void SetVelocity(const DirectX::SimpleMath::Vector3& velocity);
 	DirectX::SimpleMath::Vector3 GetVelocity() const;
 
 	void SetAcceleration(const DirectX::SimpleMath::Vector3& acceleration);
 	DirectX::SimpleMath::Vector3 GetAcceleration() const;
 
+	/**
+	* The own acceleration plus the one of the force fields the particle
+	* was last integrated or launched in.
+	*/
+	DirectX::SimpleMath::Vector3 GetEffectiveAcceleration() const;
+
 	void SetMass(const float& mass);
 	float GetMass() const;
 	float GetInverseMass() const;
@@ -46,11 +67,117 @@ public:
 	void SetType(ParticleTypes type);
 	ParticleTypes GetType() const;
 
+	/**
+	* Sleeping particles are not integrated and skipped by the force
+	* registry and the contact generators until something wakes them up.
+	* Putting a particle to sleep stops it. Changing the position,
+	* velocity or acceleration of a particle wakes it up. Waking up
+	* starts counting the resting frames anew, unless keepResting is set.
+	*/
+	void SetAwake(const bool& awake, const bool& keepResting = false);
+	bool IsAwake() const;
+
+	/**
+	* Particles which aren't allowed to sleep are never put to sleep by
+	* the world, for example because the game moves them every frame.
+	*/
+	void SetCanSleep(const bool& canSleep);
+	bool CanSleep() const;
+
+	/**
+	* Counts the frames in a row in which the particle stayed within
+	* maxDrift of where it started resting. Call it once per step after
+	* the contacts are resolved. The position is used rather than the
+	* velocity: a particle resting on something keeps the velocity it
+	* gains from the acceleration in every step and jitters a little,
+	* while the contacts hold it in place.
+	*/
+	void UpdateRestingFrames(const float& maxDrift);
+	int GetRestingFrames() const;
+
+	/**
+	* Far from the view the world integrates a particle only every
+	* interval steps, over the time of all of them. While its interval is
+	* above one the particle doesn't collide with other particles.
+	*/
+	void SetLodInterval(const int& interval);
+	int GetLodInterval() const;
+
+	/**
+	* Offsets the steps in which the particle is integrated within its
+	* interval. The world hands out one after the other as it spawns
+	* particles, so the far particles are spread evenly over the steps.
+	*/
+	void SetLodStagger(const unsigned& stagger);
+	unsigned GetLodStagger() const;
+
+	/**
+	* Time of the steps the particle skipped, TakeDeferredTime returns
+	* it and starts over.
+	*/
+	void DeferIntegration(const float& deltaTime);
+	float TakeDeferredTime();
+
+	/**
+	* A ballistic particle flies under its acceleration and damping only,
+	* its path follows in closed form from where and when it was
+	* launched, so the world evaluates it instead of integrating it.
+	* Force generators don't act on it. Setting the position, velocity or
+	* acceleration or putting it to sleep ends the flight and the particle
+	* is integrated again from where it is. The particle flies under the
+	* acceleration of the force fields it is launched in as well.
+	*/
+	void Launch(const float& time, const DirectX::SimpleMath::Vector3& fieldAcceleration = DirectX::SimpleMath::Vector3::Zero);
+	void EndFlight();
+	bool IsBallistic() const;
+
+	/**
+	* Moves a ballistic particle to where it is at the given time.
+	*/
+	void EvaluateFlight(const float& time);
+
+	/**
+	* Box around the path of a ballistic particle between the two times,
+	* radius included.
+	*/
+	void GetFlightBounds(const float& from, const float& to, DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const;
+
+	/**
+	* The world checks the flight for colliders up to this time.
+	*/
+	void SetFlightClearUntil(const float& time);
+	float GetFlightClearUntil() const;
+
+	/**
+	* Time of the world at which the particle expires and goes back to
+	* the pool, see ParticleWorld::SetParticleLifetime. Particles without
+	* a lifetime never expire.
+	*/
+	void SetExpiryTime(const float& time);
+	void ClearExpiryTime();
+	float GetExpiryTime() const;
+	bool HasLifetime() const;
+
+	/**
+	* The tags of the ParticleManagement lists the particle is in.
+	*/
+	void AddMembershipTags(const uint32_t& tags);
+	void RemoveMembershipTags(const uint32_t& tags);
+	uint32_t GetMembershipTags() const;
+
+	/**
+	* Time of the world at which the particle was taken from the pool.
+	*/
+	void SetSpawnTime(const float& time);
+	float GetSpawnTime() const;
+
 protected:
 	DirectX::SimpleMath::Vector3 m_position = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 m_previousPosition = DirectX::SimpleMath::Vector3::Zero;
 	DirectX::SimpleMath::Vector3 m_velocity = DirectX::SimpleMath::Vector3::Zero;
 	DirectX::SimpleMath::Vector3 m_acceleration = DirectX::SimpleMath::Vector3::Zero;
 	DirectX::SimpleMath::Vector3 m_forceAccumulated = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 m_fieldAcceleration = DirectX::SimpleMath::Vector3::Zero;
 
 	// damping goes from 0 .. 1 -> veloctiy *= damping
 	float m_damping = 0.99f;
@@ -59,17 +186,99 @@ protected:
 	float m_worldSpaceRadius = 1;
 	float m_bouncinessFactor = 0.0f;
 	bool m_isActive = false;
+	bool m_isAwake = true;
+	bool m_canSleep = true;
+	int m_restingFrames = 0;
+	DirectX::SimpleMath::Vector3 m_restingPosition = DirectX::SimpleMath::Vector3::Zero;
+	int m_lodInterval = 1;
+	unsigned m_lodStagger = 0;
+	float m_deferredTime = 0;
+	bool m_isBallistic = false;
+	DirectX::SimpleMath::Vector3 m_launchPosition = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 m_launchVelocity = DirectX::SimpleMath::Vector3::Zero;
+	float m_launchTime = 0;
+	float m_flightClearUntil = 0;
+	float m_expiryTime = std::numeric_limits<float>::max();
+	float m_spawnTime = 0;
+	uint32_t m_membershipTags = 0;
 	ParticleTypes m_type = ParticleTypes::None;
 };
 
+/**
+* Tells where the particles of a ParticleWorld went when the world
+* reordered its particle storage. Particles which don't belong to the
+* storage are mapped to themselves.
+*/
+class ParticleRemap
+{
+public:
+	ParticleRemap(Particle* storage, const std::vector<int>& newIndices);
+
+	/**
+	* The storage moved to newStorage, for example because it grew.
+	*/
+	ParticleRemap(Particle* storage, Particle* newStorage, const std::vector<int>& newIndices);
+
+	Particle* operator()(Particle* particle) const;
+
+private:
+	Particle* m_storage;
+	Particle* m_newStorage;
+	const std::vector<int>* m_newIndices;
+};
+
+/**
+* Keeps a list of particles, for example the ones a contact generator
+* collides. The world gives the contact generators it runs a tag and
+* the particles carry the tags of the lists they are in, so a particle
+* is added to a list only once and the world only cleans up the lists
+* its released particles were in. Lists without a tag don't skip the
+* particles they already have.
+*/
 class ParticleManagement
 {
 public:
+	virtual ~ParticleManagement() = default;
+
 	void AddParticle(Particle* particle);
 	void AddParticle(const std::vector<Particle*>& particles);
+	void AddParticle(Particle* const* particles, const size_t& count);
 	void RemoveParticle(Particle* particle);
+	void RemoveInactiveParticles();
 	std::vector<Particle*>& GetParticles();
 
+	/**
+	* Changes whenever particles are added or removed. Particles are
+	* always appended and removing keeps the order of the others.
+	*/
+	unsigned GetMembershipVersion() const;
+
+	/**
+	* Replaces every particle pointer after the particle storage was
+	* reordered. The particles are sorted by their new address, so
+	* iterating over them follows the storage order; this counts as a
+	* membership change.
+	*/
+	virtual void RemapParticles(const ParticleRemap& remap);
+
+	/**
+	* Replaces the list with the given particles in their order, for
+	* example when a world restores a snapshot. The particles keep their
+	* tags as they are, they should carry the tag of the list already.
+	*/
+	virtual void ReplaceParticles(Particle* const* particles, const size_t& count);
+
+	/**
+	* A single bit, zero for none. The particles which are already in the
+	* list get the tag, the ones which are in it twice only stay once.
+	*/
+	void SetTag(const uint32_t& tag);
+	uint32_t GetTag() const;
+
+	static const int MaxTags = 32;
+
 protected:
 	std::vector<Particle*> m_particles;
+	unsigned m_membershipVersion = 0;
+	uint32_t m_tag = 0;
 };
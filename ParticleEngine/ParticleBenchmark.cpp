@@ -0,0 +1,1388 @@
+#include "pch.h"
+#include "ParticleBenchmark.h"
+
+using namespace DirectX::SimpleMath;
+
+namespace
+{
+	const char* stopReasonName(const ParticleContactResolverStopReason& reason)
+	{
+		switch (reason)
+		{
+		case ParticleContactResolverStopReason::Converged: return "converged";
+		case ParticleContactResolverStopReason::TimeBudget: return "time budget";
+		default: return "iteration limit";
+		}
+	}
+
+	void print(const char* format, ...)
+	{
+		char buffer[512];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buffer, sizeof(buffer), format, args);
+		va_end(args);
+		OutputDebugStringA(buffer);
+	}
+
+	/**
+	* The particle-particle contacts as the generator wrote them when it
+	* visited every ordered pair and skipped the pairs it had found
+	* already by searching through them.
+	*/
+	int addContactsOfOrderedPairs(const std::vector<Particle*>& particles, ParticleContact* contact, const int& limit)
+	{
+		std::vector<std::pair<Particle*, Particle*>> usedPairs;
+		int count = 0;
+		for (Particle* particle : particles)
+		{
+			for (Particle* other : particles)
+			{
+				if (particle == other || !ParticleCollisionFilter::CanInteract(particle->GetType(), other->GetType()))
+					continue;
+				if (particle->GetLodInterval() > 1 || other->GetLodInterval() > 1)
+					continue;
+				if (!particle->IsAwake() && !other->IsAwake())
+					continue;
+
+				const Vector3 midline = particle->GetPosition() - other->GetPosition();
+				const float size = midline.Length();
+				if (size <= 0.0f || size >= particle->GetWorldSpaceRadius() + other->GetWorldSpaceRadius())
+					continue;
+
+				const bool used = std::any_of(usedPairs.begin(), usedPairs.end(), [particle, other](const std::pair<Particle*, Particle*>& pair)
+				{
+					return pair.first == other && pair.second == particle;
+				});
+				if (used || ParticleCollisionFilter::GetInteraction(particle->GetType(), other->GetType()) != ParticleInteraction::Collide)
+					continue;
+
+				contact->ContactNormal = midline * (1.f / size);
+				contact->ContactParticles[0] = particle;
+				contact->ContactParticles[1] = other;
+				contact->Penetration = particle->GetWorldSpaceRadius() + other->GetWorldSpaceRadius() - size;
+				contact->Restitution = particle->GetBouncinessFactor() + other->GetBouncinessFactor();
+				contact++;
+				usedPairs.push_back(std::make_pair(particle, other));
+				if (++count >= limit)
+					return count;
+			}
+		}
+		return count;
+	}
+
+	/**
+	* Snow at rest, spread from -400 to 400 and over the given heights,
+	* added to every one of the lists.
+	*/
+	void createSnow(ParticleWorld& world, const std::vector<ParticleManagement*>& lists, const int& particleCount,
+		const float& minY = -90, const float& maxY = 300, const Vector3& acceleration = Vector3::Down * 5)
+	{
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> x(-400, 400);
+		std::uniform_real_distribution<float> y(minY, maxY);
+		for (int i = 0; i < particleCount; ++i)
+		{
+			Particle* particle = world.GetNewParticle(ParticleTypes::Snow);
+			particle->SetPosition(Vector3(x(random), y(random), 0));
+			particle->SetMass(0.0001f);
+			particle->SetWorldSpaceRadius(2);
+			particle->SetAcceleration(acceleration);
+			particle->SetBouncinessFactor(0.0001f);
+			for (ParticleManagement* list : lists)
+			{
+				list->AddParticle(particle);
+			}
+		}
+	}
+
+	/**
+	* A pile of overlapping balls, 32 per row, the lowest row is
+	* sunk into the ground at y = 0.
+	*/
+	void createPile(std::vector<Particle>& particles, const int& particleCount)
+	{
+		const int perRow = 32;
+		const float radius = 10;
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> jitter(-2.f, 2.f);
+
+		particles.resize(particleCount);
+		for (int i = 0; i < particleCount; ++i)
+		{
+			Particle& particle = particles[i];
+			particle.SetActive(true);
+			particle.SetType(ParticleTypes::Ball);
+			particle.SetMass(10);
+			particle.SetWorldSpaceRadius(radius);
+			particle.SetBouncinessFactor(0.2f);
+			particle.SetAcceleration(Vector3::Down * 100);
+			particle.SetPosition(Vector3((i % perRow) * radius * 1.8f + jitter(random), (i / perRow) * radius * 1.8f + jitter(random) + radius * 0.5f, 0));
+			particle.SetVelocity(Vector3(jitter(random), -20.f + jitter(random), 0));
+		}
+	}
+
+	/**
+	* Balls spread over a square without gravity, drifting slowly in
+	* random directions like the snow of a blizzard.
+	*/
+	void createDrift(std::vector<Particle>& particles, const int& particleCount)
+	{
+		const int perRow = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(particleCount))));
+		const float radius = 10;
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> jitter(-2.f, 2.f);
+		std::uniform_real_distribution<float> speed(-30.f, 30.f);
+
+		particles.resize(particleCount);
+		for (int i = 0; i < particleCount; ++i)
+		{
+			Particle& particle = particles[i];
+			particle.SetActive(true);
+			particle.SetType(ParticleTypes::Ball);
+			particle.SetMass(10);
+			particle.SetWorldSpaceRadius(radius);
+			particle.SetBouncinessFactor(0.5f);
+			particle.SetPosition(Vector3((i % perRow) * radius * 2.2f + jitter(random), (i / perRow) * radius * 2.2f + jitter(random), 0));
+			particle.SetVelocity(Vector3(speed(random), speed(random), 0));
+		}
+	}
+
+	/**
+	* Walks the pairs of particles closer than cutoff in the order the
+	* neighbour list of a ParticleParticleContactGenerator visits them
+	* and counts the misses of a 32 KiB direct mapped cache with 64 byte
+	* lines.
+	*/
+	long long simulateCacheMisses(const std::vector<Particle*>& particles, const float& cutoff, long long& outAccesses)
+	{
+		const uintptr_t lineSize = 64;
+		const size_t lineCount = 512;
+		std::vector<uintptr_t> lines(lineCount, 0);
+		long long misses = 0;
+		outAccesses = 0;
+
+		auto touch = [&](const Particle* particle)
+		{
+			const uintptr_t first = reinterpret_cast<uintptr_t>(particle) / lineSize;
+			const uintptr_t last = (reinterpret_cast<uintptr_t>(particle + 1) - 1) / lineSize;
+			for (uintptr_t line = first; line <= last; ++line)
+			{
+				uintptr_t& cached = lines[line % lineCount];
+				misses += cached != line + 1 ? 1 : 0;
+				cached = line + 1;
+			}
+			++outAccesses;
+		};
+
+		const size_t count = particles.size();
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (size_t j = i + 1; j < count; ++j)
+			{
+				if ((particles[i]->GetPosition() - particles[j]->GetPosition()).LengthSquared() >= cutoff * cutoff)
+					continue;
+
+				touch(particles[i]);
+				touch(particles[j]);
+			}
+		}
+		return misses;
+	}
+
+	int generatePileContacts(std::vector<Particle>& particles, std::vector<ParticleContact>& contacts)
+	{
+		contacts.clear();
+		const int count = static_cast<int>(particles.size());
+		for (int i = 0; i < count; ++i)
+		{
+			Particle* particle = &particles[i];
+			float y = particle->GetPosition().y - particle->GetWorldSpaceRadius();
+			if (y < 0)
+			{
+				ParticleContact contact;
+				contact.ContactNormal = Vector3::Up;
+				contact.ContactParticles[0] = particle;
+				contact.ContactParticles[1] = nullptr;
+				contact.Penetration = -y;
+				contact.Restitution = particle->GetBouncinessFactor();
+				contacts.push_back(contact);
+			}
+
+			for (int j = i + 1; j < count; ++j)
+			{
+				Particle* other = &particles[j];
+				Vector3 midline = particle->GetPosition() - other->GetPosition();
+				float size = midline.Length();
+				if (size <= 0.0f || size >= particle->GetWorldSpaceRadius() + other->GetWorldSpaceRadius())
+					continue;
+
+				ParticleContact contact;
+				contact.ContactNormal = midline * (1.f / size);
+				contact.ContactParticles[0] = particle;
+				contact.ContactParticles[1] = other;
+				contact.Penetration = particle->GetWorldSpaceRadius() + other->GetWorldSpaceRadius() - size;
+				contact.Restitution = particle->GetBouncinessFactor() + other->GetBouncinessFactor();
+				contacts.push_back(contact);
+			}
+		}
+		return static_cast<int>(contacts.size());
+	}
+
+	/**
+	* The world doesn't own its contact generators, they leave it before
+	* they go out of scope.
+	*/
+	void removeContactGenerators(ParticleWorld& world)
+	{
+		while (!world.GetContactGenerators().empty())
+		{
+			world.RemoveContactGenerator(world.GetContactGenerators().back());
+		}
+	}
+
+	/**
+	* Snow on the ground and a rope of cloth hanging from an anchor by
+	* springs. The pool grows from the given size and the storage is
+	* reordered, scenes set up with the same particle count know the same
+	* force generators, so the snapshots of one restore into another.
+	*/
+	class SnapshotScene
+	{
+	public:
+		static const int RopeLength = 32;
+
+		SnapshotScene(const int& particleCount, const int& poolSize)
+			: m_world(particleCount * 4, poolSize, LevelBounds{ -4000, 4000, -600, 1200 }),
+			m_anchorSpring(&m_anchor, 50, 0.8f)
+		{
+			ParticlePoolPolicy grow;
+			grow.OnExhausted = ParticlePoolExhaustionPolicy::Grow;
+			m_world.SetPoolPolicy(ParticleTypes::Snow, grow);
+			m_world.SetPoolPolicy(ParticleTypes::Cloth, grow);
+			m_world.SetMaxPoolSize((particleCount + RopeLength) * 2);
+			m_world.SetParticleReorderInterval(30);
+			m_world.AddContactGenerator(&m_ground);
+			m_world.AddContactGenerator(&m_particleContacts);
+
+			// The rope hangs like the cloth of the game and comes first,
+			// the pool only grows for the snow
+			Particle* previous = nullptr;
+			for (int i = 0; i < RopeLength; ++i)
+			{
+				Particle* particle = m_world.GetNewParticle(ParticleTypes::Cloth);
+				particle->SetPosition(m_anchor + Vector3::Down * 5.f * static_cast<float>(i));
+				particle->SetMass(10);
+				particle->SetWorldSpaceRadius(10);
+				particle->SetAcceleration(Vector3::Down * 100);
+				particle->SetBouncinessFactor(0.f);
+				m_ground.AddParticle(particle);
+				if (!previous)
+				{
+					m_world.GetForceRegistry().Add(particle, &m_anchorSpring);
+				}
+				else
+				{
+					m_springs.push_back(std::make_unique<ParticleFakeStiffSpringForceGenerator>(previous, 25.f, 0.8f));
+					m_world.GetForceRegistry().Add(particle, m_springs.back().get());
+					m_springs.push_back(std::make_unique<ParticleFakeStiffSpringForceGenerator>(particle, 25.f, 0.8f));
+					m_world.GetForceRegistry().Add(previous, m_springs.back().get());
+				}
+				previous = particle;
+			}
+			createSnow(m_world, { &m_ground, &m_particleContacts }, particleCount);
+		}
+
+		~SnapshotScene()
+		{
+			removeContactGenerators(m_world);
+		}
+
+		ParticleWorld& GetWorld()
+		{
+			return m_world;
+		}
+
+	private:
+		ParticleWorld m_world;
+		ParticleGroundContactsGenerator m_ground;
+		ParticleParticleContactGenerator m_particleContacts;
+		Vector3 m_anchor = Vector3(-200, 200, 0);
+		ParticleAnchoredFakeStiffSpringForceGenerator m_anchorSpring;
+		std::vector<std::unique_ptr<ParticleFakeStiffSpringForceGenerator>> m_springs;
+	};
+}
+
+ParticleBenchmark::ContactResolverResult ParticleBenchmark::RunContactResolver(const ParticleContactResolverMode& mode, const int& particleCount, const unsigned& batchSweeps, const float& timeBudget)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	std::vector<Particle> particles;
+	std::vector<ParticleContact> contacts;
+	createPile(particles, particleCount);
+	for (Particle& particle : particles)
+	{
+		particle.Integrate(deltaTime);
+	}
+
+	ContactResolverResult result;
+	result.Mode = mode;
+	result.Particles = particleCount;
+	result.Contacts = generatePileContacts(particles, contacts);
+	ParticleContactResolver::MeasureResidual(contacts.data(), result.Contacts, result.MaxPenetrationBefore, result.MaxClosingVelocityBefore);
+
+	ParticleContactResolver resolver(result.Contacts * 2);
+	resolver.SetMode(mode);
+	resolver.SetBatchSweeps(batchSweeps);
+	resolver.SetTimeBudget(timeBudget);
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	resolver.ResolveContacts(contacts.data(), result.Contacts, deltaTime);
+	result.Milliseconds = MillisecondsSince(start);
+	result.Colors = resolver.GetColorCount();
+	result.Iterations = resolver.GetIterationsUsed();
+	result.StopReason = resolver.GetLastStopReason();
+
+	ParticleContactResolver::MeasureResidual(contacts.data(), result.Contacts, result.MaxPenetrationAfter, result.MaxClosingVelocityAfter);
+	return result;
+}
+
+ParticleBenchmark::NeighbourListResult ParticleBenchmark::RunNeighbourList(const int& particleCount, const int& steps, const float& skin)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	std::vector<Particle> particles;
+	createDrift(particles, particleCount);
+
+	ParticleParticleContactGenerator bruteForce;
+	ParticleParticleContactGenerator neighbourList;
+	neighbourList.SetNeighbourListEnabled(true);
+	neighbourList.SetNeighbourListSkin(skin);
+	for (Particle& particle : particles)
+	{
+		bruteForce.AddParticle(&particle);
+		neighbourList.AddParticle(&particle);
+	}
+
+	ParticleContactResolver resolver(0);
+	resolver.SetMode(ParticleContactResolverMode::GraphColored);
+
+	NeighbourListResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	result.Contacts = 0;
+	result.BruteForceMilliseconds = 0;
+	result.NeighbourListMilliseconds = 0;
+
+	const int limit = particleCount * 8;
+	std::vector<ParticleContact> contacts(limit);
+	for (int step = 0; step < steps; ++step)
+	{
+		for (Particle& particle : particles)
+		{
+			particle.Integrate(deltaTime);
+		}
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		int bruteForceCount = bruteForce.AddContact(contacts.data(), limit);
+		result.BruteForceMilliseconds += MillisecondsSince(start);
+
+		// The contacts of the neighbour list get resolved, both have to
+		// find the same ones
+		start = BenchmarkClock::now();
+		int count = neighbourList.AddContact(contacts.data(), limit);
+		result.NeighbourListMilliseconds += MillisecondsSince(start);
+		assert(count == bruteForceCount);
+		result.Contacts += count;
+
+		resolver.ResolveContacts(contacts.data(), count, deltaTime);
+	}
+
+	result.Stats = neighbourList.GetNeighbourListStats();
+	return result;
+}
+
+ParticleBenchmark::PileContactsResult ParticleBenchmark::RunPileContacts(const int& particleCount, const int& repeats)
+{
+	std::vector<Particle> particles;
+	createPile(particles, particleCount);
+
+	ParticleParticleContactGenerator generator;
+	for (Particle& particle : particles)
+	{
+		generator.AddParticle(&particle);
+	}
+
+	PileContactsResult result;
+	result.Particles = particleCount;
+	result.Contacts = 0;
+
+	const int limit = particleCount * 8;
+	std::vector<ParticleContact> contacts(limit);
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (int repeat = 0; repeat < repeats; ++repeat)
+	{
+		result.Contacts = generator.AddContact(contacts.data(), limit);
+	}
+	result.Milliseconds = MillisecondsSince(start) / repeats;
+
+	std::vector<std::pair<Particle*, Particle*>> pairs;
+	pairs.reserve(result.Contacts);
+	for (int index = 0; index < result.Contacts; ++index)
+	{
+		Particle* first = contacts[index].ContactParticles[0];
+		Particle* second = contacts[index].ContactParticles[1];
+		pairs.push_back(first < second ? std::make_pair(first, second) : std::make_pair(second, first));
+	}
+	std::sort(pairs.begin(), pairs.end());
+	result.DuplicatePairs = static_cast<int>(pairs.end() - std::unique(pairs.begin(), pairs.end()));
+	assert(result.DuplicatePairs == 0);
+
+	// The narrowphase takes the square root differently, so the contacts
+	// only match up to float precision
+	const float tolerance = 1e-4f;
+	std::vector<ParticleContact> reference(limit);
+	start = BenchmarkClock::now();
+	const int referenceContacts = addContactsOfOrderedPairs(generator.GetParticles(), reference.data(), limit);
+	result.MillisecondsReference = MillisecondsSince(start);
+	result.Mismatches = std::abs(referenceContacts - result.Contacts);
+	for (int index = 0; index < std::min(referenceContacts, result.Contacts); ++index)
+	{
+		const ParticleContact& contact = contacts[index];
+		const ParticleContact& expected = reference[index];
+		const bool same = contact.ContactParticles[0] == expected.ContactParticles[0] && contact.ContactParticles[1] == expected.ContactParticles[1] &&
+			(contact.ContactNormal - expected.ContactNormal).Length() < tolerance && std::abs(contact.Penetration - expected.Penetration) < tolerance &&
+			contact.Restitution == expected.Restitution;
+		result.Mismatches += same ? 0 : 1;
+	}
+	assert(result.Mismatches == 0);
+	return result;
+}
+
+ParticleBenchmark::ParticleReorderResult ParticleBenchmark::RunParticleReorder(const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	std::vector<Particle> layout;
+	createDrift(layout, particleCount);
+	std::vector<int> spawnOrder(particleCount);
+	for (int i = 0; i < particleCount; ++i)
+	{
+		spawnOrder[i] = i;
+	}
+	std::shuffle(spawnOrder.begin(), spawnOrder.end(), std::mt19937(7));
+
+	LevelBounds bounds{ -1000, 3000, -1000, 3000 };
+	ParticleWorld world(particleCount * 8, particleCount, bounds);
+	world.SetSleepEnabled(false);
+	ParticleParticleContactGenerator contactGenerator;
+	contactGenerator.SetNeighbourListEnabled(true);
+	contactGenerator.SetNeighbourListSkin(4.f);
+	world.AddContactGenerator(&contactGenerator);
+	for (int index : spawnOrder)
+	{
+		Particle* particle = world.GetNewParticle();
+		*particle = layout[index];
+		contactGenerator.AddParticle(particle);
+	}
+
+	ParticleReorderResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	const float cutoff = layout[0].GetWorldSpaceRadius() * 2 + 4.f;
+
+	result.SimulatedCacheMissesBefore = simulateCacheMisses(contactGenerator.GetParticles(), cutoff, result.PairAccesses);
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (int step = 0; step < steps; ++step)
+	{
+		world.StartFrame();
+		world.RunPhysics(deltaTime);
+	}
+	result.MillisecondsBefore = MillisecondsSince(start);
+
+	world.ReorderParticles();
+	result.Stats = world.GetParticleReorderStats();
+
+	result.SimulatedCacheMissesAfter = simulateCacheMisses(contactGenerator.GetParticles(), cutoff, result.PairAccesses);
+	start = BenchmarkClock::now();
+	for (int step = 0; step < steps; ++step)
+	{
+		world.StartFrame();
+		world.RunPhysics(deltaTime);
+	}
+	result.MillisecondsAfter = MillisecondsSince(start);
+
+	removeContactGenerators(world);
+	return result;
+}
+
+ParticleBenchmark::IsolatedContactsResult ParticleBenchmark::RunIsolatedContacts(const ParticleContactResolverMode& mode, const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+	const float radius = 2;
+	const float spacing = radius * 3;
+
+	IsolatedContactsResult result;
+	result.Mode = mode;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	result.IsolatedContacts = 0;
+
+	std::vector<Vector3> positions[2];
+	for (int fastPath = 0; fastPath < 2; ++fastPath)
+	{
+		LevelBounds bounds{ -spacing, particleCount * spacing + spacing, -100, 100 };
+		ParticleWorld world(particleCount * 2, particleCount, bounds);
+		world.SetSleepEnabled(false);
+		world.SetContactResolverMode(mode);
+		world.SetIsolatedContactFastPathEnabled(fastPath == 1);
+		ParticlePlatformContactsGenerator ground(Vector3::Zero, Vector3(particleCount * spacing, 0, 0));
+		world.AddContactGenerator(&ground);
+
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> height(radius * 0.5f, radius * 1.5f);
+		for (int i = 0; i < particleCount; ++i)
+		{
+			Particle* particle = world.GetNewParticle();
+			particle->SetType(ParticleTypes::Snow);
+			particle->SetMass(2);
+			particle->SetWorldSpaceRadius(radius);
+			particle->SetBouncinessFactor(0.2f);
+			particle->SetAcceleration(Vector3::Down * 5);
+			particle->SetPosition(Vector3(i * spacing + spacing * 0.5f, height(random), 0));
+			ground.AddParticle(particle);
+		}
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int step = 0; step < steps; ++step)
+		{
+			world.StartFrame();
+			world.RunPhysics(deltaTime);
+		}
+		(fastPath ? result.MillisecondsWith : result.MillisecondsWithout) = MillisecondsSince(start);
+		if (fastPath)
+			result.IsolatedContacts = world.GetLastIsolatedContactCount();
+
+		for (Particle* particle : world.GetActiveParticles())
+		{
+			positions[fastPath].push_back(particle->GetPosition());
+		}
+
+		removeContactGenerators(world);
+	}
+
+	result.MaxPositionDifference = 0;
+	for (size_t index = 0; index < positions[0].size() && index < positions[1].size(); ++index)
+	{
+		result.MaxPositionDifference = std::max(result.MaxPositionDifference, (positions[0][index] - positions[1][index]).Length());
+	}
+	return result;
+}
+
+ParticleBenchmark::LodResult ParticleBenchmark::RunLod(const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+	const LevelBounds view{ -400, 400, -300, 300 };
+	const float halfWidth = (view.MaxX - view.MinX) * 5;
+
+	LodResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	result.DeferredShare = 0;
+
+	for (int lod = 0; lod < 2; ++lod)
+	{
+		LevelBounds bounds{ -halfWidth, halfWidth, view.MinY, view.MaxY };
+		ParticleWorld world(particleCount * 8, particleCount, bounds);
+		world.SetSleepEnabled(false);
+		world.SetLodEnabled(lod == 1);
+		world.SetLodView(view);
+		ParticlePlatformContactsGenerator ground(Vector3(-halfWidth, view.MinY, 0), Vector3(halfWidth, view.MinY, 0));
+		ParticleParticleContactGenerator particleContacts;
+		particleContacts.SetNeighbourListEnabled(true);
+		particleContacts.SetNeighbourListSkin(4.f);
+		world.AddContactGenerator(&ground);
+		world.AddContactGenerator(&particleContacts);
+
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> x(-halfWidth, halfWidth);
+		std::uniform_real_distribution<float> y(view.MinY, view.MaxY);
+		std::uniform_real_distribution<float> speed(-20, 20);
+		for (int i = 0; i < particleCount; ++i)
+		{
+			Particle* particle = world.GetNewParticle();
+			particle->SetMass(1);
+			particle->SetWorldSpaceRadius(4);
+			particle->SetBouncinessFactor(0.5f);
+			particle->SetPosition(Vector3(x(random), y(random), 0));
+			particle->SetVelocity(Vector3(speed(random), speed(random), 0));
+			ground.AddParticle(particle);
+			particleContacts.AddParticle(particle);
+		}
+
+		int contacts = 0;
+		int deferred = 0;
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int step = 0; step < steps; ++step)
+		{
+			world.StartFrame();
+			world.RunPhysics(deltaTime);
+			contacts += world.GetContactArena().GetUsed();
+			deferred += world.GetLastLodDeferredCount();
+		}
+		(lod ? result.MillisecondsWith : result.MillisecondsWithout) = MillisecondsSince(start);
+		(lod ? result.ContactsWith : result.ContactsWithout) = contacts;
+		if (lod)
+			result.DeferredShare = static_cast<float>(deferred) / static_cast<float>(particleCount * steps);
+
+		removeContactGenerators(world);
+	}
+	return result;
+}
+
+ParticleBenchmark::BallisticResult ParticleBenchmark::RunBallistic(const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	BallisticResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	result.Ballistic = 0;
+
+	std::vector<Vector3> positions[2];
+	for (int ballistic = 0; ballistic < 2; ++ballistic)
+	{
+		LevelBounds bounds{ -4000, 4000, -600, 1200 };
+		ParticleWorld world(particleCount * 2, particleCount, bounds);
+		ParticlePlatformContactsGenerator ground(Vector3(-400, -300, 0), Vector3(400, -300, 0));
+		ParticlePlatformContactsGenerator left(Vector3(-100, -100, 0), Vector3(100, 0, 0));
+		ParticlePlatformContactsGenerator right(Vector3(100, 0, 0), Vector3(250, -50, 0));
+		ParticleParticleContactGenerator particleContacts;
+		particleContacts.SetNeighbourListEnabled(true);
+		particleContacts.SetNeighbourListSkin(4.f);
+		const std::vector<ParticleManagement*> generators = { &ground, &left, &right, &particleContacts };
+		world.AddContactGenerator(&ground);
+		world.AddContactGenerator(&left);
+		world.AddContactGenerator(&right);
+		world.AddContactGenerator(&particleContacts);
+
+		world.StartFrame();
+		createSnow(world, generators, particleCount, 50, 300);
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> angle(0, 2 * DirectX::XM_PI);
+		for (Particle* particle : world.GetActiveParticles())
+		{
+			const float direction = angle(random);
+			particle->SetVelocity(Vector3(std::cos(direction), std::sin(direction), 0) * 35);
+			if (ballistic)
+				world.LaunchBallistic(particle);
+		}
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int step = 0; step < steps; ++step)
+		{
+			world.StartFrame();
+			world.RunPhysics(deltaTime);
+		}
+		(ballistic ? result.MillisecondsBallistic : result.MillisecondsIntegrated) = MillisecondsSince(start);
+		if (ballistic)
+			result.Ballistic = world.GetLastBallisticCount();
+
+		for (Particle* particle : world.GetActiveParticles())
+		{
+			positions[ballistic].push_back(particle->GetPosition());
+		}
+
+		removeContactGenerators(world);
+	}
+
+	result.MaxPositionDifference = 0;
+	for (size_t index = 0; index < positions[0].size() && index < positions[1].size(); ++index)
+	{
+		result.MaxPositionDifference = std::max(result.MaxPositionDifference, (positions[0][index] - positions[1][index]).Length());
+	}
+	return result;
+}
+
+ParticleBenchmark::EmitterResult ParticleBenchmark::RunEmitter(const int& particleCount, const int& particlesPerFrame)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	EmitterResult result;
+	result.Particles = particleCount;
+	result.ParticlesPerFrame = particlesPerFrame;
+
+	for (int bulk = 0; bulk < 2; ++bulk)
+	{
+		LevelBounds bounds{ -4000, 4000, -600, 1200 };
+		ParticleWorld world(particleCount, particleCount, bounds);
+		ParticleGroundContactsGenerator ground;
+		ParticlePlatformContactsGenerator platform(Vector3(-100, -100, 0), Vector3(100, 0, 0));
+		ParticleParticleContactGenerator particleContacts;
+		std::vector<ParticleManagement*> managers = { &ground, &platform, &particleContacts };
+
+		ParticleEmitter emitter(&world, managers, 42);
+		emitter.SetRate(particlesPerFrame / deltaTime);
+		emitter.SetLine(Vector3(-400, 300, 0), Vector3(400, 300, 0));
+		emitter.SetVelocity(Vector3::Down, DirectX::XM_PI / 4, 20, 40);
+		emitter.GetPrototype().SetMass(0.0001f);
+		emitter.GetPrototype().SetWorldSpaceRadius(2);
+		emitter.GetPrototype().SetAcceleration(Vector3::Down * 5);
+		emitter.GetPrototype().SetBouncinessFactor(0.0001f);
+		emitter.GetPrototype().SetType(ParticleTypes::Snow);
+
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> x(-400, 400);
+		std::uniform_real_distribution<float> angle(-DirectX::XM_PI / 4, DirectX::XM_PI / 4);
+		std::uniform_real_distribution<float> speed(20, 40);
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		while (world.GetActiveParticles().size() < static_cast<size_t>(particleCount))
+		{
+			if (bulk)
+			{
+				emitter.Update(deltaTime);
+				continue;
+			}
+
+			for (int i = 0; i < particlesPerFrame; ++i)
+			{
+				Particle* particle = world.GetNewParticle();
+				if (!particle)
+					break;
+				const float direction = angle(random) - DirectX::XM_PI / 2;
+				particle->SetPosition(Vector3(x(random), 300, 0));
+				particle->SetMass(0.0001f);
+				particle->SetWorldSpaceRadius(2);
+				particle->SetVelocity(Vector3(std::cos(direction), std::sin(direction), 0) * speed(random));
+				particle->SetAcceleration(Vector3::Down * 5);
+				particle->SetBouncinessFactor(0.0001f);
+				particle->SetType(ParticleTypes::Snow);
+				for (ParticleManagement* manager : managers)
+				{
+					manager->AddParticle(particle);
+				}
+			}
+		}
+		(bulk ? result.MillisecondsBulk : result.MillisecondsSingle) = MillisecondsSince(start);
+	}
+
+	{
+		LevelBounds bounds{ -4000, 4000, -600, 1200 };
+		ParticleWorld world(particleCount, particleCount, bounds);
+		Particle prototype;
+		prototype.SetMass(0.0001f);
+		prototype.SetType(ParticleTypes::Snow);
+		std::vector<Particle*> spawned(particleCount);
+
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		world.GetNewParticles(prototype, particleCount, spawned.data());
+		result.MillisecondsSpawn = MillisecondsSince(start);
+
+		std::vector<Particle> particles(particleCount);
+		start = BenchmarkClock::now();
+		std::fill(particles.begin(), particles.end(), prototype);
+		result.MillisecondsFill = MillisecondsSince(start);
+	}
+	return result;
+}
+
+ParticleBenchmark::LifetimeResult ParticleBenchmark::RunLifetime(const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	LifetimeResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+
+	for (int wheel = 0; wheel < 2; ++wheel)
+	{
+		std::vector<Particle> particles(particleCount);
+		ParticleLifetimeWheel lifetimes(deltaTime);
+		ParticleFrameAllocator frameAllocator(64 * 1024);
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> lifetime(1, 8);
+
+		float time = 0;
+		for (Particle& particle : particles)
+		{
+			particle.SetActive(true);
+			particle.SetExpiryTime(lifetime(random));
+			lifetimes.Schedule(&particle);
+		}
+
+		int expiredParticles = 0;
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		for (int step = 0; step < steps; ++step)
+		{
+			time += deltaTime;
+			frameAllocator.Reset();
+			ParticleFrameVector<Particle*> expired(&frameAllocator);
+			if (wheel)
+			{
+				lifetimes.Advance(time, expired);
+			}
+			else
+			{
+				for (Particle& particle : particles)
+				{
+					if (particle.GetExpiryTime() <= time)
+						expired.push_back(&particle);
+				}
+			}
+
+			for (Particle* particle : expired)
+			{
+				particle->SetExpiryTime(time + lifetime(random));
+				if (wheel)
+					lifetimes.Schedule(particle);
+			}
+			expiredParticles += static_cast<int>(expired.size());
+		}
+		(wheel ? result.MillisecondsWheel : result.MillisecondsScan) = MillisecondsSince(start);
+		result.Expired = expiredParticles;
+	}
+	return result;
+}
+
+ParticleBenchmark::ForceFieldResult ParticleBenchmark::RunForceField(const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+	const Vector3 gravity = Vector3::Down * 5;
+	const Vector3 fanAcceleration = Vector3::Left * 100;
+
+	ForceFieldResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	result.MaxPositionDifference = 0;
+
+	std::vector<Vector3> rewritePositions;
+	for (int field = 0; field < 2; ++field)
+	{
+		LevelBounds bounds{ -4000, 4000, -600, 1200 };
+		ParticleWorld world(particleCount * 4, particleCount, bounds);
+		ParticleGroundContactsGenerator ground;
+		world.AddContactGenerator(&ground);
+
+		ParticleForceField fan;
+		fan.Acceleration = fanAcceleration;
+		fan.Enabled = false;
+		const int fanField = world.AddForceField(fan);
+
+		createSnow(world, { &ground }, particleCount, -90, 300, gravity);
+
+		double milliseconds = 0;
+		for (int step = 0; step < steps; ++step)
+		{
+			world.StartFrame();
+			const bool fanOn = (step / 30) % 2 == 1;
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			if (field)
+			{
+				world.SetForceFieldEnabled(fanField, fanOn);
+			}
+			else
+			{
+				for (Particle* particle : world.GetActiveParticles())
+				{
+					particle->SetAcceleration(fanOn ? gravity + fanAcceleration : gravity);
+				}
+			}
+			world.RunPhysics(deltaTime);
+			milliseconds += MillisecondsSince(start);
+		}
+		(field ? result.MillisecondsField : result.MillisecondsRewrite) = milliseconds;
+
+		const std::vector<Particle*>& particles = world.GetActiveParticles();
+		for (size_t index = 0; index < particles.size(); ++index)
+		{
+			if (!field)
+			{
+				rewritePositions.push_back(particles[index]->GetPosition());
+			}
+			else if (index < rewritePositions.size())
+			{
+				result.MaxPositionDifference = std::max(result.MaxPositionDifference, (particles[index]->GetPosition() - rewritePositions[index]).Length());
+			}
+		}
+	}
+	return result;
+}
+
+ParticleBenchmark::SpatialQueryResult ParticleBenchmark::RunSpatialQueries(const int& particleCount, const int& queryCount)
+{
+	const float queryRadius = 40;
+	const int nearestCount = 8;
+
+	SpatialQueryResult result;
+	result.Particles = particleCount;
+	result.Queries = queryCount;
+	result.Mismatches = 0;
+
+	LevelBounds bounds{ -1000, 1000, -600, 600 };
+	ParticleWorld world(particleCount, particleCount, bounds);
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> x(bounds.MinX, bounds.MaxX);
+	std::uniform_real_distribution<float> y(bounds.MinY, bounds.MaxY);
+	std::uniform_real_distribution<float> radius(1, 6);
+	std::uniform_real_distribution<float> angle(0, 2 * DirectX::XM_PI);
+	for (int i = 0; i < particleCount; ++i)
+	{
+		Particle* particle = world.GetNewParticle(ParticleTypes::Snow);
+		particle->SetPosition(Vector3(x(random), y(random), 0));
+		particle->SetWorldSpaceRadius(radius(random));
+	}
+
+	std::vector<Vector3> points(queryCount);
+	std::vector<ParticleRay> rays(queryCount);
+	for (int i = 0; i < queryCount; ++i)
+	{
+		points[i] = Vector3(x(random), y(random), 0);
+		const float rayAngle = angle(random);
+		rays[i] = ParticleRay{ points[i], Vector3(std::cos(rayAngle), std::sin(rayAngle), 0), 600 };
+	}
+
+	const std::vector<Particle*>& particles = world.GetActiveParticles();
+	std::vector<Particle*> scanFound;
+	std::vector<Particle*> indexFound;
+	std::vector<std::pair<float, Particle*>> distances;
+
+	// The first query builds the index
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	world.QueryRadius(Vector3::Zero, 0, indexFound);
+	result.MillisecondsBuild = MillisecondsSince(start);
+
+	int scanCount = 0;
+	start = BenchmarkClock::now();
+	for (const Vector3& point : points)
+	{
+		for (Particle* particle : particles)
+		{
+			scanCount += (particle->GetPosition() - point).LengthSquared() <= queryRadius * queryRadius;
+		}
+	}
+	result.MillisecondsRadiusScan = MillisecondsSince(start);
+	int indexCount = 0;
+	start = BenchmarkClock::now();
+	for (const Vector3& point : points)
+	{
+		indexFound.clear();
+		indexCount += world.QueryRadius(point, queryRadius, indexFound);
+	}
+	result.MillisecondsRadiusIndex = MillisecondsSince(start);
+	result.Mismatches += scanCount != indexCount;
+
+	start = BenchmarkClock::now();
+	for (const Vector3& point : points)
+	{
+		distances.clear();
+		for (Particle* particle : particles)
+		{
+			distances.push_back(std::make_pair((particle->GetPosition() - point).LengthSquared(), particle));
+		}
+		std::partial_sort(distances.begin(), distances.begin() + std::min<size_t>(nearestCount, distances.size()), distances.end());
+	}
+	result.MillisecondsNearestScan = MillisecondsSince(start);
+	start = BenchmarkClock::now();
+	for (const Vector3& point : points)
+	{
+		indexFound.clear();
+		world.QueryNearest(point, nearestCount, indexFound);
+	}
+	result.MillisecondsNearestIndex = MillisecondsSince(start);
+	// Only the last query is compared, by distance since ties may swap
+	for (size_t i = 0; i < indexFound.size(); ++i)
+	{
+		result.Mismatches += (indexFound[i]->GetPosition() - points.back()).LengthSquared() != distances[i].first;
+	}
+
+	std::vector<float> scanDistances(queryCount, -1);
+	start = BenchmarkClock::now();
+	for (int i = 0; i < queryCount; ++i)
+	{
+		const ParticleRay& ray = rays[i];
+		for (Particle* particle : particles)
+		{
+			const Vector3 offset = ray.Origin - particle->GetPosition();
+			const float radius = particle->GetWorldSpaceRadius();
+			const float b = offset.Dot(ray.Direction);
+			const float c = offset.LengthSquared() - radius * radius;
+			const float discriminant = b * b - c;
+			if (discriminant < 0 || (c > 0 && b > 0))
+				continue;
+			const float distance = std::max(0.f, -b - std::sqrt(discriminant));
+			if (distance <= ray.MaxDistance && (scanDistances[i] < 0 || distance < scanDistances[i]))
+				scanDistances[i] = distance;
+		}
+	}
+	result.MillisecondsRayScan = MillisecondsSince(start);
+	std::vector<ParticleRayHit> hits;
+	start = BenchmarkClock::now();
+	world.Raycast(rays.data(), queryCount, hits);
+	result.MillisecondsRayIndex = MillisecondsSince(start);
+	for (int i = 0; i < queryCount; ++i)
+	{
+		const float indexDistance = hits[i].Target ? hits[i].Distance : -1;
+		result.Mismatches += std::abs(indexDistance - scanDistances[i]) > 1e-3f;
+	}
+	return result;
+}
+
+ParticleBenchmark::SnapshotResult ParticleBenchmark::RunSnapshot(const int& particleCount, const int& steps)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	SnapshotResult result;
+	result.Particles = particleCount;
+	result.Restored = true;
+
+	SnapshotScene scene(particleCount, particleCount / 2);
+	ParticleWorld& world = scene.GetWorld();
+	for (int step = 0; step < steps; ++step)
+	{
+		world.StartFrame();
+		world.RunPhysics(deltaTime);
+	}
+
+	// The second save reuses the buffer like a checkpoint would
+	std::vector<uint8_t> snapshot;
+	world.SaveSnapshot(snapshot);
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	world.SaveSnapshot(snapshot);
+	result.MillisecondsSave = MillisecondsSince(start);
+	result.Bytes = snapshot.size();
+	result.Capacity = world.GetPoolCapacity();
+
+	std::vector<uint8_t> copy(snapshot.size());
+	start = BenchmarkClock::now();
+	memcpy(copy.data(), snapshot.data(), snapshot.size());
+	result.MillisecondsCopy = MillisecondsSince(start);
+
+	// Steps on from the snapshot in the world itself, then restores it
+	// into the world, a fresh world of the same capacity and a fresh
+	// world whose storage has to grow
+	std::vector<Vector3> positions;
+	for (int pass = 0; pass < 4; ++pass)
+	{
+		std::unique_ptr<SnapshotScene> fresh;
+		if (pass >= 2)
+			fresh = std::make_unique<SnapshotScene>(particleCount, pass == 2 ? result.Capacity : particleCount + SnapshotScene::RopeLength);
+		ParticleWorld& target = fresh ? fresh->GetWorld() : world;
+		if (pass > 0)
+		{
+			target.StartFrame();
+			start = BenchmarkClock::now();
+			result.Restored &= target.RestoreSnapshot(snapshot.data(), snapshot.size());
+			const double milliseconds = MillisecondsSince(start);
+			(pass == 1 ? result.MillisecondsRestore : pass == 2 ? result.MillisecondsRestoreFresh : result.MillisecondsRestoreGrow) = milliseconds;
+		}
+		for (int step = 0; step < steps; ++step)
+		{
+			target.StartFrame();
+			target.RunPhysics(deltaTime);
+		}
+
+		const std::vector<Particle*>& particles = target.GetActiveParticles();
+		if (pass == 0)
+			positions.resize(particles.size());
+		float difference = particles.size() == positions.size() ? 0 : std::numeric_limits<float>::max();
+		for (size_t index = 0; index < particles.size() && index < positions.size(); ++index)
+		{
+			if (pass == 0)
+				positions[index] = particles[index]->GetPosition();
+			else
+				difference = std::max(difference, (particles[index]->GetPosition() - positions[index]).Length());
+		}
+		if (pass > 0)
+			result.MaxPositionDifference = pass == 1 ? difference : std::max(result.MaxPositionDifference, difference);
+	}
+	return result;
+}
+
+ParticleBenchmark::RewindResult ParticleBenchmark::RunRewind(const int& particleCount, const int& steps, const size_t& memoryBudget)
+{
+	const float deltaTime = 1.f / 60.f;
+
+	RewindResult result;
+	result.Particles = particleCount;
+	result.Steps = steps;
+	result.MillisecondsSave = 0;
+	result.MillisecondsEncode = 0;
+	result.Checks = 0;
+	result.Mismatches = 0;
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		LevelBounds bounds{ -4000, 4000, -600, 1200 };
+		ParticleWorld world(particleCount * 4, particleCount, bounds);
+		ParticleGroundContactsGenerator ground;
+		ParticleParticleContactGenerator particleContacts;
+		world.AddContactGenerator(&ground);
+		world.AddContactGenerator(&particleContacts);
+
+		createSnow(world, { &ground, &particleContacts }, particleCount);
+
+		std::unique_ptr<ParticleRewindRecorder> recorder;
+		if (pass == 1)
+			recorder = std::make_unique<ParticleRewindRecorder>(&world, memoryBudget);
+
+		// Frames are numbered by their step, a few of them are saved whole
+		// besides, outside of the timing
+		const int checkedSteps[] = { steps - 61, steps - 31, steps - 7, steps - 1 };
+		std::vector<std::pair<int, std::vector<uint8_t>>> saved;
+		double milliseconds = 0;
+		double saveMilliseconds = 0;
+		double encodeMilliseconds = 0;
+		for (int step = 0; step < steps; ++step)
+		{
+			const BenchmarkClock::time_point start = BenchmarkClock::now();
+			world.StartFrame();
+			world.RunPhysics(deltaTime);
+			if (recorder)
+			{
+				recorder->Capture();
+				const ParticleRewindStats stats = recorder->GetStats();
+				saveMilliseconds += stats.LastSaveMilliseconds;
+				encodeMilliseconds += stats.LastEncodeMilliseconds;
+			}
+			milliseconds += MillisecondsSince(start);
+
+			if (recorder && std::find(std::begin(checkedSteps), std::end(checkedSteps), step) != std::end(checkedSteps))
+			{
+				saved.emplace_back(step, std::vector<uint8_t>());
+				world.SaveSnapshot(saved.back().second);
+			}
+		}
+		if (!recorder)
+		{
+			result.MillisecondsStep = milliseconds / steps;
+			continue;
+		}
+
+		result.MillisecondsStepRecorded = milliseconds / steps;
+		result.MillisecondsSave = saveMilliseconds / steps;
+		result.MillisecondsEncode = encodeMilliseconds / steps;
+
+		const int firstFrame = recorder->GetFirstFrame();
+		const int lastFrame = recorder->GetLastFrame();
+		std::mt19937 random(42);
+		std::uniform_int_distribution<int> frames(firstFrame, lastFrame);
+		const int restores = 32;
+		double restoreMilliseconds = 0;
+		for (int restore = 0; restore < restores; ++restore)
+		{
+			world.StartFrame();
+			recorder->Restore(frames(random));
+			restoreMilliseconds += recorder->GetStats().LastRestoreMilliseconds;
+		}
+		result.MillisecondsRestore = restoreMilliseconds / restores;
+
+		const ParticleRewindStats stats = recorder->GetStats();
+		result.MillisecondsCapture = stats.TotalCaptureMilliseconds / stats.Captures;
+		result.Frames = stats.Frames;
+		result.Keyframes = stats.Keyframes;
+		result.FrameBytes = stats.FrameBytes;
+		result.RawBytes = stats.RawBytes;
+		result.WorkingBytes = stats.WorkingBytes;
+
+		std::vector<uint8_t> restored;
+		auto check = [&world, &recorder, &restored, &result](const int& frame, const std::vector<uint8_t>& snapshot)
+		{
+			++result.Checks;
+			world.StartFrame();
+			if (!recorder->Restore(frame))
+			{
+				++result.Mismatches;
+				return;
+			}
+			world.SaveSnapshot(restored);
+			result.Mismatches += restored != snapshot ? 1 : 0;
+		};
+		for (const std::pair<int, std::vector<uint8_t>>& frame : saved)
+		{
+			if (frame.first >= firstFrame)
+				check(frame.first, frame.second);
+		}
+
+		// The recording goes on from the first checked frame with the snow
+		// pushed up, the frames after it are dropped for the new ones
+		const std::pair<int, std::vector<uint8_t>>& branch = saved.front().first >= firstFrame ? saved.front() : saved.back();
+		world.StartFrame();
+		recorder->Restore(branch.first);
+		std::vector<std::pair<int, std::vector<uint8_t>>> branched;
+		for (int step = 1; step <= 10; ++step)
+		{
+			world.StartFrame();
+			if (step == 1)
+			{
+				for (Particle* particle : world.GetActiveParticles())
+				{
+					world.GetCommandBuffer().AddParticleVelocity(particle, Vector3::Up * 20);
+				}
+			}
+			world.RunPhysics(deltaTime);
+			recorder->Capture();
+			if (step % 5 == 0)
+			{
+				branched.emplace_back(branch.first + step, std::vector<uint8_t>());
+				world.SaveSnapshot(branched.back().second);
+			}
+		}
+		++result.Checks;
+		result.Mismatches += recorder->GetLastFrame() != branch.first + 10 ? 1 : 0;
+		for (const std::pair<int, std::vector<uint8_t>>& frame : branched)
+		{
+			check(frame.first, frame.second);
+		}
+		check(branch.first, branch.second);
+	}
+	return result;
+}
+
+void ParticleBenchmark::RunAll()
+{
+	const int particleCounts[] = { 256, 1024, 2048 };
+	const unsigned sweeps[] = { 1, 4, 8 };
+
+	const float timeBudget = 0.002f;
+
+	print("--- contact resolver: iterative vs graph colored ---\n");
+	for (int particleCount : particleCounts)
+	{
+		ContactResolverResult iterative = RunContactResolver(ParticleContactResolverMode::Iterative, particleCount, 0);
+		print("iterative      particles %5d contacts %5d: %9.3f ms, penetration %7.3f -> %7.3f, closing velocity %8.3f -> %8.3f, %u iterations (%s)\n",
+			iterative.Particles, iterative.Contacts, iterative.Milliseconds,
+			iterative.MaxPenetrationBefore, iterative.MaxPenetrationAfter, iterative.MaxClosingVelocityBefore, iterative.MaxClosingVelocityAfter,
+			iterative.Iterations, stopReasonName(iterative.StopReason));
+
+		ContactResolverResult budgeted = RunContactResolver(ParticleContactResolverMode::Iterative, particleCount, 0, timeBudget);
+		print("iterative 2 ms particles %5d contacts %5d: %9.3f ms, penetration %7.3f -> %7.3f, closing velocity %8.3f -> %8.3f, %u iterations (%s)\n",
+			budgeted.Particles, budgeted.Contacts, budgeted.Milliseconds,
+			budgeted.MaxPenetrationBefore, budgeted.MaxPenetrationAfter, budgeted.MaxClosingVelocityBefore, budgeted.MaxClosingVelocityAfter,
+			budgeted.Iterations, stopReasonName(budgeted.StopReason));
+
+		for (unsigned sweepCount : sweeps)
+		{
+			ContactResolverResult colored = RunContactResolver(ParticleContactResolverMode::GraphColored, particleCount, sweepCount);
+			print("graph colored  particles %5d contacts %5d: %9.3f ms, penetration %7.3f -> %7.3f, closing velocity %8.3f -> %8.3f, %u sweeps, %u colors (%s)\n",
+				colored.Particles, colored.Contacts, colored.Milliseconds,
+				colored.MaxPenetrationBefore, colored.MaxPenetrationAfter, colored.MaxClosingVelocityBefore, colored.MaxClosingVelocityAfter,
+				sweepCount, colored.Colors, stopReasonName(colored.StopReason));
+		}
+	}
+
+	print("--- particle contacts: brute force vs neighbour list ---\n");
+	for (int particleCount : particleCounts)
+	{
+		NeighbourListResult neighbours = RunNeighbourList(particleCount, 120, 4.f);
+		print("particles %5d, %d steps, %7d contacts: brute force %9.3f ms, neighbour list %9.3f ms (%d rebuilds, %d pairs, rebuilds %.3f ms, checks %.3f ms, saved about %.3f ms)\n",
+			neighbours.Particles, neighbours.Steps, neighbours.Contacts, neighbours.BruteForceMilliseconds, neighbours.NeighbourListMilliseconds,
+			neighbours.Stats.Rebuilds, neighbours.Stats.Pairs, neighbours.Stats.RebuildMilliseconds, neighbours.Stats.UpdateMilliseconds,
+			neighbours.Stats.EstimatedSavedMilliseconds());
+	}
+
+	print("--- particle contacts: ordered pairs vs each pair once on a dense pile ---\n");
+	for (int particleCount : particleCounts)
+	{
+		PileContactsResult pile = RunPileContacts(particleCount, 10);
+		print("particles %5d: %6d contacts, %d duplicate pairs, %d mismatches, %9.3f ms -> %9.3f ms\n",
+			pile.Particles, pile.Contacts, pile.DuplicatePairs, pile.Mismatches, pile.MillisecondsReference, pile.Milliseconds);
+	}
+
+	print("--- isolated contacts: contact resolver vs closed form ---\n");
+	const ParticleContactResolverMode modes[] = { ParticleContactResolverMode::Iterative, ParticleContactResolverMode::GraphColored };
+	for (const ParticleContactResolverMode& mode : modes)
+	{
+		for (int particleCount : particleCounts)
+		{
+			IsolatedContactsResult isolated = RunIsolatedContacts(mode, particleCount, 60);
+			print("%s particles %5d, %d steps, %5d isolated contacts: %9.3f ms -> %9.3f ms, max position difference %g\n",
+				mode == ParticleContactResolverMode::Iterative ? "iterative    " : "graph colored", isolated.Particles, isolated.Steps,
+				isolated.IsolatedContacts, isolated.MillisecondsWithout, isolated.MillisecondsWith, isolated.MaxPositionDifference);
+		}
+	}
+
+	print("--- particle storage: spawn order vs Z-order ---\n");
+	for (int particleCount : particleCounts)
+	{
+		ParticleReorderResult reorder = RunParticleReorder(particleCount, 60);
+		print("particles %5d, %d steps: %9.3f ms -> %9.3f ms, simulated cache misses %lld -> %lld (%lld pair accesses), locality %.2f -> %.2f, reorder %.3f ms\n",
+			reorder.Particles, reorder.Steps, reorder.MillisecondsBefore, reorder.MillisecondsAfter,
+			reorder.SimulatedCacheMissesBefore, reorder.SimulatedCacheMissesAfter, reorder.PairAccesses,
+			reorder.Stats.LocalityBefore, reorder.Stats.LocalityAfter, reorder.Stats.LastMilliseconds);
+	}
+
+	print("--- level of detail: full vs by distance to the view ---\n");
+	for (int particleCount : particleCounts)
+	{
+		LodResult lod = RunLod(particleCount * 4, 120);
+		print("particles %5d, %d steps: %9.3f ms -> %9.3f ms, %7d -> %7d contacts, %.0f%% deferred\n",
+			lod.Particles, lod.Steps, lod.MillisecondsWithout, lod.MillisecondsWith, lod.ContactsWithout, lod.ContactsWith, lod.DeferredShare * 100.f);
+	}
+
+	print("--- free-flying snow: integrated vs ballistic ---\n");
+	for (int particleCount : particleCounts)
+	{
+		BallisticResult ballistic = RunBallistic(particleCount * 2, 240);
+		print("particles %5d, %d steps: %9.3f ms -> %9.3f ms, %5d still ballistic, max position difference %g\n",
+			ballistic.Particles, ballistic.Steps, ballistic.MillisecondsIntegrated, ballistic.MillisecondsBallistic,
+			ballistic.Ballistic, ballistic.MaxPositionDifference);
+	}
+
+	print("--- emitters: one particle after the other vs bulk ---\n");
+	const int particlesPerFrame[] = { 1, 16, 256 };
+	for (int perFrame : particlesPerFrame)
+	{
+		EmitterResult emitter = RunEmitter(16384, perFrame);
+		print("particles %5d, %3d per frame: %9.3f ms -> %9.3f ms, spawning %7.3f ms vs plain fill %7.3f ms\n",
+			emitter.Particles, emitter.ParticlesPerFrame, emitter.MillisecondsSingle, emitter.MillisecondsBulk,
+			emitter.MillisecondsSpawn, emitter.MillisecondsFill);
+	}
+
+	print("--- lifetime: scanning all particles vs timing wheel ---\n");
+	for (int particleCount : particleCounts)
+	{
+		LifetimeResult lifetime = RunLifetime(particleCount * 16, 600);
+		print("particles %6d, %d steps, %6d expired: %9.3f ms -> %9.3f ms\n",
+			lifetime.Particles, lifetime.Steps, lifetime.Expired, lifetime.MillisecondsScan, lifetime.MillisecondsWheel);
+	}
+
+	print("--- fan: rewriting every acceleration vs force field ---\n");
+	for (int particleCount : particleCounts)
+	{
+		ForceFieldResult forceField = RunForceField(particleCount * 2, 240);
+		print("particles %5d, %d steps: %9.3f ms -> %9.3f ms, max position difference %g\n",
+			forceField.Particles, forceField.Steps, forceField.MillisecondsRewrite, forceField.MillisecondsField,
+			forceField.MaxPositionDifference);
+	}
+
+	print("--- queries: scanning all particles vs spatial index ---\n");
+	for (int particleCount : particleCounts)
+	{
+		SpatialQueryResult queries = RunSpatialQueries(particleCount * 8, 1000);
+		print("particles %5d, %d queries, build %7.3f ms: radius %8.3f ms -> %7.3f ms, nearest %8.3f ms -> %7.3f ms, ray %8.3f ms -> %7.3f ms, %d mismatches\n",
+			queries.Particles, queries.Queries, queries.MillisecondsBuild,
+			queries.MillisecondsRadiusScan, queries.MillisecondsRadiusIndex,
+			queries.MillisecondsNearestScan, queries.MillisecondsNearestIndex,
+			queries.MillisecondsRayScan, queries.MillisecondsRayIndex, queries.Mismatches);
+	}
+
+	print("--- snapshot: save and restore vs memcpy ---\n");
+	for (int particleCount : particleCounts)
+	{
+		SnapshotResult snapshot = RunSnapshot(particleCount * 8, 120);
+		print("particles %5d, %8zu bytes: save %7.3f ms, restore %7.3f ms, into a fresh world %7.3f ms, growing it %7.3f ms, memcpy %7.3f ms, %s, max position difference %g\n",
+			snapshot.Particles, snapshot.Bytes, snapshot.MillisecondsSave, snapshot.MillisecondsRestore, snapshot.MillisecondsRestoreFresh,
+			snapshot.MillisecondsRestoreGrow, snapshot.MillisecondsCopy, snapshot.Restored ? "restored" : "FAILED", snapshot.MaxPositionDifference);
+	}
+
+	print("--- rewind: stepping with a recorder capturing every step ---\n");
+	for (int particleCount : particleCounts)
+	{
+		RewindResult rewind = RunRewind(particleCount * 2, 240, 64 << 20);
+		print("particles %5d, %d steps: step %7.3f ms -> %7.3f ms, capture %6.3f ms, save %6.3f ms, encode %6.3f ms, restore %6.3f ms, %d frames (%d keyframes) %9zu bytes of %10zu raw, working %8zu bytes, %d of %d restores mismatched\n",
+			rewind.Particles, rewind.Steps, rewind.MillisecondsStep, rewind.MillisecondsStepRecorded,
+			rewind.MillisecondsCapture, rewind.MillisecondsSave, rewind.MillisecondsEncode, rewind.MillisecondsRestore,
+			rewind.Frames, rewind.Keyframes, rewind.FrameBytes, rewind.RawBytes, rewind.WorkingBytes, rewind.Mismatches, rewind.Checks);
+	}
+}
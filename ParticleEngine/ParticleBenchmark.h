@@ -0,0 +1,309 @@
+#pragma once
+
+/**
+* Benchmarks of the physics systems. Every benchmark builds its own
+* synthetic scene with a fixed seed, so results are comparable between
+* runs, and prints a summary to the debug output.
+*/
+namespace ParticleBenchmark
+{
+	typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+	/**
+	* Also times the systems which report their own timings, see
+	* ParticleRewindStats.
+	*/
+	inline double MillisecondsSince(const BenchmarkClock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+	}
+
+	struct ContactResolverResult
+	{
+		ParticleContactResolverMode Mode;
+		int Particles;
+		int Contacts;
+		unsigned Colors;
+		unsigned Iterations;
+		ParticleContactResolverStopReason StopReason;
+		double Milliseconds;
+
+		// Residual of the generated contacts before and after resolution
+		float MaxPenetrationBefore;
+		float MaxClosingVelocityBefore;
+		float MaxPenetrationAfter;
+		float MaxClosingVelocityAfter;
+	};
+
+	/**
+	* Resolves one step of a dense pile of particles resting on the
+	* ground with the given resolver mode. The iterative resolver gets
+	* twice as many iterations as contacts, the same as ParticleWorld
+	* uses by default, and may use at most timeBudget seconds.
+	*/
+	ContactResolverResult RunContactResolver(const ParticleContactResolverMode& mode, const int& particleCount, const unsigned& batchSweeps, const float& timeBudget = 0);
+
+	struct NeighbourListResult
+	{
+		int Particles;
+		int Steps;
+		int Contacts;
+		double BruteForceMilliseconds;
+		double NeighbourListMilliseconds;
+		ParticleNeighbourListStats Stats;
+	};
+
+	/**
+	* Simulates slowly drifting particles for a number of steps and
+	* measures the particle-particle contact generation with and without
+	* the neighbour list. Both see the same particle positions.
+	*/
+	NeighbourListResult RunNeighbourList(const int& particleCount, const int& steps, const float& skin);
+
+	struct PileContactsResult
+	{
+		int Particles;
+		int Contacts;
+		// Pairs found more than once, has to be zero
+		int DuplicatePairs;
+		double Milliseconds;
+		// The loop over every ordered pair which looked up the pairs it
+		// had found already, as the generator did before it enumerated
+		// each pair once
+		double MillisecondsReference;
+		// Contacts which differ from the ones of that loop in their order,
+		// particles, normal, penetration or restitution, has to be zero
+		int Mismatches;
+	};
+
+	/**
+	* Generates the particle-particle contacts of a dense pile with the
+	* brute force generator, repeats times, checks that every pair has at
+	* most one contact and compares the contacts with the ones of the
+	* old loop.
+	*/
+	PileContactsResult RunPileContacts(const int& particleCount, const int& repeats);
+
+	struct ParticleReorderResult
+	{
+		int Particles;
+		int Steps;
+		double MillisecondsBefore;
+		double MillisecondsAfter;
+		// Misses of a simulated 32 KiB direct mapped cache while walking
+		// the neighbour pairs in the order of the contact generator
+		long long SimulatedCacheMissesBefore;
+		long long SimulatedCacheMissesAfter;
+		long long PairAccesses;
+		ParticleReorderStats Stats;
+	};
+
+	/**
+	* Spawns particles in random order over the level, so neighbours are
+	* scattered in the storage, and measures the physics steps and the
+	* cache behaviour of the particle-particle contacts before and after
+	* ParticleWorld::ReorderParticles. Hardware cache counters aren't
+	* available portably, so the misses are simulated.
+	*/
+	ParticleReorderResult RunParticleReorder(const int& particleCount, const int& steps);
+
+	struct IsolatedContactsResult
+	{
+		ParticleContactResolverMode Mode;
+		int Particles;
+		int Steps;
+		// Isolated contacts of the last step with the fast path
+		int IsolatedContacts;
+		double MillisecondsWithout;
+		double MillisecondsWith;
+		// Largest distance between the particles of both runs at the end
+		float MaxPositionDifference;
+	};
+
+	/**
+	* Settles snow on the ground, a few particles apart, and runs the
+	* same world with and without the closed form resolution of the
+	* isolated contacts.
+	*/
+	IsolatedContactsResult RunIsolatedContacts(const ParticleContactResolverMode& mode, const int& particleCount, const int& steps);
+
+	struct LodResult
+	{
+		int Particles;
+		int Steps;
+		// Share of the awake particles whose integration was deferred,
+		// averaged over the steps
+		float DeferredShare;
+		int ContactsWithout;
+		int ContactsWith;
+		double MillisecondsWithout;
+		double MillisecondsWith;
+	};
+
+	/**
+	* Spreads drifting particles over a level ten views wide and runs
+	* the same world with and without the level of detail, the view is
+	* in the middle of the level.
+	*/
+	LodResult RunLod(const int& particleCount, const int& steps);
+
+	struct BallisticResult
+	{
+		int Particles;
+		int Steps;
+		// Particles still in ballistic flight after the last step
+		int Ballistic;
+		double MillisecondsIntegrated;
+		double MillisecondsBallistic;
+		// Largest distance between the particles of both runs at the end
+		float MaxPositionDifference;
+	};
+
+	/**
+	* Launches snow above the platforms of the game scene, the same way
+	* as BlizzardParticleEmitter does, and runs the same world with
+	* integrated and with ballistic particles.
+	*/
+	BallisticResult RunBallistic(const int& particleCount, const int& steps);
+
+	struct EmitterResult
+	{
+		int Particles;
+		int ParticlesPerFrame;
+		double MillisecondsSingle;
+		double MillisecondsBulk;
+		// Taking all the particles from the pool of the world alone, and
+		// filling the same number of particles with a plain copy
+		double MillisecondsSpawn;
+		double MillisecondsFill;
+	};
+
+	/**
+	* Spawns snow into a world with three contact generators until its
+	* pool is empty, one particle after the other as the emitters did
+	* before and in bulk through a ParticleEmitter. The spawning of the
+	* world itself is measured against a plain fill of the particles.
+	*/
+	EmitterResult RunEmitter(const int& particleCount, const int& particlesPerFrame);
+
+	struct LifetimeResult
+	{
+		int Particles;
+		int Steps;
+		// Particles which expired and were spawned again
+		int Expired;
+		double MillisecondsScan;
+		double MillisecondsWheel;
+	};
+
+	/**
+	* Gives every particle a lifetime of a few seconds and spawns it
+	* again when it expires. Finds the expired particles of every step by
+	* scanning all of them and with a ParticleLifetimeWheel.
+	*/
+	LifetimeResult RunLifetime(const int& particleCount, const int& steps);
+
+	struct ForceFieldResult
+	{
+		int Particles;
+		int Steps;
+		double MillisecondsRewrite;
+		double MillisecondsField;
+		// Between the particles of both runs after the last step
+		float MaxPositionDifference;
+	};
+
+	/**
+	* Snow falls onto the ground while a fan is switched on and off every
+	* half second, once by rewriting the acceleration of every particle
+	* as the game did and once through a force field of the world.
+	*/
+	ForceFieldResult RunForceField(const int& particleCount, const int& steps);
+
+	struct SpatialQueryResult
+	{
+		int Particles;
+		int Queries;
+		double MillisecondsBuild;
+		double MillisecondsRadiusScan;
+		double MillisecondsRadiusIndex;
+		double MillisecondsNearestScan;
+		double MillisecondsNearestIndex;
+		double MillisecondsRayScan;
+		double MillisecondsRayIndex;
+		// Queries whose results differ between scan and index
+		int Mismatches;
+	};
+
+	/**
+	* Radius, nearest and ray queries into a field of snow, once by
+	* scanning all active particles and once through the spatial index
+	* of the world.
+	*/
+	SpatialQueryResult RunSpatialQueries(const int& particleCount, const int& queryCount);
+
+	struct SnapshotResult
+	{
+		int Particles;
+		int Capacity;
+		size_t Bytes;
+		double MillisecondsSave;
+		double MillisecondsRestore;
+		// Into a fresh world of the same capacity, and one whose storage
+		// grows to the snapshot
+		double MillisecondsRestoreFresh;
+		double MillisecondsRestoreGrow;
+		// Copying the same number of bytes with memcpy, for comparison
+		double MillisecondsCopy;
+		bool Restored;
+		// Between stepping on from the snapshot and stepping on after
+		// restoring it, the largest of all restores
+		float MaxPositionDifference;
+	};
+
+	/**
+	* Snow piles up on the ground next to a rope of cloth on springs and
+	* is saved to a snapshot. The snapshot is restored after the world
+	* stepped on, into a fresh world and into a fresh world with a
+	* smaller storage.
+	*/
+	SnapshotResult RunSnapshot(const int& particleCount, const int& steps);
+
+	struct RewindResult
+	{
+		int Particles;
+		int Steps;
+		double MillisecondsStep;
+		// Per step with a ParticleRewindRecorder capturing after every step
+		double MillisecondsStepRecorded;
+		double MillisecondsCapture;
+		// Snapshot and encoding in the background
+		double MillisecondsSave;
+		double MillisecondsEncode;
+		double MillisecondsRestore;
+		int Frames;
+		int Keyframes;
+		size_t FrameBytes;
+		size_t RawBytes;
+		size_t WorkingBytes;
+		// Restored frames compared byte for byte with snapshots saved when
+		// they were recorded
+		int Checks;
+		int Mismatches;
+	};
+
+	/**
+	* Snow falls onto the ground once as it is and once recorded for
+	* rewinding, after which frames of the window are restored at random.
+	* A few restored frames are checked against snapshots of the world
+	* saved when they were recorded. The recording then goes on from a
+	* restored frame with the snow pushed differently, and the frames of
+	* the new timeline are checked the same way.
+	*/
+	RewindResult RunRewind(const int& particleCount, const int& steps, const size_t& memoryBudget);
+
+	/**
+	* Runs all benchmarks and prints them to the debug output.
+	*/
+	void RunAll();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+/**
+* What happens when two overlapping particles touch, seen from the
+* first particle of the pair.
+*/
+enum class ParticleInteraction : int
+{
+	// The pair is never looked at
+	Ignore,
+	Collide,
+	// One particle of the pair is destroyed, the other one carries on
+	// as if nothing happened
+	DestroyFirst,
+	DestroySecond
+};
+
+const int ParticleTypeCount = static_cast<int>(ParticleTypes::Cloth) + 1;
+
+/**
+* The interaction of every pair of particle types, rows are the type
+* of the first particle, columns the type of the second one. The table
+* has to be symmetric, destroying the first particle of a pair mirrors
+* destroying the second one.
+*/
+constexpr ParticleInteraction ParticleInteractionTable[ParticleTypeCount][ParticleTypeCount] =
+{
+	//            None                              Ball                                Snow                                Cloth
+	/* None  */ { ParticleInteraction::Collide,     ParticleInteraction::Collide,       ParticleInteraction::Collide,       ParticleInteraction::Collide },
+	/* Ball  */ { ParticleInteraction::Collide,     ParticleInteraction::Collide,       ParticleInteraction::DestroySecond, ParticleInteraction::Collide },
+	/* Snow  */ { ParticleInteraction::Collide,     ParticleInteraction::DestroyFirst,  ParticleInteraction::Ignore,        ParticleInteraction::DestroyFirst },
+	/* Cloth */ { ParticleInteraction::Collide,     ParticleInteraction::Collide,       ParticleInteraction::DestroySecond, ParticleInteraction::Collide },
+};
+
+// The categories of the types which the given type doesn't ignore
+constexpr unsigned ComputeParticleCollisionMask(const int& type)
+{
+	unsigned mask = 0;
+	for (int other = 0; other < ParticleTypeCount; ++other)
+	{
+		if (ParticleInteractionTable[type][other] != ParticleInteraction::Ignore)
+			mask |= 1u << other;
+	}
+	return mask;
+}
+
+constexpr unsigned ParticleCollisionMasks[ParticleTypeCount] =
+{
+	ComputeParticleCollisionMask(0),
+	ComputeParticleCollisionMask(1),
+	ComputeParticleCollisionMask(2),
+	ComputeParticleCollisionMask(3),
+};
+static_assert(ParticleTypeCount == 4, "ParticleCollisionMasks needs a mask for every particle type");
+
+/**
+* Collision categories and masks of the particle types, derived from
+* the interaction table at compile time. Every type is its own
+* category and its mask holds the categories it doesn't ignore, so two
+* particles interact if each one's category is in the other one's mask.
+* The broadphase checks this per pair of types and skips the pairs of
+* whole groups of particles which can't interact.
+*/
+class ParticleCollisionFilter
+{
+public:
+	static constexpr ParticleInteraction GetInteraction(const ParticleTypes& first, const ParticleTypes& second)
+	{
+		return ParticleInteractionTable[static_cast<int>(first)][static_cast<int>(second)];
+	}
+
+	static constexpr unsigned GetCategory(const ParticleTypes& type)
+	{
+		return 1u << static_cast<int>(type);
+	}
+
+	static constexpr unsigned GetMask(const ParticleTypes& type)
+	{
+		return ParticleCollisionMasks[static_cast<int>(type)];
+	}
+
+	static constexpr bool CanInteract(const ParticleTypes& lhs, const ParticleTypes& rhs)
+	{
+		return (GetCategory(lhs) & GetMask(rhs)) != 0 && (GetCategory(rhs) & GetMask(lhs)) != 0;
+	}
+
+	static constexpr bool IsTableSymmetric()
+	{
+		for (int first = 0; first < ParticleTypeCount; ++first)
+		{
+			for (int second = 0; second < ParticleTypeCount; ++second)
+			{
+				if (ParticleInteractionTable[first][second] != mirror(ParticleInteractionTable[second][first]))
+					return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	static constexpr ParticleInteraction mirror(const ParticleInteraction& interaction)
+	{
+		return interaction == ParticleInteraction::DestroyFirst ? ParticleInteraction::DestroySecond :
+			interaction == ParticleInteraction::DestroySecond ? ParticleInteraction::DestroyFirst : interaction;
+	}
+};
+
+static_assert(ParticleCollisionFilter::IsTableSymmetric(), "the particle interaction table has to be symmetric");
+static_assert(!ParticleCollisionFilter::CanInteract(ParticleTypes::Snow, ParticleTypes::Snow), "snow never interacts with snow");
@@ -0,0 +1,96 @@
+#include "pch.h"
+#include "ParticleCommandBuffer.h"
+
+using namespace DirectX::SimpleMath;
+
+void ParticleCommandBuffer::Spawn(const Particle& prototype, const uint32_t& contactGeneratorTags, const float& lifetime, const bool& ballistic)
+{
+	SpawnCommand command{ prototype, contactGeneratorTags, lifetime, ballistic };
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.Spawns.push_back(command);
+}
+
+void ParticleCommandBuffer::Despawn(Particle* particle)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.Despawns.push_back(particle);
+}
+
+void ParticleCommandBuffer::DespawnAll(const ParticleTypes& type)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.DespawnTypes |= ParticleCollisionFilter::GetCategory(type);
+}
+
+void ParticleCommandBuffer::SetForceField(const int& handle, const ParticleForceField& field)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.ForceFields.push_back(ForceFieldCommand{ handle, field, false });
+}
+
+void ParticleCommandBuffer::SetForceFieldEnabled(const int& handle, const bool& enabled)
+{
+	ParticleForceField field;
+	field.Enabled = enabled;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.ForceFields.push_back(ForceFieldCommand{ handle, field, true });
+}
+
+void ParticleCommandBuffer::SetAcceleration(const unsigned& typeMask, const DirectX::SimpleMath::Vector3& acceleration)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.Edits.push_back(EditCommand{ EditKind::SetAcceleration, typeMask, acceleration });
+}
+
+void ParticleCommandBuffer::AddVelocity(const unsigned& typeMask, const DirectX::SimpleMath::Vector3& velocity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.Edits.push_back(EditCommand{ EditKind::AddVelocity, typeMask, velocity });
+}
+
+void ParticleCommandBuffer::AddParticleVelocity(Particle* particle, const DirectX::SimpleMath::Vector3& velocity)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_queued.ParticleVelocities.push_back(ParticleVelocityCommand{ particle, velocity });
+}
+
+bool ParticleCommandBuffer::IsEmpty()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queued.IsEmpty();
+}
+
+void ParticleCommandBuffer::Take(Batch& batch)
+{
+	assert(batch.IsEmpty());
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::swap(m_queued, batch);
+}
+
+void ParticleCommandBuffer::RemapParticles(const ParticleRemap& remap)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Particle*& particle : m_queued.Despawns)
+	{
+		particle = remap(particle);
+	}
+	for (ParticleVelocityCommand& command : m_queued.ParticleVelocities)
+	{
+		command.Target = remap(command.Target);
+	}
+}
+
+bool ParticleCommandBuffer::Batch::IsEmpty() const
+{
+	return Despawns.empty() && DespawnTypes == 0 && ForceFields.empty() && Edits.empty() && ParticleVelocities.empty() && Spawns.empty();
+}
+
+void ParticleCommandBuffer::Batch::Clear()
+{
+	Despawns.clear();
+	DespawnTypes = 0;
+	ForceFields.clear();
+	Edits.clear();
+	ParticleVelocities.clear();
+	Spawns.clear();
+}
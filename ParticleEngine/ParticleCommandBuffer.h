@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+* Changes to a ParticleWorld which are queued instead of made at once,
+* from any thread. The world applies them in batches at its sync points,
+* the start of StartFrame and of RunPhysics, so nothing changes the
+* particle storage, the contact generators or the force fields while
+* the world is iterating over them. Within a batch the world applies
+* all despawns first, then the force field changes, the edits of
+* types, the edits of single particles and the spawns, each kind in the
+* order it was queued.
+*/
+class ParticleCommandBuffer
+{
+public:
+	/**
+	* Spawns a copy of the prototype, like ParticleWorld::GetNewParticles
+	* does, and adds it to the contact generators of the world whose tag
+	* is in contactGeneratorTags and to the ones without a tag. A lifetime
+	* above zero is set with ParticleWorld::SetParticleLifetime, a
+	* ballistic particle is launched with ParticleWorld::LaunchBallistic.
+	* Particles the pool policy of the type doesn't give are dropped.
+	*/
+	void Spawn(const Particle& prototype, const uint32_t& contactGeneratorTags = AllContactGenerators, const float& lifetime = 0, const bool& ballistic = false);
+
+	/**
+	* Returns the particle to the pool. Particles which already went back
+	* to the pool in the meantime are ignored, unless they were spawned
+	* again.
+	*/
+	void Despawn(Particle* particle);
+	void DespawnAll(const ParticleTypes& type);
+
+	void SetForceField(const int& handle, const ParticleForceField& field);
+	void SetForceFieldEnabled(const int& handle, const bool& enabled);
+
+	/**
+	* Edits every active particle of the types in typeMask, see
+	* ParticleCollisionFilter::GetCategory.
+	*/
+	void SetAcceleration(const unsigned& typeMask, const DirectX::SimpleMath::Vector3& acceleration);
+	void AddVelocity(const unsigned& typeMask, const DirectX::SimpleMath::Vector3& velocity);
+
+	/**
+	* Edits a single particle. Particles which went back to the pool in
+	* the meantime are ignored, as with Despawn.
+	*/
+	void AddParticleVelocity(Particle* particle, const DirectX::SimpleMath::Vector3& velocity);
+
+	bool IsEmpty();
+
+	static const uint32_t AllContactGenerators = ~0u;
+
+	struct SpawnCommand
+	{
+		Particle Prototype;
+		uint32_t ContactGeneratorTags;
+		float Lifetime;
+		bool Ballistic;
+	};
+
+	struct ForceFieldCommand
+	{
+		int Handle;
+		ParticleForceField Field;
+		// Only the enabled flag of the field changes
+		bool EnabledOnly;
+	};
+
+	enum class EditKind
+	{
+		SetAcceleration,
+		AddVelocity
+	};
+
+	struct EditCommand
+	{
+		EditKind Kind;
+		unsigned TypeMask;
+		DirectX::SimpleMath::Vector3 Value;
+	};
+
+	struct ParticleVelocityCommand
+	{
+		Particle* Target;
+		DirectX::SimpleMath::Vector3 Velocity;
+	};
+
+	/**
+	* The commands of one batch, by kind.
+	*/
+	struct Batch
+	{
+		std::vector<Particle*> Despawns;
+		// Categories of the types of which every particle is despawned
+		unsigned DespawnTypes = 0;
+		std::vector<ForceFieldCommand> ForceFields;
+		std::vector<EditCommand> Edits;
+		std::vector<ParticleVelocityCommand> ParticleVelocities;
+		std::vector<SpawnCommand> Spawns;
+
+		bool IsEmpty() const;
+		void Clear();
+	};
+
+	/**
+	* Hands the queued commands to batch, which has to be empty, and
+	* starts an empty queue. The capacity of the queue goes back and
+	* forth with the batch, so queueing doesn't allocate once both are
+	* large enough.
+	*/
+	void Take(Batch& batch);
+
+	/**
+	* Replaces the particle pointers of the queued despawns and particle
+	* edits after the particle storage was reordered.
+	*/
+	void RemapParticles(const ParticleRemap& remap);
+
+private:
+	std::mutex m_mutex;
+	Batch m_queued;
+};
@@ -36,10 +36,10 @@ void ParticleContact::resolveVelocity(const float& deltaTime)
 	float newSepVelocity = -separatingVelocity * Restitution;
 
 	// Check the velocity build-up due to acceleration only
-	Vector3 accCausedVelocity = ContactParticles[0]->GetAcceleration();
+	Vector3 accCausedVelocity = ContactParticles[0]->GetEffectiveAcceleration();
 	if (ContactParticles[1])
 	{
-		accCausedVelocity -= ContactParticles[1]->GetAcceleration();
+		accCausedVelocity -= ContactParticles[1]->GetEffectiveAcceleration();
 	}
 	float accCausedSepVelocity = accCausedVelocity.Dot(ContactNormal) * deltaTime;
 
@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "ParticleContactArena.h"
+
+ParticleContactArena::ParticleContactArena(const int& initialCapacity, const int& maxCapacity)
+	: m_initialCapacity(std::min(initialCapacity, maxCapacity)), m_maxCapacity(maxCapacity)
+{
+	m_contacts.resize(m_initialCapacity);
+}
+
+void ParticleContactArena::Reset()
+{
+	const int capacity = GetCapacity();
+	if (m_used < capacity / 4 && capacity > m_initialCapacity)
+	{
+		if (++m_lowUseSteps >= ShrinkAfterSteps)
+		{
+			// Give the memory back, not just the size
+			std::vector<ParticleContact>(std::max(capacity / 2, m_initialCapacity)).swap(m_contacts);
+			m_lowUseSteps = 0;
+			++m_shrinkCount;
+		}
+	}
+	else
+	{
+		m_lowUseSteps = 0;
+	}
+	m_used = 0;
+}
+
+bool ParticleContactArena::Grow()
+{
+	const int capacity = GetCapacity();
+	if (capacity >= m_maxCapacity)
+		return false;
+
+	m_contacts.resize(std::min(std::max(capacity * 2, 1), m_maxCapacity));
+	m_lowUseSteps = 0;
+	++m_growCount;
+	return true;
+}
+
+ParticleContact* ParticleContactArena::GetFreeContacts()
+{
+	return m_contacts.data() + m_used;
+}
+
+int ParticleContactArena::GetFreeCapacity() const
+{
+	return GetCapacity() - m_used;
+}
+
+void ParticleContactArena::Commit(const int& count)
+{
+	assert(count <= GetFreeCapacity());
+	m_used += count;
+	m_highWaterMark = std::max(m_highWaterMark, m_used);
+}
+
+void ParticleContactArena::Truncate(const int& count)
+{
+	assert(count <= m_used);
+	m_used = count;
+}
+
+ParticleContact* ParticleContactArena::GetContacts()
+{
+	return m_contacts.data();
+}
+
+int ParticleContactArena::GetUsed() const
+{
+	return m_used;
+}
+
+int ParticleContactArena::GetCapacity() const
+{
+	return static_cast<int>(m_contacts.size());
+}
+
+int ParticleContactArena::GetMaxCapacity() const
+{
+	return m_maxCapacity;
+}
+
+int ParticleContactArena::GetHighWaterMark() const
+{
+	return m_highWaterMark;
+}
+
+int ParticleContactArena::GetGrowCount() const
+{
+	return m_growCount;
+}
+
+int ParticleContactArena::GetShrinkCount() const
+{
+	return m_shrinkCount;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/**
+* Holds the contacts of one physics step. The arena starts small, grows
+* geometrically whenever the contact generators need more room (up to a
+* hard limit) and shrinks again after it was mostly empty for a while,
+* so the memory follows the actual load of the scene.
+*/
+class ParticleContactArena
+{
+public:
+	ParticleContactArena(const int& initialCapacity, const int& maxCapacity);
+
+	/**
+	* Forgets all contacts of the previous step and shrinks the arena if
+	* it was used below a quarter of its capacity for ShrinkAfterSteps
+	* steps in a row.
+	*/
+	void Reset();
+
+	/**
+	* Doubles the capacity without losing the contacts which are already
+	* committed. Returns false if the arena is at its maximum capacity.
+	*/
+	bool Grow();
+
+	/**
+	* The first free contact and the number of contacts which can be
+	* written to it. Written contacts become part of the arena with
+	* Commit.
+	*/
+	ParticleContact* GetFreeContacts();
+	int GetFreeCapacity() const;
+	void Commit(const int& count);
+
+	/**
+	* Drops the committed contacts from the given count on.
+	*/
+	void Truncate(const int& count);
+
+	ParticleContact* GetContacts();
+	int GetUsed() const;
+	int GetCapacity() const;
+	int GetMaxCapacity() const;
+
+	/**
+	* The most contacts a single step ever used.
+	*/
+	int GetHighWaterMark() const;
+
+	/**
+	* How often the arena had to grow and shrink since it was created.
+	*/
+	int GetGrowCount() const;
+	int GetShrinkCount() const;
+
+	static const int ShrinkAfterSteps = 300;
+
+private:
+	std::vector<ParticleContact> m_contacts;
+	int m_used = 0;
+	int m_initialCapacity = 0;
+	int m_maxCapacity = 0;
+	int m_highWaterMark = 0;
+	int m_lowUseSteps = 0;
+	int m_growCount = 0;
+	int m_shrinkCount = 0;
+};
@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "ParticleContactEvents.h"
+
+using namespace DirectX::SimpleMath;
+
+ParticleContactEventStream::ParticleContactEventStream(const int& capacity)
+	: m_write(0)
+{
+	SetCapacity(capacity);
+}
+
+bool ParticleContactEventStream::Push(const ParticleContactEvent& event)
+{
+	// Every producer gets its own position, the ones past the capacity
+	// write nothing
+	const uint32_t position = m_write.fetch_add(1, std::memory_order_relaxed);
+	if (position - m_begin > m_mask)
+		return false;
+
+	m_events[position & m_mask] = event;
+	return true;
+}
+
+uint32_t ParticleContactEventStream::Begin() const
+{
+	return m_begin;
+}
+
+uint32_t ParticleContactEventStream::End() const
+{
+	const uint32_t write = m_write.load(std::memory_order_acquire);
+	return write - m_begin > m_mask + 1 ? m_begin + m_mask + 1 : write;
+}
+
+ParticleContactEvent& ParticleContactEventStream::At(const uint32_t& position)
+{
+	return m_events[position & m_mask];
+}
+
+const ParticleContactEvent& ParticleContactEventStream::At(const uint32_t& position) const
+{
+	return m_events[position & m_mask];
+}
+
+uint32_t ParticleContactEventStream::GetWritePosition() const
+{
+	return m_write.load(std::memory_order_acquire);
+}
+
+void ParticleContactEventStream::Rewind(const uint32_t& position)
+{
+	m_write.store(position, std::memory_order_release);
+}
+
+void ParticleContactEventStream::DiscardUntil(const uint32_t& position)
+{
+	m_begin = position;
+}
+
+int ParticleContactEventStream::GetDroppedCount() const
+{
+	return static_cast<int>(GetWritePosition() - End());
+}
+
+void ParticleContactEventStream::SetCapacity(const int& capacity)
+{
+	uint32_t size = 1;
+	while (size < static_cast<uint32_t>(std::max(capacity, 1)))
+	{
+		size <<= 1;
+	}
+	m_events.assign(size, ParticleContactEvent());
+	m_mask = size - 1;
+	m_begin = GetWritePosition();
+}
+
+int ParticleContactEventStream::GetCapacity() const
+{
+	return static_cast<int>(m_mask + 1);
+}
+
+void ParticleContactEventStream::RemapParticles(const ParticleRemap& remap)
+{
+	for (uint32_t position = Begin(); position != End(); ++position)
+	{
+		ParticleContactEvent& event = At(position);
+		event.First = remap(event.First);
+		event.Second = remap(event.Second);
+	}
+}
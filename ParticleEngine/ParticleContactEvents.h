@@ -0,0 +1,99 @@
+#pragma once
+
+enum class ParticleContactEventKind : uint8_t
+{
+	// The pair touches and didn't in the step before
+	Begin,
+	Persist,
+	// The pair stopped touching, or a particle of it went back to the pool
+	End
+};
+
+/**
+* Two particles of a ParticleParticleContactGenerator which touch, in
+* the order of their contact.
+*/
+struct ParticleContactEvent
+{
+	Particle* First;
+	Particle* Second;
+	// From the second particle to the first one, zero for End
+	DirectX::SimpleMath::Vector3 Normal;
+	// Impulse which stops the pair from closing in, zero if it is
+	// already separating. The world fills it in after the narrowphase
+	float Impulse;
+	ParticleContactEventKind Kind;
+};
+
+/**
+* Ring buffer of contact events. Any number of threads may push events
+* at the same time without a lock, reading and everything else happens
+* on one thread once they are done. Events which don't fit into the
+* ring are dropped and counted. Positions count every event ever
+* pushed, the readable events are the ones from Begin to End.
+*/
+class ParticleContactEventStream
+{
+public:
+	/**
+	* The capacity is rounded up to a power of two.
+	*/
+	explicit ParticleContactEventStream(const int& capacity = 16384);
+
+	bool Push(const ParticleContactEvent& event);
+
+	uint32_t Begin() const;
+	uint32_t End() const;
+	ParticleContactEvent& At(const uint32_t& position);
+	const ParticleContactEvent& At(const uint32_t& position) const;
+
+	/**
+	* Where the next event is pushed, dropped events included.
+	*/
+	uint32_t GetWritePosition() const;
+
+	/**
+	* Drops the events pushed since the given write position.
+	*/
+	void Rewind(const uint32_t& position);
+
+	/**
+	* Drops the readable events before the given position.
+	*/
+	void DiscardUntil(const uint32_t& position);
+
+	/**
+	* Events pushed since the first readable one which didn't fit.
+	*/
+	int GetDroppedCount() const;
+
+	/**
+	* Discards all events.
+	*/
+	void SetCapacity(const int& capacity);
+	int GetCapacity() const;
+
+	void RemapParticles(const ParticleRemap& remap);
+
+private:
+	std::vector<ParticleContactEvent> m_events;
+	uint32_t m_mask = 0;
+	uint32_t m_begin = 0;
+	std::atomic<uint32_t> m_write;
+};
+
+/**
+* Gameplay systems which want to hear of touching particles, see
+* ParticleWorld::AddContactEventListener.
+*/
+class ParticleContactEventListener
+{
+public:
+	virtual ~ParticleContactEventListener() = default;
+
+	/**
+	* The readable events of the stream are the ones since the last call,
+	* the world has already applied the interaction table to them.
+	*/
+	virtual void OnContactEvents(const ParticleContactEventStream& events) = 0;
+};
@@ -9,6 +9,9 @@ int ParticleGroundContactsGenerator::AddContact(ParticleContact* contact, const
 	int count = 0;
 	for (Particle* particle : m_particles)
 	{
+		if (!particle->IsAwake() || particle->IsBallistic())
+			continue;
+
 		float y = particle->GetPosition().y;
 		if (y < m_ground)
 		{
@@ -26,6 +29,15 @@ int ParticleGroundContactsGenerator::AddContact(ParticleContact* contact, const
 	return count;
 }
 
+bool ParticleGroundContactsGenerator::GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const
+{
+	// Everything below the ground
+	const float infinity = std::numeric_limits<float>::max();
+	outMin = Vector3(-infinity, -infinity, -infinity);
+	outMax = Vector3(infinity, m_ground, infinity);
+	return true;
+}
+
 ParticlePlatformContactsGenerator::ParticlePlatformContactsGenerator()
 {
 }
@@ -40,179 +52,522 @@ void ParticlePlatformContactsGenerator::Initialize(const DirectX::SimpleMath::Ve
 	m_end = end;
 }
 
+// Writes the contact of a particle which is closer than its radius to
+// the closest point of a platform, offset points from that point to the
+// particle. One square root gives both the normal and the penetration
+static void writePlatformContact(ParticleContact* contact, Particle* particle, const Vector3& offset, const float& distanceSquared)
+{
+	const float distance = sqrtf(distanceSquared);
+	Vector3 contactNormal = distance > 0 ? offset * (1.f / distance) : Vector3::Zero;
+	contactNormal.z = 0;
+
+	contact->ContactNormal = contactNormal;
+	contact->Restitution = particle->GetBouncinessFactor();
+	contact->ContactParticles[0] = particle;
+	contact->ContactParticles[1] = nullptr;
+	contact->Penetration = particle->GetWorldSpaceRadius() - distance;
+}
+
 int ParticlePlatformContactsGenerator::AddContact(ParticleContact* contact, const int& limit) 
 {
 	int used = 0;
+	m_lastRunSweptContacts = 0;
 	for (Particle* particle : m_particles)
 	{
 		if (used >= limit) break;
+		if (!particle->IsAwake() || particle->IsBallistic()) continue;
 
-		// Check for penetration
-		Vector3 toParticle = particle->GetPosition() - m_start;
-		Vector3 lineDirection = m_end - m_start;
-		float projected = toParticle.Dot(lineDirection);
-		float platformSqLength = lineDirection.LengthSquared();
-		if (projected <= 0)
+		// Fast particles may have passed through the platform in this
+		// step, or ended up just behind it where the penetration test
+		// would push them out on the wrong side
+		if (addSweptContact(particle, contact))
 		{
-			Vector3 toParticleNormalized = toParticle;
-			toParticleNormalized.Normalize();
-			// The blob is nearest to the start point
-			if (toParticle.LengthSquared() < std::powf(particle->GetWorldSpaceRadius(),2.f))
-			{
-				// We have a collision
-				contact->ContactNormal = toParticleNormalized;
-				contact->ContactNormal.z = 0;
-				contact->Restitution = particle->GetBouncinessFactor();
-				contact->ContactParticles[0] = particle;
-				contact->ContactParticles[1] = nullptr;
-				contact->Penetration = particle->GetWorldSpaceRadius() - toParticle.Length();
-				used++;
-				contact++;
-			}
-
-		}
-		else if (projected >= platformSqLength)
-		{
-			// The blob is nearest to the end point
-			toParticle = particle->GetPosition() - m_end;
-			Vector3 toParticleNormalized = toParticle;
-			toParticleNormalized.Normalize();
-			if (toParticle.LengthSquared() < std::powf(particle->GetWorldSpaceRadius(), 2.f))
-			{
-				// We have a collision
-				contact->ContactNormal = toParticleNormalized;
-				contact->ContactNormal.z = 0;
-				contact->Restitution = particle->GetBouncinessFactor();
-				contact->ContactParticles[0] = particle;
-				contact->ContactParticles[1] = nullptr;
-				contact->Penetration = particle->GetWorldSpaceRadius() - toParticle.Length();
-				used++;
-				contact++;
-			}
+			++m_sweptContacts;
+			++m_lastRunSweptContacts;
+			used++;
+			contact++;
+			continue;
 		}
-		else
+
+		// Check for penetration against the closest point of the platform
+		const float radius = particle->GetWorldSpaceRadius();
+		const Vector3 toParticle = particle->GetPosition() - closestPoint(particle->GetPosition());
+		const float distanceSquared = toParticle.LengthSquared();
+		if (distanceSquared < radius * radius)
 		{
-			// the blob is nearest to the middle.
-			float distanceToPlatform = toParticle.LengthSquared() - projected*projected / platformSqLength;
-			if (distanceToPlatform < std::powf(particle->GetWorldSpaceRadius(), 2.f))
-			{
-				// We have a collision
-				Vector3 closestPoint =	m_start + lineDirection*(projected / platformSqLength);
-				Vector3 contactNormal = (particle->GetPosition() - closestPoint);
-				contactNormal.Normalize();
-
-				contact->ContactNormal = contactNormal;
-				contact->ContactNormal.z = 0;
-				contact->Restitution = particle->GetBouncinessFactor();
-				contact->ContactParticles[0] = particle;
-				contact->ContactParticles[1] = nullptr;
-				contact->Penetration = particle->GetWorldSpaceRadius() - sqrtf(distanceToPlatform);
-				used++;
-				contact++;
-			}
+			// We have a collision
+			writePlatformContact(contact, particle, toParticle, distanceSquared);
+			used++;
+			contact++;
 		}
 	}
 	return used;
 }
 
-ParticleParticleContactGenerator::ParticleParticleContactGenerator(): ParticleContactGenerator()
+bool ParticlePlatformContactsGenerator::GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const
+{
+	outMin = Vector3::Min(m_start, m_end);
+	outMax = Vector3::Max(m_start, m_end);
+	return true;
+}
+
+void ParticlePlatformContactsGenerator::DiscardLastRun()
+{
+	m_sweptContacts -= m_lastRunSweptContacts;
+	m_lastRunSweptContacts = 0;
+}
+
+int ParticlePlatformContactsGenerator::GetSweptContactCount() const
 {
-	m_usedParticles.resize(std::numeric_limits<short>::max());
+	return m_sweptContacts;
+}
+
+float ParticlePlatformContactsGenerator::GetDistance(const DirectX::SimpleMath::Vector3& point) const
+{
+	return (point - closestPoint(point)).Length();
+}
+
+Vector3 ParticlePlatformContactsGenerator::closestPoint(const DirectX::SimpleMath::Vector3& point) const
+{
+	const Vector3 lineDirection = m_end - m_start;
+	const float platformSqLength = lineDirection.LengthSquared();
+	const float projected = (point - m_start).Dot(lineDirection);
+	if (projected >= platformSqLength)
+	{
+		// The blob is nearest to the end point
+		return m_end;
+	}
+	if (projected > 0)
+	{
+		// the blob is nearest to the middle.
+		return m_start + lineDirection * (projected / platformSqLength);
+	}
+	// otherwise the blob is nearest to the start point
+	return m_start;
+}
+
+// Smallest t in [0, 1] at which from + t * movement is radius away from
+// center, false if it never gets that close
+static bool sweepAgainstPoint(const Vector3& from, const Vector3& movement, const Vector3& center, const float& radius, float& outTime)
+{
+	Vector3 offset = from - center;
+	float a = movement.LengthSquared();
+	float b = 2.f * offset.Dot(movement);
+	float c = offset.LengthSquared() - radius * radius;
+	float discriminant = b * b - 4.f * a * c;
+	if (a <= 0.f || discriminant < 0.f)
+		return false;
+
+	float time = (-b - sqrtf(discriminant)) / (2.f * a);
+	if (time < 0.f || time > 1.f)
+		return false;
+
+	outTime = time;
+	return true;
+}
+
+bool ParticlePlatformContactsGenerator::addSweptContact(Particle* particle, ParticleContact* contact) const
+{
+	const Vector3 from = particle->GetPreviousPosition();
+	const Vector3 to = particle->GetPosition();
+	const Vector3 movement = to - from;
+	const float radius = particle->GetWorldSpaceRadius();
+	if (movement.LengthSquared() <= radius * radius)
+		return false;
+
+	const Vector3 lineDirection = m_end - m_start;
+	const float lineLength = lineDirection.Length();
+	if (lineLength <= 0.f)
+		return false;
+
+	// The side of the platform the particle came from. A particle which
+	// already touched the platform at the start is left to the
+	// penetration test
+	const Vector3 tangent = lineDirection * (1.f / lineLength);
+	Vector3 normal(-tangent.y, tangent.x, 0);
+	float startDistance = (from - m_start).Dot(normal);
+	if (startDistance < 0)
+	{
+		normal = -normal;
+		startDistance = -startDistance;
+	}
+	if (startDistance < radius)
+		return false;
+
+	float impactTime = 2.f;
+	float approach = movement.Dot(normal);
+	if (approach < 0.f)
+	{
+		float time = (radius - startDistance) / approach;
+		float along = (from + movement * time - m_start).Dot(tangent);
+		if (time <= 1.f && along >= 0.f && along <= lineLength)
+			impactTime = time;
+	}
+
+	float time;
+	if (sweepAgainstPoint(from, movement, m_start, radius, time) && time < impactTime)
+		impactTime = time;
+	if (sweepAgainstPoint(from, movement, m_end, radius, time) && time < impactTime)
+		impactTime = time;
+	if (impactTime > 1.f)
+		return false;
+
+	// The particle touched the platform here, its normal points from the
+	// closest point of the platform to the touching position
+	const Vector3 touching = from + movement * impactTime;
+	float projected = std::min(std::max((touching - m_start).Dot(tangent), 0.f), lineLength);
+	Vector3 contactNormal = touching - (m_start + tangent * projected);
+	contactNormal.z = 0;
+	contactNormal.Normalize();
+
+	contact->ContactNormal = contactNormal;
+	contact->Restitution = particle->GetBouncinessFactor();
+	contact->ContactParticles[0] = particle;
+	contact->ContactParticles[1] = nullptr;
+	// Moving back by this much along the normal puts the particle where
+	// it touched the platform
+	contact->Penetration = (touching - to).Dot(contactNormal);
+	return true;
 }
 
 int ParticleParticleContactGenerator::AddContact(ParticleContact* contact, const int& limit) 
 {
-	m_usedParticleIndex = 0;
+	if (m_useNeighbourList)
+		return addContactsFromNeighbourList(contact, limit);
+
+	// Candidates are collected in small chunks for the narrowphase
+	const size_t chunkSize = 256;
+	std::pair<Particle*, Particle*> candidates[chunkSize];
+	size_t candidateCount = 0;
+
 	int count = 0;
-	for (Particle* particle : m_particles)
+	const size_t particleCount = m_particles.size();
+	for (size_t i = 0; i < particleCount; ++i)
 	{
-		for (Particle* other : m_particles)
+		Particle* particle = m_particles[i];
+		if (particle->GetLodInterval() > 1)
+			continue;
+
+		for (size_t j = i + 1; j < particleCount; ++j)
 		{
-			if (particle == other ||(particle->GetType() == ParticleTypes::Snow && other->GetType() == ParticleTypes::Snow))
+			Particle* other = m_particles[j];
+			if (other->GetLodInterval() > 1 || !ParticleCollisionFilter::CanInteract(particle->GetType(), other->GetType()))
 				continue;
 
-			Vector3 posParticle = particle->GetPosition();
-			Vector3 posOther = other->GetPosition();
+			candidates[candidateCount++] = std::make_pair(particle, other);
+			if (candidateCount < chunkSize)
+				continue;
 
-			Vector3 midline = posParticle - posOther;
-			float size = midline.Length();
+			count += ParticleNarrowphase::AddContacts(candidates, candidateCount, contact + count, limit - count, m_contactEvents);
+			candidateCount = 0;
+			if (count >= limit)
+				return count;
+		}
+	}
+	count += ParticleNarrowphase::AddContacts(candidates, candidateCount, contact + count, limit - count, m_contactEvents);
+	return count;
+}
 
-			if (size <= 0.0f || size >= particle->GetWorldSpaceRadius() + other->GetWorldSpaceRadius())
-				continue;
+void ParticleParticleContactGenerator::RemapParticles(const ParticleRemap& remap)
+{
+	ParticleContactGenerator::RemapParticles(remap);
 
-			if (particlePairUsed(particle, other))
-				continue;
+	// The members changed their order, which the incremental update of
+	// the neighbour list can't follow
+	invalidateNeighbourList();
+}
+
+void ParticleParticleContactGenerator::ReplaceParticles(Particle* const* particles, const size_t& count)
+{
+	ParticleContactGenerator::ReplaceParticles(particles, count);
+	invalidateNeighbourList();
+}
+
+void ParticleParticleContactGenerator::DiscardLastRun()
+{
+	// The list the dropped run built or updated stays valid, the run
+	// again only checks its pairs once more within the same step
+	if (m_useNeighbourList)
+		--m_neighbourListStats.Steps;
+}
+
+void ParticleParticleContactGenerator::invalidateNeighbourList()
+{
+	m_neighbourListValid = false;
+	m_neighbourPairs.clear();
+	m_neighbourParticles.clear();
+	m_neighbourLodIntervals.clear();
+}
 
-			bool destroyParticle, destroyOther;
-			shouldBeDestroyed(particle, other, destroyParticle, destroyOther);
-			if(destroyOther || destroyParticle)
+void ParticleParticleContactGenerator::SetNeighbourListEnabled(const bool& enabled)
+{
+	m_useNeighbourList = enabled;
+	m_neighbourListValid = false;
+}
+
+void ParticleParticleContactGenerator::SetNeighbourListSkin(const float& skin)
+{
+	m_neighbourListSkin = skin;
+	m_neighbourListValid = false;
+}
+
+const ParticleNeighbourListStats& ParticleParticleContactGenerator::GetNeighbourListStats() const
+{
+	return m_neighbourListStats;
+}
+
+void ParticleParticleContactGenerator::ResetNeighbourListStats()
+{
+	m_neighbourListStats = ParticleNeighbourListStats();
+}
+
+double ParticleNeighbourListStats::EstimatedSavedMilliseconds() const
+{
+	if (Rebuilds == 0)
+		return 0;
+
+	double rebuildEveryStep = Steps * (RebuildMilliseconds / Rebuilds);
+	return rebuildEveryStep - RebuildMilliseconds - UpdateMilliseconds;
+}
+
+int ParticleParticleContactGenerator::addContactsFromNeighbourList(ParticleContact* contact, const int& limit)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	bool rebuild = !m_neighbourListValid;
+	if (!rebuild && m_membershipVersion != m_neighbourListMembershipVersion)
+	{
+		rebuild = !updateNeighbourListMembership();
+		m_neighbourListStats.IncrementalUpdates += rebuild ? 0 : 1;
+	}
+	if (!rebuild)
+	{
+		rebuild = m_particles.size() != m_neighbourPositions.size() || anyParticleMovedOutOfSkin();
+	}
+
+	Clock::time_point updated = Clock::now();
+	m_neighbourListStats.UpdateMilliseconds += std::chrono::duration<double, std::milli>(updated - start).count();
+	if (rebuild)
+	{
+		rebuildNeighbourList();
+		++m_neighbourListStats.Rebuilds;
+		Clock::time_point rebuilt = Clock::now();
+		m_neighbourListStats.RebuildMilliseconds += std::chrono::duration<double, std::milli>(rebuilt - updated).count();
+		updated = rebuilt;
+	}
+
+	int count = ParticleNarrowphase::AddContacts(m_neighbourPairs.data(), m_neighbourPairs.size(), contact, limit, m_contactEvents);
+
+	++m_neighbourListStats.Steps;
+	m_neighbourListStats.Pairs = static_cast<int>(m_neighbourPairs.size());
+	m_neighbourListStats.NarrowphaseMilliseconds += std::chrono::duration<double, std::milli>(Clock::now() - updated).count();
+	return count;
+}
+
+void ParticleParticleContactGenerator::rebuildNeighbourList()
+{
+	m_neighbourPairs.clear();
+	m_neighbourParticles = m_particles;
+	m_neighbourPositions.resize(m_particles.size());
+	m_neighbourLodIntervals.resize(m_particles.size());
+
+	const size_t count = m_particles.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_neighbourPositions[i] = m_particles[i]->GetPosition();
+		m_neighbourLodIntervals[i] = m_particles[i]->GetLodInterval();
+	}
+
+	ParticleFrameVector<int> byType(m_frameAllocator);
+	int groupStart[ParticleTypeCount + 1];
+	groupParticlesByType(count, byType, groupStart);
+
+	// Only the groups of types which interact are paired up. As in the
+	// brute force loop, the particle which comes first in m_particles is
+	// the first particle of the contact
+	m_neighbourListStats.FilteredPairs = 0;
+	for (int firstType = 0; firstType < ParticleTypeCount; ++firstType)
+	{
+		for (int secondType = firstType; secondType < ParticleTypeCount; ++secondType)
+		{
+			const long long firstCount = groupStart[firstType + 1] - groupStart[firstType];
+			const long long secondCount = groupStart[secondType + 1] - groupStart[secondType];
+			if (!ParticleCollisionFilter::CanInteract(static_cast<ParticleTypes>(firstType), static_cast<ParticleTypes>(secondType)))
 			{
-				particle->SetActive(!destroyParticle);
-				other->SetActive(!destroyOther);
+				m_neighbourListStats.FilteredPairs += firstType == secondType ? firstCount * (firstCount - 1) / 2 : firstCount * secondCount;
 				continue;
 			}
-			
-			Vector3 normal = midline * (1.f / size);
-			normal.Normalize();
 
-			contact->ContactNormal = normal;
-			contact->ContactParticles[0] = particle;
-			contact->ContactParticles[1] = other;
-			contact->Penetration = particle->GetWorldSpaceRadius() + other->GetWorldSpaceRadius() - size;
-			contact->Restitution = particle->GetBouncinessFactor() + other->GetBouncinessFactor();
-			contact++;
-			count++;
+			// Particles far from the view don't collide with others
+			for (int first = groupStart[firstType]; first < groupStart[firstType + 1]; ++first)
+			{
+				if (m_neighbourLodIntervals[byType[first]] > 1)
+					continue;
 
-			//todo: should create a branch for out of range
-			m_usedParticles[m_usedParticleIndex].first = particle;
-			m_usedParticles[m_usedParticleIndex].second = other;
-			++m_usedParticleIndex;
+				const int second = firstType == secondType ? first + 1 : groupStart[secondType];
+				for (int other = second; other < groupStart[secondType + 1]; ++other)
+				{
+					int i = byType[first];
+					int j = byType[other];
+					if (m_neighbourLodIntervals[j] > 1)
+						continue;
+					if (i > j)
+						std::swap(i, j);
 
-			if (count >= limit)
-				return count;
+					float range = m_particles[i]->GetWorldSpaceRadius() + m_particles[j]->GetWorldSpaceRadius() + m_neighbourListSkin;
+					if ((m_neighbourPositions[i] - m_neighbourPositions[j]).LengthSquared() < range * range)
+					{
+						m_neighbourPairs.push_back(std::make_pair(m_particles[i], m_particles[j]));
+					}
+				}
+			}
 		}
 	}
-	return count;
+
+	m_neighbourListMembershipVersion = m_membershipVersion;
+	m_neighbourListValid = true;
 }
 
-bool ParticleParticleContactGenerator::particlePairUsed(Particle* one, Particle* two) const
+bool ParticleParticleContactGenerator::updateNeighbourListMembership()
 {
-	for (int i = 0; i < m_usedParticleIndex; ++i)
+	// Particles are only ever appended and removals keep the order, so
+	// walking both lists side by side finds the removed particles and
+	// the first appended one
+	ParticleFrameVector<Particle*> removed(m_frameAllocator);
+	ParticleFrameVector<Vector3> positions(m_frameAllocator);
+	ParticleFrameVector<int> lodIntervals(m_frameAllocator);
+	positions.reserve(m_particles.size());
+	lodIntervals.reserve(m_particles.size());
+
+	size_t oldIndex = 0;
+	size_t firstNew = m_particles.size();
+	for (size_t index = 0; index < m_particles.size(); ++index)
 	{
-		if (m_usedParticles[i].first == one && m_usedParticles[i].second == two ||
-			m_usedParticles[i].first == two && m_usedParticles[i].second == one)
-			return true;
+		while (oldIndex < m_neighbourParticles.size() && m_neighbourParticles[oldIndex] != m_particles[index])
+		{
+			removed.push_back(m_neighbourParticles[oldIndex++]);
+		}
+		if (oldIndex == m_neighbourParticles.size())
+		{
+			firstNew = index;
+			break;
+		}
+		lodIntervals.push_back(m_neighbourLodIntervals[oldIndex]);
+		positions.push_back(m_neighbourPositions[oldIndex++]);
 	}
-	return false;
+	while (oldIndex < m_neighbourParticles.size())
+	{
+		removed.push_back(m_neighbourParticles[oldIndex++]);
+	}
+
+	// A particle which was removed and added again shows up twice, that
+	// isn't worth handling incrementally
+	std::sort(removed.begin(), removed.end());
+	for (size_t index = firstNew; index < m_particles.size(); ++index)
+	{
+		if (std::binary_search(removed.begin(), removed.end(), m_particles[index]))
+			return false;
+	}
+
+	if (!removed.empty())
+	{
+		auto isRemoved = [&removed](const std::pair<Particle*, Particle*>& pair)
+		{
+			return std::binary_search(removed.begin(), removed.end(), pair.first) ||
+				std::binary_search(removed.begin(), removed.end(), pair.second);
+		};
+		m_neighbourPairs.erase(std::remove_if(m_neighbourPairs.begin(), m_neighbourPairs.end(), isRemoved), m_neighbourPairs.end());
+	}
+
+	// Pairs with the appended particles. An old particle may already have
+	// moved up to half the skin and can move as far again plus that before
+	// the next rebuild, so its displacement widens the range
+	for (size_t index = firstNew; index < m_particles.size(); ++index)
+	{
+		positions.push_back(m_particles[index]->GetPosition());
+		lodIntervals.push_back(m_particles[index]->GetLodInterval());
+	}
+	ParticleFrameVector<int> byType(m_frameAllocator);
+	int groupStart[ParticleTypeCount + 1];
+	groupParticlesByType(m_particles.size(), byType, groupStart);
+
+	for (size_t newIndex = firstNew; newIndex < m_particles.size(); ++newIndex)
+	{
+		Particle* newParticle = m_particles[newIndex];
+		if (lodIntervals[newIndex] > 1)
+			continue;
+
+		for (int type = 0; type < ParticleTypeCount; ++type)
+		{
+			if (!ParticleCollisionFilter::CanInteract(static_cast<ParticleTypes>(type), newParticle->GetType()))
+				continue;
+
+			// The groups are in ascending order, so the particles before
+			// the new one come first
+			for (int grouped = groupStart[type]; grouped < groupStart[type + 1] && byType[grouped] < static_cast<int>(newIndex); ++grouped)
+			{
+				const int index = byType[grouped];
+				if (lodIntervals[index] > 1)
+					continue;
+
+				Particle* particle = m_particles[index];
+				Vector3 position = particle->GetPosition();
+				float displacement = (position - positions[index]).Length();
+				float range = particle->GetWorldSpaceRadius() + newParticle->GetWorldSpaceRadius() + m_neighbourListSkin + displacement;
+				if ((position - positions[newIndex]).LengthSquared() < range * range)
+				{
+					m_neighbourPairs.push_back(std::make_pair(particle, newParticle));
+				}
+			}
+		}
+	}
+
+	m_neighbourParticles = m_particles;
+	m_neighbourPositions.assign(positions.begin(), positions.end());
+	m_neighbourLodIntervals.assign(lodIntervals.begin(), lodIntervals.end());
+	m_neighbourListMembershipVersion = m_membershipVersion;
+	return true;
 }
 
-void ParticleParticleContactGenerator::shouldBeDestroyed(Particle* lhs, Particle* rhs, bool& outDestroyLhs, bool& outDestroyRhs)
+bool ParticleParticleContactGenerator::anyParticleMovedOutOfSkin() const
 {
-	//todo: try to convert this into a non hardcoded style!
-	outDestroyLhs = false;
-	outDestroyRhs = false;
-	
-	//BALL VS SNOW
-	if (lhs->GetType() == ParticleTypes::Ball && rhs->GetType() == ParticleTypes::Snow)
+	const float halfSkin = m_neighbourListSkin * 0.5f;
+	const float halfSkinSquared = halfSkin * halfSkin;
+	for (size_t index = 0; index < m_particles.size(); ++index)
 	{
-		outDestroyRhs = true;
-		return;
+		// Particles far from the view have no pairs that matter, but once
+		// they come closer they need their pairs
+		const Particle* particle = m_particles[index];
+		if (particle->GetLodInterval() > 1)
+			continue;
+		if (m_neighbourLodIntervals[index] > 1)
+			return true;
+
+		if ((particle->GetPosition() - m_neighbourPositions[index]).LengthSquared() > halfSkinSquared)
+			return true;
 	}
-	if (rhs->GetType() == ParticleTypes::Ball && lhs->GetType() == ParticleTypes::Snow)
+	return false;
+}
+
+void ParticleParticleContactGenerator::groupParticlesByType(const size_t& count, ParticleFrameVector<int>& outByType, int (&outGroupStart)[ParticleTypeCount + 1]) const
+{
+	// Counting sort, which keeps the particles of a type in order
+	int next[ParticleTypeCount + 1] = {};
+	for (size_t index = 0; index < count; ++index)
 	{
-		outDestroyLhs = true;
-		return;
+		++next[static_cast<int>(m_particles[index]->GetType()) + 1];
 	}
-	
-	//CLOTH VS SNOW
-	if (lhs->GetType() == ParticleTypes::Cloth && rhs->GetType() == ParticleTypes::Snow)
+	for (int type = 0; type < ParticleTypeCount; ++type)
 	{
-		outDestroyRhs = true;
-		return;
+		next[type + 1] += next[type];
 	}
-	if (rhs->GetType() == ParticleTypes::Cloth && lhs->GetType() == ParticleTypes::Snow)
+	std::copy(next, next + ParticleTypeCount + 1, outGroupStart);
+
+	outByType.resize(count);
+	for (size_t index = 0; index < count; ++index)
 	{
-		outDestroyLhs = true;
-		return;
+		outByType[next[static_cast<int>(m_particles[index]->GetType())]++] = static_cast<int>(index);
 	}
 }
+
@@ -17,6 +17,37 @@ public:
 	* been written.
 	*/
 	virtual int AddContact(ParticleContact* contact, const int& limit) = 0;
+
+	/**
+	* Box around the static scenery the generator collides its particles
+	* with, false if it has none. Generators with scenery skip ballistic
+	* particles, the world ends their flight before they can get there.
+	*/
+	virtual bool GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const { return false; }
+
+	/**
+	* The contact arena was full, so the world drops the contacts of the
+	* last AddContact of this step and runs the generator again with more
+	* room. Generators which count their work take back what the dropped
+	* run counted.
+	*/
+	virtual void DiscardLastRun() {}
+
+	/**
+	* Generators take their per-step scratch memory from this
+	* allocator, ParticleWorld::AddContactGenerator sets it.
+	*/
+	void SetFrameAllocator(ParticleFrameAllocator* frameAllocator) { m_frameAllocator = frameAllocator; }
+
+	/**
+	* Generators which collide particles with each other push the
+	* touching pairs here, ParticleWorld::AddContactGenerator sets it.
+	*/
+	void SetContactEvents(ParticleContactEventStream* contactEvents) { m_contactEvents = contactEvents; }
+
+protected:
+	ParticleFrameAllocator* m_frameAllocator = nullptr;
+	ParticleContactEventStream* m_contactEvents = nullptr;
 };
 
 /**
@@ -27,6 +58,7 @@ class ParticleGroundContactsGenerator : public ParticleContactGenerator
 {
 public:
 	int AddContact(ParticleContact* contact, const int& limit) override;
+	bool GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const override;
 	void SetGroundY(const float& ground) { m_ground = ground; };
 
 private:
@@ -36,6 +68,10 @@ private:
 /**
 * Platforms are two dimensional: lines on which the
 * particles can rest. Platforms are also contact generators for the physics.
+*
+* Particles which moved further than their radius in the last step are
+* swept from their previous position, so fast particles can't tunnel
+* through the thin platform between two steps.
 */
 class ParticlePlatformContactsGenerator : public ParticleContactGenerator
 {
@@ -45,23 +81,116 @@ public:
 
 	void Initialize(const DirectX::SimpleMath::Vector3& start, const DirectX::SimpleMath::Vector3& end);
 	int AddContact(ParticleContact* contact, const int& limit) override;
+	bool GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const override;
+	void DiscardLastRun() override;
+
+	/**
+	* Contacts which only the sweep found, since the platform was created.
+	*/
+	int GetSweptContactCount() const;
+
+	/**
+	* Distance of a point to the closest point of the platform.
+	*/
+	float GetDistance(const DirectX::SimpleMath::Vector3& point) const;
 
 private:
+	DirectX::SimpleMath::Vector3 closestPoint(const DirectX::SimpleMath::Vector3& point) const;
+
+	/**
+	* Finds the first time of impact in [0, 1] of a sphere moving from
+	* its previous to its current position against the platform, widened
+	* by the radius to a capsule. If there is one, the contact pushes the
+	* particle back to where it touched the platform.
+	*/
+	bool addSweptContact(Particle* particle, ParticleContact* contact) const;
+
 	DirectX::SimpleMath::Vector3 m_start = DirectX::SimpleMath::Vector3::Zero;
 	DirectX::SimpleMath::Vector3 m_end = DirectX::SimpleMath::Vector3::Zero;
+	int m_sweptContacts = 0;
+	int m_lastRunSweptContacts = 0;
+};
+
+/**
+* Work done by the neighbour list of a ParticleParticleContactGenerator.
+*/
+struct ParticleNeighbourListStats
+{
+	int Steps = 0;
+	int Rebuilds = 0;
+	// Steps in which particles were only appended or removed, which
+	// updates the list without rebuilding it
+	int IncrementalUpdates = 0;
+	int Pairs = 0;
+	double RebuildMilliseconds = 0;
+	// Incremental updates and the displacement checks of every step
+	double UpdateMilliseconds = 0;
+	double NarrowphaseMilliseconds = 0;
+	// Pairs of the last rebuild which the collision filter skipped as
+	// whole groups of particles, without looking at them
+	long long FilteredPairs = 0;
+
+	/**
+	* Time saved compared to rebuilding the list in every step, based on
+	* the average time of a rebuild.
+	*/
+	double EstimatedSavedMilliseconds() const;
 };
 
+/**
+* Collides the particles with each other. Every unordered pair is
+* visited once, the particle which comes first in the list of particles
+* is the first particle of its contact. The candidate pairs of either
+* mode go through the batched ParticleNarrowphase, which pushes the
+* touching pairs to the contact events.
+*/
 class ParticleParticleContactGenerator : public ParticleContactGenerator
 {
 public:
-	ParticleParticleContactGenerator();
-
 	int AddContact(ParticleContact* contact, const int& limit) override;
+	void RemapParticles(const ParticleRemap& remap) override;
+	void ReplaceParticles(Particle* const* particles, const size_t& count) override;
+	void DiscardLastRun() override;
+
+	/**
+	* In neighbour list mode the generator keeps all pairs which are
+	* closer than their radii plus the skin distance. The list is only
+	* rebuilt once a particle moved more than half of the skin since the
+	* last build, in between only the cached pairs are checked.
+	* Particles with a level of detail interval above one have no pairs
+	* and don't count as moved.
+	*/
+	void SetNeighbourListEnabled(const bool& enabled);
+	void SetNeighbourListSkin(const float& skin);
+	const ParticleNeighbourListStats& GetNeighbourListStats() const;
+	void ResetNeighbourListStats();
 
 private:
-	bool particlePairUsed(Particle* one, Particle* two) const;
-	static void shouldBeDestroyed(Particle* lhs, Particle* rhs, bool& outDestroyLhs, bool& outDestroyRhs);
+	int addContactsFromNeighbourList(ParticleContact* contact, const int& limit);
+	void rebuildNeighbourList();
+	void invalidateNeighbourList();
+	bool updateNeighbourListMembership();
+	bool anyParticleMovedOutOfSkin() const;
+
+	/**
+	* Fills outByType with the indices of the particles in [0, count) of
+	* m_particles grouped by type, each group in ascending order. The
+	* group of a type starts at outGroupStart[type] and ends at
+	* outGroupStart[type + 1].
+	*/
+	void groupParticlesByType(const size_t& count, ParticleFrameVector<int>& outByType, int (&outGroupStart)[ParticleTypeCount + 1]) const;
 
-	std::vector<std::pair<Particle*, Particle*>> m_usedParticles;
-	int m_usedParticleIndex = 0;
+	bool m_useNeighbourList = false;
+	bool m_neighbourListValid = false;
+	float m_neighbourListSkin = 2.f;
+	unsigned m_neighbourListMembershipVersion = 0;
+	std::vector<std::pair<Particle*, Particle*>> m_neighbourPairs;
+	// The members at the last update of the list, in the same order as
+	// m_particles, and their positions when their pairs were built
+	std::vector<Particle*> m_neighbourParticles;
+	std::vector<DirectX::SimpleMath::Vector3> m_neighbourPositions;
+	// The level of detail intervals when the pairs were built, particles
+	// far from the view have no pairs
+	std::vector<int> m_neighbourLodIntervals;
+	ParticleNeighbourListStats m_neighbourListStats;
 };
\ No newline at end of file
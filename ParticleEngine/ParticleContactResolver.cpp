@@ -14,13 +14,191 @@ void ParticleContactResolver::SetIterations(const unsigned& iterations)
 	m_iterations = iterations;
 }
 
+void ParticleContactResolver::SetConvergenceTolerance(const float& penetration, const float& closingVelocity)
+{
+	m_penetrationTolerance = penetration;
+	m_closingVelocityTolerance = closingVelocity;
+}
+
+void ParticleContactResolver::SetTimeBudget(const float& seconds)
+{
+	m_timeBudget = seconds;
+}
+
+ParticleContactResolverStopReason ParticleContactResolver::GetLastStopReason() const
+{
+	return m_lastStopReason;
+}
+
+unsigned ParticleContactResolver::GetIterationsUsed() const
+{
+	return m_iterationsUsed;
+}
+
+void ParticleContactResolver::SetFrameAllocator(ParticleFrameAllocator* frameAllocator)
+{
+	m_frameAllocator = frameAllocator;
+}
+
+void ParticleContactResolver::SetMode(const ParticleContactResolverMode& mode)
+{
+	m_mode = mode;
+}
+
+ParticleContactResolverMode ParticleContactResolver::GetMode() const
+{
+	return m_mode;
+}
+
+void ParticleContactResolver::SetBatchSweeps(const unsigned& sweeps)
+{
+	m_batchSweeps = sweeps;
+}
+
+unsigned ParticleContactResolver::GetBatchSweeps() const
+{
+	return m_batchSweeps;
+}
+
+unsigned ParticleContactResolver::GetColorCount() const
+{
+	return m_colorCount;
+}
+
 void ParticleContactResolver::ResolveContacts(ParticleContact *contactArray, const int& numContacts, const float& duration)
+{
+	if (m_mode == ParticleContactResolverMode::GraphColored)
+		resolveGraphColored(contactArray, numContacts, duration);
+	else
+		resolveIterative(contactArray, numContacts, duration);
+}
+
+void ParticleContactResolver::ResolveIsolatedContacts(ParticleContact *contactArray, const int& numContacts, const float& duration) const
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 dt = _mm_set1_ps(duration);
+	const __m128 penetrationTolerance = _mm_set1_ps(m_penetrationTolerance);
+	const __m128 closingVelocityTolerance = _mm_set1_ps(-m_closingVelocityTolerance);
+
+	for (int first = 0; first < numContacts; first += BatchWidth)
+	{
+		const int lanes = std::min(numContacts - first, static_cast<int>(BatchWidth));
+
+		// Lanes past the end have infinite mass, which resolves nothing
+		alignas(16) float normal[3][BatchWidth] = {};
+		alignas(16) float velocity[3][BatchWidth] = {};
+		alignas(16) float acceleration[3][BatchWidth] = {};
+		alignas(16) float penetration[BatchWidth] = {};
+		alignas(16) float restitution[BatchWidth] = {};
+		alignas(16) float inverseMass[BatchWidth] = {};
+		for (int lane = 0; lane < lanes; ++lane)
+		{
+			const ParticleContact& contact = contactArray[first + lane];
+			const Particle* particle = contact.ContactParticles[0];
+			const Vector3 particleVelocity = particle->GetVelocity();
+			const Vector3 particleAcceleration = particle->GetEffectiveAcceleration();
+			normal[0][lane] = contact.ContactNormal.x;
+			normal[1][lane] = contact.ContactNormal.y;
+			normal[2][lane] = contact.ContactNormal.z;
+			velocity[0][lane] = particleVelocity.x;
+			velocity[1][lane] = particleVelocity.y;
+			velocity[2][lane] = particleVelocity.z;
+			acceleration[0][lane] = particleAcceleration.x;
+			acceleration[1][lane] = particleAcceleration.y;
+			acceleration[2][lane] = particleAcceleration.z;
+			penetration[lane] = contact.Penetration;
+			restitution[lane] = contact.Restitution;
+			inverseMass[lane] = particle->GetInverseMass();
+		}
+
+		__m128 n[3], separatingVelocity = zero, accCausedSepVelocity = zero;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			n[axis] = _mm_load_ps(normal[axis]);
+			separatingVelocity = _mm_add_ps(separatingVelocity, _mm_mul_ps(_mm_load_ps(velocity[axis]), n[axis]));
+			accCausedSepVelocity = _mm_add_ps(accCausedSepVelocity, _mm_mul_ps(_mm_load_ps(acceleration[axis]), n[axis]));
+		}
+		accCausedSepVelocity = _mm_mul_ps(accCausedSepVelocity, dt);
+		const __m128 bounce = _mm_load_ps(restitution);
+		const __m128 depth = _mm_load_ps(penetration);
+		const __m128 hasFiniteMass = _mm_cmpgt_ps(_mm_load_ps(inverseMass), zero);
+
+		// The same tests as the iterative resolver uses to pick a contact
+		const __m128 needsResolving = _mm_and_ps(hasFiniteMass,
+			_mm_or_ps(_mm_cmplt_ps(separatingVelocity, closingVelocityTolerance), _mm_cmpgt_ps(depth, penetrationTolerance)));
+		int resolvedLanes = _mm_movemask_ps(needsResolving);
+		if (!resolvedLanes)
+			continue;
+
+		// Velocity: as in ParticleContact::resolveVelocity. With a single
+		// particle its inverse mass cancels out of the impulse
+		__m128 newSepVelocity = _mm_mul_ps(_mm_sub_ps(zero, separatingVelocity), bounce);
+		const __m128 accCausedClosing = _mm_cmplt_ps(accCausedSepVelocity, zero);
+		const __m128 withoutAccBuildUp = _mm_max_ps(_mm_add_ps(newSepVelocity, _mm_mul_ps(bounce, accCausedSepVelocity)), zero);
+		newSepVelocity = _mm_or_ps(_mm_and_ps(accCausedClosing, withoutAccBuildUp), _mm_andnot_ps(accCausedClosing, newSepVelocity));
+		const __m128 closing = _mm_cmple_ps(separatingVelocity, zero);
+		const int closingLanes = _mm_movemask_ps(closing);
+		const __m128 deltaVelocity = _mm_and_ps(closing, _mm_sub_ps(newSepVelocity, separatingVelocity));
+
+		// Interpenetration: the particle moves out by the whole depth
+		const __m128 move = _mm_max_ps(depth, zero);
+
+		alignas(16) float velocityChange[3][BatchWidth];
+		alignas(16) float movement[3][BatchWidth];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			_mm_store_ps(velocityChange[axis], _mm_mul_ps(n[axis], deltaVelocity));
+			_mm_store_ps(movement[axis], _mm_mul_ps(n[axis], move));
+		}
+
+		for (int lane = 0; resolvedLanes; ++lane, resolvedLanes >>= 1)
+		{
+			if (!(resolvedLanes & 1))
+				continue;
+
+			ParticleContact& contact = contactArray[first + lane];
+			Particle* particle = contact.ContactParticles[0];
+			if (closingLanes & (1 << lane))
+			{
+				particle->SetVelocity(particle->GetVelocity() + Vector3(velocityChange[0][lane], velocityChange[1][lane], velocityChange[2][lane]));
+			}
+			if (penetration[lane] > 0)
+			{
+				contact.ParticleMovement[0] = Vector3(movement[0][lane], movement[1][lane], movement[2][lane]);
+				contact.ParticleMovement[1] = Vector3::Zero;
+				particle->SetPosition(particle->GetPosition() + contact.ParticleMovement[0]);
+				contact.Penetration = 0;
+			}
+		}
+	}
+}
+
+void ParticleContactResolver::MeasureResidual(const ParticleContact *contactArray, const int& numContacts, float& outMaxPenetration, float& outMaxClosingVelocity)
+{
+	outMaxPenetration = 0;
+	outMaxClosingVelocity = 0;
+	for (int i = 0; i < numContacts; ++i)
+	{
+		outMaxPenetration = std::max(outMaxPenetration, contactArray[i].Penetration);
+		outMaxClosingVelocity = std::max(outMaxClosingVelocity, -contactArray[i].calculateSeparatingVelocity());
+	}
+}
+
+void ParticleContactResolver::resolveIterative(ParticleContact *contactArray, const int& numContacts, const float& duration)
 {
 	int i;
 
+	startBudget();
 	m_iterationsUsed = 0;
+	m_lastStopReason = ParticleContactResolverStopReason::IterationLimit;
 	while (m_iterationsUsed < m_iterations)
 	{
+		if (budgetExceeded())
+		{
+			m_lastStopReason = ParticleContactResolverStopReason::TimeBudget;
+			break;
+		}
+
 		// Find the contact with the largest closing velocity;
 		float max = std::numeric_limits<float>::max();
 		int maxIndex = numContacts;
@@ -28,7 +206,7 @@ void ParticleContactResolver::ResolveContacts(ParticleContact *contactArray, con
 		{
 			float sepVel = contactArray[i].calculateSeparatingVelocity();
 			if (sepVel < max &&
-				(sepVel < 0 || contactArray[i].Penetration > 0))
+				(sepVel < -m_closingVelocityTolerance || contactArray[i].Penetration > m_penetrationTolerance))
 			{
 				max = sepVel;
 				maxIndex = i;
@@ -36,7 +214,11 @@ void ParticleContactResolver::ResolveContacts(ParticleContact *contactArray, con
 		}
 
 		// Do we have anything worth resolving?
-		if (maxIndex == numContacts) break;
+		if (maxIndex == numContacts)
+		{
+			m_lastStopReason = ParticleContactResolverStopReason::Converged;
+			break;
+		}
 
 		// resolve this contact
 		contactArray[maxIndex].resolve(duration);
@@ -69,3 +251,341 @@ void ParticleContactResolver::ResolveContacts(ParticleContact *contactArray, con
 		m_iterationsUsed++;
 	}
 }
+
+void ParticleContactResolver::resolveGraphColored(ParticleContact *contactArray, const int& numContacts, const float& duration)
+{
+	// Batches smaller than this are not worth the cost of a parallel_for,
+	// bigger ones are split into chunks of this size
+	static const int parallelChunkSize = 64;
+
+	startBudget();
+	colorContacts(contactArray, numContacts);
+
+	m_iterationsUsed = 0;
+	m_lastStopReason = ParticleContactResolverStopReason::IterationLimit;
+	const int serialStart = m_batchStart.back();
+	const int batchEnd = static_cast<int>(m_batchContact.size());
+	for (unsigned sweep = 0; sweep < m_batchSweeps; ++sweep)
+	{
+		if (batchesConverged())
+		{
+			m_lastStopReason = ParticleContactResolverStopReason::Converged;
+			break;
+		}
+
+		bool outOfTime = false;
+		for (unsigned color = 0; color < m_colorCount; ++color)
+		{
+			if (budgetExceeded())
+			{
+				outOfTime = true;
+				break;
+			}
+
+			const int begin = m_batchStart[color];
+			const int end = m_batchStart[color + 1];
+			if (end - begin <= parallelChunkSize)
+			{
+				resolveBatchRange(begin, end, duration);
+			}
+			else
+			{
+				concurrency::parallel_for(begin, end, parallelChunkSize, [&](int chunkBegin)
+				{
+					resolveBatchRange(chunkBegin, std::min(chunkBegin + parallelChunkSize, end), duration);
+				});
+			}
+			++m_iterationsUsed;
+		}
+
+		if (outOfTime)
+		{
+			m_lastStopReason = ParticleContactResolverStopReason::TimeBudget;
+			break;
+		}
+
+		// Contacts which couldn't be colored are padded to a group of
+		// their own, so the kernel never sees two of them at once
+		resolveBatchRange(serialStart, batchEnd, duration);
+	}
+
+	// The last sweep may have been the one which converged
+	if (m_lastStopReason == ParticleContactResolverStopReason::IterationLimit && batchesConverged())
+		m_lastStopReason = ParticleContactResolverStopReason::Converged;
+
+	// Write the result back to the particles and contacts
+	const int dummySlot = static_cast<int>(m_slotParticles.size());
+	for (int slot = 0; slot < dummySlot; ++slot)
+	{
+		Particle* particle = m_slotParticles[slot];
+		particle->SetVelocity(Vector3(m_slotVelocity[0][slot], m_slotVelocity[1][slot], m_slotVelocity[2][slot]));
+		particle->SetPosition(particle->GetPosition() + Vector3(m_slotMovement[0][slot], m_slotMovement[1][slot], m_slotMovement[2][slot]));
+	}
+	for (int i = 0; i < batchEnd; ++i)
+	{
+		const int contactIndex = m_batchContact[i];
+		if (contactIndex < 0)
+			continue;
+
+		ParticleContact& contact = contactArray[contactIndex];
+		const int s0 = m_batchSlot[0][i];
+		const int s1 = m_batchSlot[1][i];
+		contact.ParticleMovement[0] = Vector3(m_slotMovement[0][s0], m_slotMovement[1][s0], m_slotMovement[2][s0]);
+		contact.ParticleMovement[1] = Vector3(m_slotMovement[0][s1], m_slotMovement[1][s1], m_slotMovement[2][s1]);
+		contact.Penetration -= (contact.ParticleMovement[0] - contact.ParticleMovement[1]).Dot(contact.ContactNormal);
+	}
+}
+
+void ParticleContactResolver::colorContacts(ParticleContact *contactArray, const int& numContacts)
+{
+	const ParticleFrameStdAllocator<int> scratch(m_frameAllocator);
+	ParticleFrameUnorderedMap<Particle*, int> particleSlots(numContacts * 2 + 1, std::hash<Particle*>(), std::equal_to<Particle*>(), scratch);
+	m_slotParticles.clear();
+	m_slotColors.clear();
+	m_contactColors.resize(numContacts);
+
+	// Gather the particles into slots
+	auto slotOf = [this, &particleSlots](Particle* particle) -> int
+	{
+		auto it = particleSlots.find(particle);
+		if (it != particleSlots.end())
+			return it->second;
+
+		const int slot = static_cast<int>(m_slotParticles.size());
+		particleSlots.emplace(particle, slot);
+		m_slotParticles.push_back(particle);
+		m_slotColors.push_back(0);
+		return slot;
+	};
+
+	// Greedy coloring: every contact takes the lowest color which is
+	// not used by any other contact of its particles yet
+	ParticleFrameVector<int> colorSizes(static_cast<size_t>(MaxColors), 0, scratch);
+	m_colorCount = 0;
+	int uncolored = 0;
+	for (int i = 0; i < numContacts; ++i)
+	{
+		const int s0 = slotOf(contactArray[i].ContactParticles[0]);
+		const int s1 = contactArray[i].ContactParticles[1] ? slotOf(contactArray[i].ContactParticles[1]) : -1;
+
+		uint64_t usedColors = m_slotColors[s0];
+		if (s1 >= 0) usedColors |= m_slotColors[s1];
+
+		if (usedColors == std::numeric_limits<uint64_t>::max())
+		{
+			m_contactColors[i] = -1;
+			++uncolored;
+			continue;
+		}
+
+		int color = 0;
+		while (usedColors & (uint64_t(1) << color)) ++color;
+
+		m_contactColors[i] = color;
+		m_slotColors[s0] |= uint64_t(1) << color;
+		if (s1 >= 0) m_slotColors[s1] |= uint64_t(1) << color;
+		++colorSizes[color];
+		m_colorCount = std::max(m_colorCount, static_cast<unsigned>(color + 1));
+	}
+
+	// Batches are padded to the SIMD width, uncolored contacts get a
+	// whole group each
+	m_batchStart.assign(m_colorCount + 1, 0);
+	for (unsigned color = 0; color < m_colorCount; ++color)
+	{
+		const int paddedSize = (colorSizes[color] + BatchWidth - 1) / BatchWidth * BatchWidth;
+		m_batchStart[color + 1] = m_batchStart[color] + paddedSize;
+	}
+	const int batchEnd = m_batchStart.back() + uncolored * BatchWidth;
+
+	// Slot data, the dummy slot stays zero with infinite mass
+	const int slotCount = static_cast<int>(m_slotParticles.size()) + 1;
+	const int dummySlot = slotCount - 1;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_slotVelocity[axis].assign(slotCount, 0.f);
+		m_slotAcceleration[axis].assign(slotCount, 0.f);
+		m_slotMovement[axis].assign(slotCount, 0.f);
+	}
+	m_slotInverseMass.assign(slotCount, 0.f);
+	for (int slot = 0; slot < dummySlot; ++slot)
+	{
+		const Particle* particle = m_slotParticles[slot];
+		const Vector3 velocity = particle->GetVelocity();
+		const Vector3 acceleration = particle->GetEffectiveAcceleration();
+		m_slotVelocity[0][slot] = velocity.x;
+		m_slotVelocity[1][slot] = velocity.y;
+		m_slotVelocity[2][slot] = velocity.z;
+		m_slotAcceleration[0][slot] = acceleration.x;
+		m_slotAcceleration[1][slot] = acceleration.y;
+		m_slotAcceleration[2][slot] = acceleration.z;
+		m_slotInverseMass[slot] = particle->GetInverseMass();
+	}
+
+	// Contact data in batch order, padding lanes point at the dummy slot
+	m_batchContact.assign(batchEnd, -1);
+	m_batchSlot[0].assign(batchEnd, dummySlot);
+	m_batchSlot[1].assign(batchEnd, dummySlot);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_batchNormal[axis].assign(batchEnd, 0.f);
+	}
+	m_batchPenetration.assign(batchEnd, 0.f);
+	m_batchRestitution.assign(batchEnd, 0.f);
+
+	ParticleFrameVector<int> cursor(m_batchStart.begin(), m_batchStart.end() - 1, scratch);
+	int serialCursor = m_batchStart.back();
+	for (int i = 0; i < numContacts; ++i)
+	{
+		int index;
+		if (m_contactColors[i] >= 0)
+		{
+			index = cursor[m_contactColors[i]]++;
+		}
+		else
+		{
+			index = serialCursor;
+			serialCursor += BatchWidth;
+		}
+
+		const ParticleContact& contact = contactArray[i];
+		m_batchContact[index] = i;
+		m_batchSlot[0][index] = particleSlots[contact.ContactParticles[0]];
+		m_batchSlot[1][index] = contact.ContactParticles[1] ? particleSlots[contact.ContactParticles[1]] : dummySlot;
+		m_batchNormal[0][index] = contact.ContactNormal.x;
+		m_batchNormal[1][index] = contact.ContactNormal.y;
+		m_batchNormal[2][index] = contact.ContactNormal.z;
+		m_batchPenetration[index] = contact.Penetration;
+		m_batchRestitution[index] = contact.Restitution;
+	}
+}
+
+void ParticleContactResolver::resolveBatchRange(const int& begin, const int& end, const float& duration)
+{
+	const int dummySlot = static_cast<int>(m_slotParticles.size());
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 dt = _mm_set1_ps(duration);
+	const __m128 smallestMass = _mm_set1_ps(std::numeric_limits<float>::min());
+
+	for (int i = begin; i < end; i += BatchWidth)
+	{
+		const int* s0 = &m_batchSlot[0][i];
+		const int* s1 = &m_batchSlot[1][i];
+
+		// Gathers a slot value of the four lanes
+		auto gather = [](const std::vector<float>& data, const int* slots)
+		{
+			return _mm_set_ps(data[slots[3]], data[slots[2]], data[slots[1]], data[slots[0]]);
+		};
+
+		const __m128 nx = _mm_loadu_ps(&m_batchNormal[0][i]);
+		const __m128 ny = _mm_loadu_ps(&m_batchNormal[1][i]);
+		const __m128 nz = _mm_loadu_ps(&m_batchNormal[2][i]);
+		const __m128 restitution = _mm_loadu_ps(&m_batchRestitution[i]);
+		const __m128 penetration = _mm_loadu_ps(&m_batchPenetration[i]);
+
+		const __m128 inverseMass0 = gather(m_slotInverseMass, s0);
+		const __m128 inverseMass1 = gather(m_slotInverseMass, s1);
+		const __m128 totalInverseMass = _mm_add_ps(inverseMass0, inverseMass1);
+		const __m128 hasFiniteMass = _mm_cmpgt_ps(totalInverseMass, zero);
+		const __m128 safeTotalInverseMass = _mm_max_ps(totalInverseMass, smallestMass);
+
+		__m128 v0[3], v1[3], d0[3], d1[3];
+		__m128 separatingVelocity = zero;
+		__m128 accCausedSepVelocity = zero;
+		__m128 movedTowards = zero;
+		const __m128 normal[3] = { nx, ny, nz };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			v0[axis] = gather(m_slotVelocity[axis], s0);
+			v1[axis] = gather(m_slotVelocity[axis], s1);
+			d0[axis] = gather(m_slotMovement[axis], s0);
+			d1[axis] = gather(m_slotMovement[axis], s1);
+			const __m128 relativeAcc = _mm_sub_ps(gather(m_slotAcceleration[axis], s0), gather(m_slotAcceleration[axis], s1));
+
+			separatingVelocity = _mm_add_ps(separatingVelocity, _mm_mul_ps(_mm_sub_ps(v0[axis], v1[axis]), normal[axis]));
+			accCausedSepVelocity = _mm_add_ps(accCausedSepVelocity, _mm_mul_ps(relativeAcc, normal[axis]));
+			movedTowards = _mm_add_ps(movedTowards, _mm_mul_ps(_mm_sub_ps(d0[axis], d1[axis]), normal[axis]));
+		}
+		accCausedSepVelocity = _mm_mul_ps(accCausedSepVelocity, dt);
+
+		// Velocity: same as ParticleContact::resolveVelocity, lanes which
+		// are separating get an impulse of zero
+		__m128 newSepVelocity = _mm_mul_ps(_mm_sub_ps(zero, separatingVelocity), restitution);
+		const __m128 accCausedClosing = _mm_cmplt_ps(accCausedSepVelocity, zero);
+		const __m128 withoutAccBuildUp = _mm_max_ps(_mm_add_ps(newSepVelocity, _mm_mul_ps(restitution, accCausedSepVelocity)), zero);
+		newSepVelocity = _mm_or_ps(_mm_and_ps(accCausedClosing, withoutAccBuildUp), _mm_andnot_ps(accCausedClosing, newSepVelocity));
+
+		const __m128 closing = _mm_and_ps(_mm_cmple_ps(separatingVelocity, zero), hasFiniteMass);
+		const __m128 impulse = _mm_and_ps(closing, _mm_div_ps(_mm_sub_ps(newSepVelocity, separatingVelocity), safeTotalInverseMass));
+
+		// Interpenetration: the penetration left after the movement of
+		// all earlier contacts of these particles
+		const __m128 currentPenetration = _mm_sub_ps(penetration, movedTowards);
+		const __m128 penetrating = _mm_and_ps(_mm_cmpgt_ps(currentPenetration, zero), hasFiniteMass);
+		const __m128 movePerIMass = _mm_and_ps(penetrating, _mm_div_ps(currentPenetration, safeTotalInverseMass));
+
+		float result[4][3][4];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const __m128 impulsePerIMass = _mm_mul_ps(normal[axis], impulse);
+			const __m128 moveAxis = _mm_mul_ps(normal[axis], movePerIMass);
+			_mm_storeu_ps(result[0][axis], _mm_add_ps(v0[axis], _mm_mul_ps(impulsePerIMass, inverseMass0)));
+			_mm_storeu_ps(result[1][axis], _mm_sub_ps(v1[axis], _mm_mul_ps(impulsePerIMass, inverseMass1)));
+			_mm_storeu_ps(result[2][axis], _mm_add_ps(d0[axis], _mm_mul_ps(moveAxis, inverseMass0)));
+			_mm_storeu_ps(result[3][axis], _mm_sub_ps(d1[axis], _mm_mul_ps(moveAxis, inverseMass1)));
+		}
+
+		// Scatter, the dummy slot and padding lanes are never written
+		for (int lane = 0; lane < BatchWidth; ++lane)
+		{
+			if (m_batchContact[i + lane] < 0)
+				continue;
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				m_slotVelocity[axis][s0[lane]] = result[0][axis][lane];
+				m_slotMovement[axis][s0[lane]] = result[2][axis][lane];
+				if (s1[lane] != dummySlot)
+				{
+					m_slotVelocity[axis][s1[lane]] = result[1][axis][lane];
+					m_slotMovement[axis][s1[lane]] = result[3][axis][lane];
+				}
+			}
+		}
+	}
+}
+
+bool ParticleContactResolver::batchesConverged() const
+{
+	const int batchEnd = static_cast<int>(m_batchContact.size());
+	for (int i = 0; i < batchEnd; ++i)
+	{
+		if (m_batchContact[i] < 0)
+			continue;
+
+		const int s0 = m_batchSlot[0][i];
+		const int s1 = m_batchSlot[1][i];
+		float separatingVelocity = 0;
+		float movedTowards = 0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			separatingVelocity += (m_slotVelocity[axis][s0] - m_slotVelocity[axis][s1]) * m_batchNormal[axis][i];
+			movedTowards += (m_slotMovement[axis][s0] - m_slotMovement[axis][s1]) * m_batchNormal[axis][i];
+		}
+
+		if (separatingVelocity < -m_closingVelocityTolerance || m_batchPenetration[i] - movedTowards > m_penetrationTolerance)
+			return false;
+	}
+	return true;
+}
+
+void ParticleContactResolver::startBudget()
+{
+	m_deadline = std::chrono::high_resolution_clock::now() + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<float>(m_timeBudget));
+}
+
+bool ParticleContactResolver::budgetExceeded() const
+{
+	return m_timeBudget > 0 && std::chrono::high_resolution_clock::now() >= m_deadline;
+}
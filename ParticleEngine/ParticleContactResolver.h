@@ -1,4 +1,47 @@
 #pragma once
+class ParticleFrameAllocator;
+
+/**
+* Selects the algorithm used by ParticleContactResolver::ResolveContacts.
+*/
+enum class ParticleContactResolverMode : int
+{
+	/**
+	* Millington's serial loop: always resolves the contact with the
+	* worst closing velocity first.
+	*/
+	Iterative,
+
+	/**
+	* Colors the contact graph so that no two contacts of one color share
+	* a particle and resolves every color batch in parallel (and four
+	* contacts at a time with SSE) for a fixed number of sweeps.
+	*/
+	GraphColored
+};
+
+/**
+* Tells why the last call of ParticleContactResolver::ResolveContacts
+* stopped.
+*/
+enum class ParticleContactResolverStopReason : int
+{
+	/**
+	* No contact had a penetration or closing velocity above the
+	* convergence tolerance anymore.
+	*/
+	Converged,
+
+	/**
+	* All iterations (or sweeps) were used up.
+	*/
+	IterationLimit,
+
+	/**
+	* The time budget ran out before the contacts converged.
+	*/
+	TimeBudget
+};
 
 /**
 * The contact resolution routine for particle contacts. One
@@ -17,6 +60,52 @@ public:
 	*/
 	void SetIterations(const unsigned& iterations);
 
+	/**
+	* Contacts with less penetration and closing velocity than these
+	* tolerances count as resolved. Both default to zero.
+	*/
+	void SetConvergenceTolerance(const float& penetration, const float& closingVelocity);
+
+	/**
+	* Sets the wall time in seconds one call of ResolveContacts may use
+	* at most. Zero means no budget. As the iterative resolver always
+	* resolves the worst contact first, the contacts left when the
+	* budget runs out are the least important ones.
+	*/
+	void SetTimeBudget(const float& seconds);
+
+	/**
+	* Returns why the last call of ResolveContacts stopped and how many
+	* iterations (color batches in graph colored mode) it used.
+	*/
+	ParticleContactResolverStopReason GetLastStopReason() const;
+	unsigned GetIterationsUsed() const;
+
+	/**
+	* The graph colored mode takes its per-call scratch memory from this
+	* allocator. Without one it uses the heap.
+	*/
+	void SetFrameAllocator(ParticleFrameAllocator* frameAllocator);
+
+	/**
+	* Sets the algorithm which is used by ResolveContacts.
+	*/
+	void SetMode(const ParticleContactResolverMode& mode);
+	ParticleContactResolverMode GetMode() const;
+
+	/**
+	* Sets how often the graph colored solver sweeps over all color
+	* batches. Only used in ParticleContactResolverMode::GraphColored.
+	*/
+	void SetBatchSweeps(const unsigned& sweeps);
+	unsigned GetBatchSweeps() const;
+
+	/**
+	* Returns the number of colors the last graph colored resolution
+	* needed.
+	*/
+	unsigned GetColorCount() const;
+
 	/**
 	* Resolves a set of particle contacts for both penetration
 	* and velocity.
@@ -48,7 +137,53 @@ public:
 	*/
 	void ResolveContacts(ParticleContact *contactArray, const int& numContacts, const float& duration);
 
+	/**
+	* Resolves contacts of a single particle with the scenery whose
+	* particle has no other contact, four at a time with SSE. Such a
+	* contact can't be disturbed by any other one, so resolving it once
+	* solves it exactly, with the same result as ResolveContacts would
+	* give it, without iterating or updating the other contacts.
+	*/
+	void ResolveIsolatedContacts(ParticleContact *contactArray, const int& numContacts, const float& duration) const;
+
+	/**
+	* Measures how far a set of contacts is from being resolved: the
+	* largest penetration and the largest closing velocity (a positive
+	* number) of all contacts.
+	*/
+	static void MeasureResidual(const ParticleContact *contactArray, const int& numContacts, float& outMaxPenetration, float& outMaxClosingVelocity);
+
 protected:
+	void resolveIterative(ParticleContact *contactArray, const int& numContacts, const float& duration);
+	void resolveGraphColored(ParticleContact *contactArray, const int& numContacts, const float& duration);
+
+	/**
+	* Assigns every contact a color so that no two contacts with the same
+	* color share a particle and sorts the contacts into padded batches
+	* of SoA data. Contacts of particles that are part of more than
+	* MaxColors contacts are padded to a group of their own after the
+	* last batch.
+	*/
+	void colorContacts(ParticleContact *contactArray, const int& numContacts);
+
+	/**
+	* Resolves velocity and interpenetration of the contacts
+	* [begin, end) of the batch data, four at a time.
+	*/
+	void resolveBatchRange(const int& begin, const int& end, const float& duration);
+
+	/**
+	* Returns true if none of the batch contacts is above the convergence
+	* tolerance.
+	*/
+	bool batchesConverged() const;
+
+	/**
+	* Starts the clock for the time budget of one ResolveContacts call.
+	*/
+	void startBudget();
+	bool budgetExceeded() const;
+
 	/**
 	* Holds the number of iterations allowed.
 	*/
@@ -59,4 +194,38 @@ protected:
 	* of the actual number of iterations used.
 	*/
 	unsigned m_iterationsUsed = 0;
-};
\ No newline at end of file
+
+	float m_penetrationTolerance = 0;
+	float m_closingVelocityTolerance = 0;
+	float m_timeBudget = 0;
+	std::chrono::high_resolution_clock::time_point m_deadline;
+	ParticleContactResolverStopReason m_lastStopReason = ParticleContactResolverStopReason::Converged;
+
+	ParticleFrameAllocator* m_frameAllocator = nullptr;
+	ParticleContactResolverMode m_mode = ParticleContactResolverMode::Iterative;
+	unsigned m_batchSweeps = 4;
+	unsigned m_colorCount = 0;
+
+	/**
+	* Scratch data of the graph colored solver. The particles of all
+	* contacts are gathered into slots, the last slot is a dummy slot
+	* with infinite mass which stands in for the scenery.
+	*/
+	static const int MaxColors = 64;
+	static const int BatchWidth = 4;
+
+	std::vector<Particle*> m_slotParticles;
+	std::vector<uint64_t> m_slotColors;
+	std::vector<float> m_slotVelocity[3];
+	std::vector<float> m_slotAcceleration[3];
+	std::vector<float> m_slotMovement[3];
+	std::vector<float> m_slotInverseMass;
+
+	std::vector<int> m_contactColors;
+	std::vector<int> m_batchStart;
+	std::vector<int> m_batchContact;
+	std::vector<int> m_batchSlot[2];
+	std::vector<float> m_batchNormal[3];
+	std::vector<float> m_batchPenetration;
+	std::vector<float> m_batchRestitution;
+};
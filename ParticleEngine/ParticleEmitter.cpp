@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "ParticleEmitter.h"
+
+using namespace DirectX::SimpleMath;
+
+ParticleEmitter::ParticleEmitter(ParticleWorld* particleWorld, const std::vector<ParticleManagement*>& manageParticlesInThis, const unsigned& seed)
+	: m_particleWorld(particleWorld), m_manageParticlesInThis(manageParticlesInThis), m_random(seed)
+{
+	m_prototype.SetMass(1);
+}
+
+void ParticleEmitter::Update(const float& deltaTime)
+{
+	m_pending += m_rate * deltaTime;
+	const int count = static_cast<int>(m_pending);
+	m_pending -= count;
+
+	// Particles which don't fit into the pool are dropped, not emitted later
+	// all at once
+	m_lastEmitted = 0;
+	if (count > 0)
+		emit(count, deltaTime);
+}
+
+void ParticleEmitter::SetRate(const float& particlesPerSecond)
+{
+	m_rate = std::max(0.f, particlesPerSecond);
+}
+
+float ParticleEmitter::GetRate() const
+{
+	return m_rate;
+}
+
+void ParticleEmitter::SetPoint(const DirectX::SimpleMath::Vector3& position)
+{
+	m_shape = ParticleEmitterShape::Point;
+	m_shapeStart = position;
+	m_shapeEnd = position;
+}
+
+void ParticleEmitter::SetLine(const DirectX::SimpleMath::Vector3& start, const DirectX::SimpleMath::Vector3& end)
+{
+	m_shape = ParticleEmitterShape::Line;
+	m_shapeStart = start;
+	m_shapeEnd = end;
+}
+
+void ParticleEmitter::SetArc(const DirectX::SimpleMath::Vector3& center, const float& radius, const float& fromAngle, const float& toAngle)
+{
+	m_shape = ParticleEmitterShape::Arc;
+	m_shapeStart = center;
+	m_shapeEnd = center;
+	m_arcRadius = radius;
+	m_arcFrom = fromAngle;
+	m_arcTo = toAngle;
+}
+
+void ParticleEmitter::SetBox(const DirectX::SimpleMath::Vector3& minimum, const DirectX::SimpleMath::Vector3& maximum)
+{
+	m_shape = ParticleEmitterShape::Box;
+	m_shapeStart = Vector3::Min(minimum, maximum);
+	m_shapeEnd = Vector3::Max(minimum, maximum);
+}
+
+ParticleEmitterShape ParticleEmitter::GetShape() const
+{
+	return m_shape;
+}
+
+void ParticleEmitter::SetVelocity(const DirectX::SimpleMath::Vector3& direction, const float& spread, const float& minSpeed, const float& maxSpeed)
+{
+	m_direction = std::atan2(direction.y, direction.x);
+	m_spread = spread;
+	m_minSpeed = minSpeed;
+	m_maxSpeed = std::max(minSpeed, maxSpeed);
+}
+
+Particle& ParticleEmitter::GetPrototype()
+{
+	return m_prototype;
+}
+
+void ParticleEmitter::SetLifetime(const float& minSeconds, const float& maxSeconds)
+{
+	m_minLifetime = std::max(0.f, minSeconds);
+	m_maxLifetime = std::max(m_minLifetime, maxSeconds);
+}
+
+void ParticleEmitter::SetBallistic(const bool& ballistic)
+{
+	m_ballistic = ballistic;
+}
+
+int ParticleEmitter::GetLastEmittedCount() const
+{
+	return m_lastEmitted;
+}
+
+void ParticleEmitter::emit(const int& count, const float& deltaTime)
+{
+	if (static_cast<int>(m_emitted.size()) < count)
+		m_emitted.resize(count);
+
+	const int emitted = m_particleWorld->GetNewParticles(m_prototype, count, m_emitted.data());
+	for (int index = 0; index < emitted; ++index)
+	{
+		// The particles of this update left the emitter one after the other,
+		// the first one has flown almost the whole update already
+		const float age = (count - index - 0.5f) / count * deltaTime;
+		const Vector3 velocity = sampleVelocity();
+		Particle* particle = m_emitted[index];
+		particle->SetPosition(samplePosition() + velocity * age);
+		particle->SetVelocity(velocity);
+		if (m_maxLifetime > 0)
+			m_particleWorld->SetParticleLifetime(particle, sampleUniform(m_minLifetime, m_maxLifetime) - age);
+	}
+
+	for (auto& particleManager : m_manageParticlesInThis)
+	{
+		particleManager->AddParticle(m_emitted.data(), emitted);
+	}
+	if (m_ballistic)
+		m_particleWorld->LaunchBallistic(m_emitted.data(), emitted);
+	m_lastEmitted = emitted;
+}
+
+DirectX::SimpleMath::Vector3 ParticleEmitter::samplePosition()
+{
+	switch (m_shape)
+	{
+	case ParticleEmitterShape::Line:
+		return Vector3::Lerp(m_shapeStart, m_shapeEnd, sampleUniform(0, 1));
+	case ParticleEmitterShape::Arc:
+	{
+		const float angle = sampleUniform(m_arcFrom, m_arcTo);
+		return m_shapeStart + Vector3(std::cos(angle), std::sin(angle), 0) * m_arcRadius;
+	}
+	case ParticleEmitterShape::Box:
+		return Vector3(sampleUniform(m_shapeStart.x, m_shapeEnd.x), sampleUniform(m_shapeStart.y, m_shapeEnd.y), sampleUniform(m_shapeStart.z, m_shapeEnd.z));
+	default:
+		return m_shapeStart;
+	}
+}
+
+DirectX::SimpleMath::Vector3 ParticleEmitter::sampleVelocity()
+{
+	const float angle = m_direction + sampleUniform(-m_spread, m_spread);
+	const float speed = sampleUniform(m_minSpeed, m_maxSpeed);
+	return Vector3(std::cos(angle), std::sin(angle), 0) * speed;
+}
+
+float ParticleEmitter::sampleUniform(const float& from, const float& to)
+{
+	return from + (to - from) * std::uniform_real_distribution<float>(0, 1)(m_random);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+enum class ParticleEmitterShape
+{
+	Point,
+	Line,
+	Arc,
+	Box
+};
+
+/**
+* Emits particles at a rate in particles per second, so the number of
+* particles doesn't depend on the frame rate; fractions of a particle
+* carry over to the next update. The particles of an update are taken
+* from the world at once and start as copies of the prototype, then get
+* a position on the shape and a velocity. They are spread over the time
+* of the update, as if they had been emitted one after the other.
+*
+* Every emitter has its own random number generator, emitters with the
+* same seed and settings emit the same particles.
+*/
+class ParticleEmitter
+{
+public:
+	ParticleEmitter() = delete;
+	ParticleEmitter(ParticleWorld* particleWorld, const std::vector<ParticleManagement*>& manageParticlesInThis, const unsigned& seed = 0);
+	virtual ~ParticleEmitter() = default;
+
+	virtual void Update(const float& deltaTime);
+
+	void SetRate(const float& particlesPerSecond);
+	float GetRate() const;
+
+	void SetPoint(const DirectX::SimpleMath::Vector3& position);
+	void SetLine(const DirectX::SimpleMath::Vector3& start, const DirectX::SimpleMath::Vector3& end);
+
+	/**
+	* Angles are in radians around the z axis, counter clockwise from
+	* the x axis.
+	*/
+	void SetArc(const DirectX::SimpleMath::Vector3& center, const float& radius, const float& fromAngle, const float& toAngle);
+	void SetBox(const DirectX::SimpleMath::Vector3& minimum, const DirectX::SimpleMath::Vector3& maximum);
+	ParticleEmitterShape GetShape() const;
+
+	/**
+	* The particles fly within spread radians to either side of the
+	* direction, in the xy plane, at a speed between minSpeed and
+	* maxSpeed.
+	*/
+	void SetVelocity(const DirectX::SimpleMath::Vector3& direction, const float& spread, const float& minSpeed, const float& maxSpeed);
+
+	/**
+	* Mass, radius, acceleration, type and everything else the particles
+	* start with.
+	*/
+	Particle& GetPrototype();
+
+	/**
+	* The particles live between minSeconds and maxSeconds, evenly
+	* distributed, see ParticleWorld::SetParticleLifetime. Zero for both
+	* emits particles without a lifetime, which is the default.
+	*/
+	void SetLifetime(const float& minSeconds, const float& maxSeconds);
+
+	/**
+	* Ballistic particles are launched by ParticleWorld::LaunchBallistic.
+	*/
+	void SetBallistic(const bool& ballistic);
+
+	int GetLastEmittedCount() const;
+
+protected:
+	void emit(const int& count, const float& deltaTime);
+	DirectX::SimpleMath::Vector3 samplePosition();
+	DirectX::SimpleMath::Vector3 sampleVelocity();
+	float sampleUniform(const float& from, const float& to);
+
+	ParticleWorld* m_particleWorld;
+	std::vector<ParticleManagement*> m_manageParticlesInThis;
+	std::mt19937 m_random;
+	float m_rate = 0;
+	float m_pending = 0;
+
+	ParticleEmitterShape m_shape = ParticleEmitterShape::Point;
+	// Point and line use the start, the line ends at the end, the box
+	// spans both and the arc is around the start
+	DirectX::SimpleMath::Vector3 m_shapeStart = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 m_shapeEnd = DirectX::SimpleMath::Vector3::Zero;
+	float m_arcRadius = 0;
+	float m_arcFrom = 0;
+	float m_arcTo = 0;
+
+	float m_direction = 0;
+	float m_spread = 0;
+	float m_minSpeed = 0;
+	float m_maxSpeed = 0;
+
+	Particle m_prototype;
+	float m_minLifetime = 0;
+	float m_maxLifetime = 0;
+	bool m_ballistic = false;
+	std::vector<Particle*> m_emitted;
+	int m_lastEmitted = 0;
+};
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "ParticleForceField.h"
+
+using namespace DirectX::SimpleMath;
+
+bool ParticleForceField::Affects(const ParticleTypes& type) const
+{
+	return (TypeMask & ParticleCollisionFilter::GetCategory(type)) != 0;
+}
+
+DirectX::SimpleMath::Vector3 ParticleForceField::AccelerationAt(const DirectX::SimpleMath::Vector3& position) const
+{
+	switch (Shape)
+	{
+	case ParticleForceFieldShape::Region:
+		if (position.x < Minimum.x || position.y < Minimum.y || position.z < Minimum.z ||
+			position.x > Maximum.x || position.y > Maximum.y || position.z > Maximum.z)
+			return Vector3::Zero;
+		return Acceleration;
+	case ParticleForceFieldShape::Radial:
+	case ParticleForceFieldShape::Vortex:
+	{
+		const Vector3 offset = position - Center;
+		const float distanceSquared = offset.LengthSquared();
+		if (distanceSquared >= Radius * Radius || distanceSquared <= 0)
+			return Vector3::Zero;
+
+		const float distance = std::sqrt(distanceSquared);
+		const float scale = Strength * (1.f - distance / Radius) / distance;
+		if (Shape == ParticleForceFieldShape::Radial)
+			return offset * scale;
+		return Vector3(-offset.y, offset.x, 0) * scale;
+	}
+	default:
+		return Acceleration;
+	}
+}
+
+bool ParticleForceField::GetBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const
+{
+	switch (Shape)
+	{
+	case ParticleForceFieldShape::Region:
+		outMin = Minimum;
+		outMax = Maximum;
+		return true;
+	case ParticleForceFieldShape::Radial:
+	case ParticleForceFieldShape::Vortex:
+		outMin = Center - Vector3(Radius, Radius, Radius);
+		outMax = Center + Vector3(Radius, Radius, Radius);
+		return true;
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+enum class ParticleForceFieldShape
+{
+	// Everywhere
+	Uniform,
+	// Inside the box from Minimum to Maximum, like a fan
+	Region,
+	// Away from the center within the radius, towards it for a negative
+	// strength
+	Radial,
+	// Around the center within the radius in the xy plane, counter
+	// clockwise for a positive strength
+	Vortex
+};
+
+/**
+* An acceleration the world applies to the particles of the types in
+* TypeMask while it integrates them, on top of their own acceleration.
+* Uniform and region fields accelerate by Acceleration. Radial and
+* vortex fields accelerate by Strength at the center, fading out
+* linearly towards the radius.
+*/
+struct ParticleForceField
+{
+	ParticleForceFieldShape Shape = ParticleForceFieldShape::Uniform;
+	DirectX::SimpleMath::Vector3 Acceleration = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 Minimum = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 Maximum = DirectX::SimpleMath::Vector3::Zero;
+	DirectX::SimpleMath::Vector3 Center = DirectX::SimpleMath::Vector3::Zero;
+	float Radius = 0;
+	float Strength = 0;
+	// The categories of the types the field acts on, see
+	// ParticleCollisionFilter::GetCategory
+	unsigned TypeMask = ~0u;
+	bool Enabled = true;
+
+	bool Affects(const ParticleTypes& type) const;
+
+	/**
+	* The acceleration of the field at the position, the type mask
+	* aside.
+	*/
+	DirectX::SimpleMath::Vector3 AccelerationAt(const DirectX::SimpleMath::Vector3& position) const;
+
+	/**
+	* Box outside of which the field doesn't accelerate, false for a
+	* uniform field.
+	*/
+	bool GetBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const;
+};
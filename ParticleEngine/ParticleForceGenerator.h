@@ -7,4 +7,16 @@ class ParticleForceGenerator
 public:
 	virtual ~ParticleForceGenerator() = default;
 	virtual void UpdateForce(Particle* particle, const float& deltaTime) = 0;
+
+	/**
+	* The particle on the other end, for generators which connect two
+	* particles. Connected particles fall asleep and wake up together.
+	*/
+	virtual Particle* GetConnectedParticle() const { return nullptr; }
+
+	/**
+	* Generators which point at particles replace the pointers after the
+	* particle storage was reordered.
+	*/
+	virtual void RemapParticles(const ParticleRemap& remap) {}
 };
\ No newline at end of file
@@ -13,9 +13,17 @@ ParticleForceRegistry::~ParticleForceRegistry()
 
 void ParticleForceRegistry::Add(Particle* particle, ParticleForceGenerator* forceGenerator)
 {
+	auto known = m_forceGeneratorIndices.find(forceGenerator);
+	if (known == m_forceGeneratorIndices.end())
+	{
+		known = m_forceGeneratorIndices.insert(std::make_pair(forceGenerator, static_cast<int>(m_forceGenerators.size()))).first;
+		m_forceGenerators.push_back(forceGenerator);
+	}
+
 	ParticleForceRegistration registration;
 	registration.Particle = particle;
 	registration.ForceGenerator = forceGenerator;
+	registration.ForceGeneratorIndex = known->second;
 	m_registrations.push_back(registration);
 }
 
@@ -31,20 +39,82 @@ void ParticleForceRegistry::Remove(Particle* particle, ParticleForceGenerator* f
 	}
 }
 
+void ParticleForceRegistry::Forget(ParticleForceGenerator* forceGenerator)
+{
+	auto known = m_forceGeneratorIndices.find(forceGenerator);
+	if (known == m_forceGeneratorIndices.end())
+		return;
+
+	m_registrations.erase(std::remove_if(m_registrations.begin(), m_registrations.end(),
+		[forceGenerator](const ParticleForceRegistration& registration) { return registration.ForceGenerator == forceGenerator; }),
+		m_registrations.end());
+	m_forceGenerators[known->second] = nullptr;
+	m_forceGeneratorIndices.erase(known);
+}
+
 void ParticleForceRegistry::Clear()
 {
 	m_registrations.clear();
 }
 
+void ParticleForceRegistry::RemoveInactiveParticles()
+{
+	removeInactiveParticle();
+}
+
 void ParticleForceRegistry::UpdateForces(const float& deltaTime)
 {
 	removeInactiveParticle();
 	for (ParticleForceRegistration& i : m_registrations)
 	{
+		if (!i.Particle->IsAwake())
+		{
+			Particle* connected = i.ForceGenerator->GetConnectedParticle();
+			if (!connected || !connected->IsAwake())
+				continue;
+			i.Particle->SetAwake(true);
+		}
 		i.ForceGenerator->UpdateForce(i.Particle, deltaTime);
 	}
 }
 
+void ParticleForceRegistry::GetConnections(ParticleFrameVector<std::pair<Particle*, Particle*>>& outConnections) const
+{
+	for (const ParticleForceRegistration& registration : m_registrations)
+	{
+		if (Particle* connected = registration.ForceGenerator->GetConnectedParticle())
+			outConnections.push_back(std::make_pair(registration.Particle, connected));
+	}
+}
+
+void ParticleForceRegistry::RemapParticles(const ParticleRemap& remap, ParticleFrameAllocator* frameAllocator)
+{
+	ParticleFrameVector<ParticleForceGenerator*> generators(frameAllocator);
+	generators.reserve(m_registrations.size());
+	for (ParticleForceRegistration& registration : m_registrations)
+	{
+		registration.Particle = remap(registration.Particle);
+		generators.push_back(registration.ForceGenerator);
+	}
+
+	std::sort(generators.begin(), generators.end(), std::less<ParticleForceGenerator*>());
+	generators.erase(std::unique(generators.begin(), generators.end()), generators.end());
+	for (ParticleForceGenerator* generator : generators)
+	{
+		generator->RemapParticles(remap);
+	}
+}
+
+const std::vector<ParticleForceRegistry::ParticleForceRegistration>& ParticleForceRegistry::GetRegistrations() const
+{
+	return m_registrations;
+}
+
+const std::vector<ParticleForceGenerator*>& ParticleForceRegistry::GetForceGenerators() const
+{
+	return m_forceGenerators;
+}
+
 void ParticleForceRegistry::removeInactiveParticle()
 {
 	for (std::vector<ParticleForceRegistration>::iterator it = m_registrations.begin(); it != m_registrations.end();)
@@ -10,17 +10,67 @@ public:
 
 	void Add(Particle* particle, ParticleForceGenerator* forceGenerator);
 	void Remove(Particle* particle, ParticleForceGenerator* forceGenerator);
+
+	/**
+	* Drops the registrations of the force generator and its slot in
+	* GetForceGenerators(), which stays empty so the others keep their
+	* indices. A generator added later at the same address is a new one.
+	*/
+	void Forget(ParticleForceGenerator* forceGenerator);
+
+	/**
+	* Drops the registrations, the force generators stay known.
+	*/
 	void Clear();
+
+	/**
+	* Drops the registrations of inactive particles, UpdateForces does
+	* so as well.
+	*/
+	void RemoveInactiveParticles();
+
+	/**
+	* Skips sleeping particles, unless they are connected to an awake
+	* particle, which wakes them up.
+	*/
 	void UpdateForces(const float& deltaTime);
 
-protected:
-	void removeInactiveParticle();
+	/**
+	* Appends the particle pairs of all force generators which connect
+	* two particles.
+	*/
+	void GetConnections(ParticleFrameVector<std::pair<Particle*, Particle*>>& outConnections) const;
+
+	/**
+	* Replaces the particle pointers of the registrations and their force
+	* generators after the particle storage was reordered. Generators
+	* which are shared by several registrations are remapped once.
+	*/
+	void RemapParticles(const ParticleRemap& remap, ParticleFrameAllocator* frameAllocator);
 
 	struct ParticleForceRegistration
 	{
 		Particle* Particle;
 		ParticleForceGenerator* ForceGenerator;
+		// Index of the generator in GetForceGenerators()
+		int ForceGeneratorIndex;
 	};
 
+	const std::vector<ParticleForceRegistration>& GetRegistrations() const;
+
+	/**
+	* Every force generator which was ever added, in the order they were
+	* added first, so a world which is set up by the same code knows the
+	* same generators under the same indices, see
+	* ParticleWorld::RestoreSnapshot. Forgotten generators leave a null
+	* slot.
+	*/
+	const std::vector<ParticleForceGenerator*>& GetForceGenerators() const;
+
+protected:
+	void removeInactiveParticle();
+
 	std::vector<ParticleForceRegistration> m_registrations;
+	std::vector<ParticleForceGenerator*> m_forceGenerators;
+	std::unordered_map<ParticleForceGenerator*, int> m_forceGeneratorIndices;
 };
@@ -0,0 +1,220 @@
+#include "pch.h"
+#include "ParticleFrameAllocator.h"
+
+ParticleFrameAllocator::ParticleFrameAllocator(const size_t& capacity)
+	: m_capacity(capacity)
+{
+	m_memory = static_cast<char*>(::operator new(capacity));
+}
+
+ParticleFrameAllocator::~ParticleFrameAllocator()
+{
+	Reset();
+	::operator delete(m_memory);
+}
+
+void* ParticleFrameAllocator::Allocate(const size_t& size, const size_t& alignment)
+{
+	size_t alignedOffset = (m_offset + alignment - 1) & ~(alignment - 1);
+	if (alignedOffset + size <= m_capacity)
+	{
+		m_offset = alignedOffset + size;
+		m_highWaterMark = std::max(m_highWaterMark, m_offset + m_overflowSize);
+		return m_memory + alignedOffset;
+	}
+
+	// Doesn't fit anymore, the next Reset grows the main block
+	char* block = static_cast<char*>(::operator new(size));
+	m_overflowBlocks.push_back(block);
+	m_overflowSize += size;
+	m_highWaterMark = std::max(m_highWaterMark, m_offset + m_overflowSize);
+	return block;
+}
+
+void ParticleFrameAllocator::Reset()
+{
+	for (char* block : m_overflowBlocks)
+	{
+		::operator delete(block);
+	}
+	m_overflowBlocks.clear();
+
+	if (m_highWaterMark > m_capacity)
+	{
+		::operator delete(m_memory);
+		m_capacity = std::max(m_capacity * 2, m_highWaterMark);
+		m_memory = static_cast<char*>(::operator new(m_capacity));
+	}
+	m_offset = 0;
+	m_overflowSize = 0;
+}
+
+size_t ParticleFrameAllocator::GetUsed() const
+{
+	return m_offset + m_overflowSize;
+}
+
+size_t ParticleFrameAllocator::GetCapacity() const
+{
+	return m_capacity;
+}
+
+size_t ParticleFrameAllocator::GetHighWaterMark() const
+{
+	return m_highWaterMark;
+}
+
+bool ParticleFrameAllocator::HasOverflowed() const
+{
+	return !m_overflowBlocks.empty();
+}
+
+#if defined(_DEBUG) && defined(PARTICLE_ASSERT_NO_STEP_HEAP_ALLOCATIONS)
+
+static thread_local unsigned long long s_heapAllocations = 0;
+
+// Every replaceable form of new ends up here, so none of them gets past
+// the count
+static void* countedAllocation(const size_t& size) noexcept
+{
+	++s_heapAllocations;
+	return malloc(size ? size : 1);
+}
+
+static void* countedAllocationOrThrow(const size_t& size)
+{
+	if (void* memory = countedAllocation(size))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size)
+{
+	return countedAllocationOrThrow(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedAllocationOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return countedAllocation(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+#ifdef __cpp_aligned_new
+
+static void* countedAlignedAllocation(const size_t& size, const std::align_val_t& alignment) noexcept
+{
+	++s_heapAllocations;
+	return _aligned_malloc(size ? size : 1, static_cast<size_t>(alignment));
+}
+
+static void* countedAlignedAllocationOrThrow(const size_t& size, const std::align_val_t& alignment)
+{
+	if (void* memory = countedAlignedAllocation(size, alignment))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return countedAlignedAllocationOrThrow(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return countedAlignedAllocationOrThrow(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAlignedAllocation(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return countedAlignedAllocation(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	_aligned_free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	_aligned_free(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(memory);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	_aligned_free(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	_aligned_free(memory);
+}
+
+#endif
+
+unsigned long long ParticleHeapGuard::GetAllocationCount()
+{
+	return s_heapAllocations;
+}
+
+#else
+
+unsigned long long ParticleHeapGuard::GetAllocationCount()
+{
+	return 0;
+}
+
+#endif
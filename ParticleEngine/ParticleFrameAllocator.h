@@ -0,0 +1,113 @@
+#pragma once
+
+/**
+* Define this in a debug build to count every global heap allocation and
+* let ParticleWorld::RunPhysics assert that a steady-state step (same load
+* as the step before, no arena had to grow) doesn't allocate at all.
+*/
+//#define PARTICLE_ASSERT_NO_STEP_HEAP_ALLOCATIONS
+
+/**
+* A linear (bump) allocator for the scratch memory of one physics step.
+* Allocating is a pointer increment, there is no deallocation: Reset
+* hands all memory back at once. If a step needs more than the capacity,
+* the allocator falls back to extra blocks and grows its main block to
+* the high water mark on the next Reset, so a steady load ends up using
+* one block only.
+*/
+class ParticleFrameAllocator
+{
+public:
+	explicit ParticleFrameAllocator(const size_t& capacity);
+	~ParticleFrameAllocator();
+
+	ParticleFrameAllocator(const ParticleFrameAllocator&) = delete;
+	ParticleFrameAllocator& operator=(const ParticleFrameAllocator&) = delete;
+
+	void* Allocate(const size_t& size, const size_t& alignment);
+	void Reset();
+
+	size_t GetUsed() const;
+	size_t GetCapacity() const;
+	size_t GetHighWaterMark() const;
+
+	/**
+	* True if the allocations since the last Reset didn't fit into the
+	* main block.
+	*/
+	bool HasOverflowed() const;
+
+private:
+	char* m_memory = nullptr;
+	size_t m_capacity = 0;
+	size_t m_offset = 0;
+	size_t m_overflowSize = 0;
+	size_t m_highWaterMark = 0;
+	std::vector<char*> m_overflowBlocks;
+};
+
+/**
+* STL allocator on top of a ParticleFrameAllocator. Without a frame
+* allocator it uses the global heap, so containers with it work outside
+* of a ParticleWorld step too. Memory from a frame allocator must not be
+* used after the next Reset.
+*/
+template<typename T>
+class ParticleFrameStdAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ParticleFrameStdAllocator(ParticleFrameAllocator* frameAllocator = nullptr) : m_frameAllocator(frameAllocator) {}
+	template<typename U>
+	ParticleFrameStdAllocator(const ParticleFrameStdAllocator<U>& other) : m_frameAllocator(other.GetFrameAllocator()) {}
+
+	T* allocate(const size_t n)
+	{
+		if (m_frameAllocator)
+			return static_cast<T*>(m_frameAllocator->Allocate(n * sizeof(T), alignof(T)));
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* pointer, const size_t)
+	{
+		if (!m_frameAllocator)
+			::operator delete(pointer);
+	}
+
+	ParticleFrameAllocator* GetFrameAllocator() const { return m_frameAllocator; }
+
+private:
+	ParticleFrameAllocator* m_frameAllocator;
+};
+
+template<typename T, typename U>
+bool operator==(const ParticleFrameStdAllocator<T>& lhs, const ParticleFrameStdAllocator<U>& rhs)
+{
+	return lhs.GetFrameAllocator() == rhs.GetFrameAllocator();
+}
+
+template<typename T, typename U>
+bool operator!=(const ParticleFrameStdAllocator<T>& lhs, const ParticleFrameStdAllocator<U>& rhs)
+{
+	return !(lhs == rhs);
+}
+
+template<typename T>
+using ParticleFrameVector = std::vector<T, ParticleFrameStdAllocator<T>>;
+
+template<typename Key, typename Value>
+using ParticleFrameUnorderedMap = std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>, ParticleFrameStdAllocator<std::pair<const Key, Value>>>;
+
+/**
+* Global heap allocations on the current thread through any form of
+* operator new, only counted with PARTICLE_ASSERT_NO_STEP_HEAP_ALLOCATIONS
+* in a debug build.
+*/
+namespace ParticleHeapGuard
+{
+	unsigned long long GetAllocationCount();
+}
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "ParticleLifetimeWheel.h"
+
+static const uint32_t slotMask = ParticleLifetimeWheel::SlotsPerLevel - 1;
+// Entries further in the future wait in the last level and are put back
+// into the wheel once they come up there too early
+static const uint32_t maxTicksAhead = (1u << (ParticleLifetimeWheel::LevelBits * ParticleLifetimeWheel::LevelCount)) - 1;
+
+ParticleLifetimeWheel::ParticleLifetimeWheel(const float& tickDuration)
+	: m_tickDuration(tickDuration)
+{
+	assert(tickDuration > 0);
+	m_slots.resize(LevelCount * SlotsPerLevel);
+}
+
+void ParticleLifetimeWheel::Schedule(Particle* particle)
+{
+	if (!particle->HasLifetime())
+		return;
+
+	insert(Entry{ particle, particle->GetExpiryTime() });
+	++m_entries;
+}
+
+void ParticleLifetimeWheel::Advance(const float& time, ParticleFrameVector<Particle*>& outExpired)
+{
+	const uint32_t lastTick = tickOf(time);
+	for (; m_nextTick <= lastTick; ++m_nextTick)
+	{
+		// Whenever a level turns over, the next slot of the level above
+		// moves down into it
+		for (int level = 1; level < LevelCount; ++level)
+		{
+			const uint32_t lowerBits = m_nextTick & ((1u << (LevelBits * level)) - 1);
+			if (lowerBits != 0)
+				break;
+			cascade(level, (m_nextTick >> (LevelBits * level)) & slotMask);
+		}
+
+		std::vector<Entry>& due = slot(0, m_nextTick & slotMask);
+		for (size_t index = 0; index < due.size(); ++index)
+		{
+			const Entry entry = due[index];
+			if (!entry.Target->IsActive() || entry.Target->GetExpiryTime() != entry.ExpiryTime)
+			{
+				--m_entries;
+				continue;
+			}
+			if (expiryTickOf(entry.ExpiryTime) > m_nextTick)
+			{
+				// Only reinserted into another slot, the due one is cleared
+				insert(entry);
+				continue;
+			}
+
+			outExpired.push_back(entry.Target);
+			--m_entries;
+		}
+		due.clear();
+	}
+}
+
+void ParticleLifetimeWheel::RemapParticles(const ParticleRemap& remap)
+{
+	for (std::vector<Entry>& entries : m_slots)
+	{
+		for (Entry& entry : entries)
+		{
+			entry.Target = remap(entry.Target);
+		}
+	}
+}
+
+void ParticleLifetimeWheel::Clear()
+{
+	for (std::vector<Entry>& entries : m_slots)
+	{
+		entries.clear();
+	}
+	m_entries = 0;
+}
+
+void ParticleLifetimeWheel::Reset(const float& time)
+{
+	Clear();
+	m_nextTick = tickOf(time);
+}
+
+int ParticleLifetimeWheel::GetEntryCount() const
+{
+	return m_entries;
+}
+
+uint32_t ParticleLifetimeWheel::tickOf(const float& time) const
+{
+	return static_cast<uint32_t>(std::max(0.f, std::floor(time / m_tickDuration)));
+}
+
+uint32_t ParticleLifetimeWheel::expiryTickOf(const float& expiryTime) const
+{
+	return static_cast<uint32_t>(std::max(0.f, std::ceil(expiryTime / m_tickDuration)));
+}
+
+void ParticleLifetimeWheel::insert(const Entry& entry)
+{
+	// Expired entries are due in the next tick
+	const uint32_t expiryTick = std::max(expiryTickOf(entry.ExpiryTime), m_nextTick);
+	const uint32_t tick = m_nextTick + std::min(expiryTick - m_nextTick, maxTicksAhead);
+	const uint32_t ticksAhead = tick - m_nextTick;
+
+	int level = 0;
+	while (level + 1 < LevelCount && ticksAhead >= (1u << (LevelBits * (level + 1))))
+	{
+		++level;
+	}
+	slot(level, (tick >> (LevelBits * level)) & slotMask).push_back(entry);
+}
+
+void ParticleLifetimeWheel::cascade(const int& level, const int& index)
+{
+	std::vector<Entry>& entries = slot(level, index);
+	for (const Entry& entry : entries)
+	{
+		insert(entry);
+	}
+	entries.clear();
+}
+
+std::vector<ParticleLifetimeWheel::Entry>& ParticleLifetimeWheel::slot(const int& level, const int& index)
+{
+	return m_slots[level * SlotsPerLevel + index];
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/**
+* Hierarchical timing wheel of the particles which have a lifetime.
+* Time is cut into ticks; the first level has a slot for each of the
+* next SlotsPerLevel ticks, every further level covers SlotsPerLevel
+* slots of the level below. Entries move down a level whenever the
+* wheel turns past the slot of their level, so scheduling and expiring
+* a particle costs constant time and advancing the wheel only touches
+* the particles which expire or move down.
+*
+* The wheel doesn't hear of particles which die in another way or get
+* a new lifetime: an entry only expires its particle if the particle is
+* still active and its expiry time is still the one of the entry.
+*/
+class ParticleLifetimeWheel
+{
+public:
+	explicit ParticleLifetimeWheel(const float& tickDuration = 1.f / 60.f);
+
+	/**
+	* Schedules the particle for its expiry time, see
+	* Particle::SetExpiryTime.
+	*/
+	void Schedule(Particle* particle);
+
+	/**
+	* Turns the wheel to the given time and writes the particles which
+	* expired until then to outExpired.
+	*/
+	void Advance(const float& time, ParticleFrameVector<Particle*>& outExpired);
+
+	void RemapParticles(const ParticleRemap& remap);
+	void Clear();
+
+	/**
+	* Clears the wheel and turns it back or forth to the given time, for
+	* example when a world restores a snapshot.
+	*/
+	void Reset(const float& time);
+
+	/**
+	* Scheduled entries, including the stale ones of particles which
+	* died before their expiry.
+	*/
+	int GetEntryCount() const;
+
+	static const int LevelBits = 6;
+	static const int SlotsPerLevel = 1 << LevelBits;
+	static const int LevelCount = 4;
+
+private:
+	struct Entry
+	{
+		Particle* Target;
+		float ExpiryTime;
+	};
+
+	/**
+	* The tick a time falls into, and the first tick at the end of which
+	* an expiry time has passed.
+	*/
+	uint32_t tickOf(const float& time) const;
+	uint32_t expiryTickOf(const float& expiryTime) const;
+
+	/**
+	* Puts an entry into the slot of its expiry tick, on the lowest level
+	* which reaches that far from the next tick.
+	*/
+	void insert(const Entry& entry);
+
+	/**
+	* Moves the entries of a slot down to the levels below.
+	*/
+	void cascade(const int& level, const int& index);
+
+	std::vector<Entry>& slot(const int& level, const int& index);
+
+	float m_tickDuration;
+	// The next tick the wheel turns past
+	uint32_t m_nextTick = 0;
+	std::vector<std::vector<Entry>> m_slots;
+	int m_entries = 0;
+};
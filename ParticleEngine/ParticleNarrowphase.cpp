@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "ParticleNarrowphase.h"
+
+using namespace DirectX::SimpleMath;
+
+int ParticleNarrowphase::AddContacts(const std::pair<Particle*, Particle*>* pairs, const size_t& pairCount, ParticleContact* contact, const int& limit, ParticleContactEventStream* events)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 threeHalves = _mm_set1_ps(1.5f);
+
+	int used = 0;
+	if (limit <= 0)
+		return used;
+
+	for (size_t first = 0; first < pairCount; first += BatchWidth)
+	{
+		const int lanes = static_cast<int>(std::min<size_t>(BatchWidth, pairCount - first));
+
+		// Lanes past the end of the pairs stay at a distance of zero,
+		// which never overlaps
+		alignas(16) float midline[3][BatchWidth] = {};
+		alignas(16) float radii[BatchWidth] = {};
+		for (int lane = 0; lane < lanes; ++lane)
+		{
+			const std::pair<Particle*, Particle*>& pair = pairs[first + lane];
+			const Vector3 offset = pair.first->GetPosition() - pair.second->GetPosition();
+			midline[0][lane] = offset.x;
+			midline[1][lane] = offset.y;
+			midline[2][lane] = offset.z;
+			// Pairs with a particle far from the view have no radius, so
+			// they never overlap
+			const bool detailed = pair.first->GetLodInterval() == 1 && pair.second->GetLodInterval() == 1;
+			radii[lane] = detailed ? pair.first->GetWorldSpaceRadius() + pair.second->GetWorldSpaceRadius() : 0.f;
+		}
+
+		const __m128 x = _mm_load_ps(midline[0]);
+		const __m128 y = _mm_load_ps(midline[1]);
+		const __m128 z = _mm_load_ps(midline[2]);
+		const __m128 radius = _mm_load_ps(radii);
+		const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		const __m128 overlapping = _mm_and_ps(_mm_cmplt_ps(distanceSquared, _mm_mul_ps(radius, radius)), _mm_cmpgt_ps(distanceSquared, zero));
+		int overlappingLanes = _mm_movemask_ps(overlapping);
+		if (!overlappingLanes)
+			continue;
+
+		// One Newton-Raphson step brings the estimate of the reciprocal
+		// square root to nearly full float precision
+		__m128 inverseDistance = _mm_rsqrt_ps(distanceSquared);
+		inverseDistance = _mm_mul_ps(inverseDistance, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, distanceSquared), _mm_mul_ps(inverseDistance, inverseDistance))));
+
+		alignas(16) float normal[3][BatchWidth];
+		alignas(16) float penetration[BatchWidth];
+		_mm_store_ps(normal[0], _mm_mul_ps(x, inverseDistance));
+		_mm_store_ps(normal[1], _mm_mul_ps(y, inverseDistance));
+		_mm_store_ps(normal[2], _mm_mul_ps(z, inverseDistance));
+		_mm_store_ps(penetration, _mm_sub_ps(radius, _mm_mul_ps(distanceSquared, inverseDistance)));
+
+		for (int lane = 0; overlappingLanes; ++lane, overlappingLanes >>= 1)
+		{
+			if (!(overlappingLanes & 1))
+				continue;
+
+			Particle* particle = pairs[first + lane].first;
+			Particle* other = pairs[first + lane].second;
+
+			// Sleeping particles only collide with awake ones, which wake
+			// them up
+			if (!particle->IsAwake() && !other->IsAwake())
+				continue;
+
+			const Vector3 contactNormal(normal[0][lane], normal[1][lane], normal[2][lane]);
+			if (events)
+				events->Push(ParticleContactEvent{ particle, other, contactNormal, 0.f, ParticleContactEventKind::Begin });
+			if (ParticleCollisionFilter::GetInteraction(particle->GetType(), other->GetType()) != ParticleInteraction::Collide)
+				continue;
+
+			contact->ContactNormal = contactNormal;
+			contact->ContactParticles[0] = particle;
+			contact->ContactParticles[1] = other;
+			contact->Penetration = penetration[lane];
+			contact->Restitution = particle->GetBouncinessFactor() + other->GetBouncinessFactor();
+			contact++;
+			used++;
+			if (used >= limit)
+				return used;
+		}
+	}
+	return used;
+}
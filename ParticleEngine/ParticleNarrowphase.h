@@ -0,0 +1,28 @@
+#pragma once
+
+/**
+* The particle-particle narrowphase. It takes candidate pairs from any
+* broadphase and turns the overlapping ones into contacts, four pairs at
+* a time with SSE. Pairs are rejected on their squared distance, every
+* accepted pair costs one reciprocal square root for both its normal
+* and its penetration.
+*
+* The first particle of a pair is the first particle of its contact.
+* Pairs of two sleeping particles don't collide. Every other
+* overlapping pair is pushed to the contact event stream, if there is
+* one, and only the pairs which the interaction table wants to collide
+* make a contact. Destroying particles is left to the world, which
+* goes over the events once all contacts are generated.
+*/
+class ParticleNarrowphase
+{
+public:
+	/**
+	* Writes the contacts of the overlapping pairs to contact, at most
+	* limit of them, and returns their number. Stops at the first pair
+	* past the limit, later pairs aren't looked at.
+	*/
+	static int AddContacts(const std::pair<Particle*, Particle*>* pairs, const size_t& pairCount, ParticleContact* contact, const int& limit, ParticleContactEventStream* events = nullptr);
+
+	static const int BatchWidth = 4;
+};
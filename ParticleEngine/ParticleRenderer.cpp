@@ -53,6 +53,9 @@ void ParticleRenderer::Render(ID3D11DeviceContext* deviceContext, const Camera&
 	deviceContext->RSSetState(m_states->CullNone());
 	deviceContext->IASetInputLayout(m_inputLayout.Get());
 
+	if (m_snowDeposit)
+		renderSnowDeposit(deviceContext, camera);
+
 	for(Particle* particle : m_particleWorld->GetActiveParticles())
 	{
 		assert(particle != nullptr && "particle is nullptr!");
@@ -75,6 +78,51 @@ void ParticleRenderer::SetParticleColor(const DirectX::XMVECTORF32& color)
 	m_particleColor = color;
 }
 
+void ParticleRenderer::SetSnowDeposit(const ParticleSnowDeposit* snowDeposit)
+{
+	m_snowDeposit = snowDeposit;
+}
+
+void ParticleRenderer::renderSnowDeposit(ID3D11DeviceContext* deviceContext, const Camera& camera)
+{
+	// One quad of two triangles per layer
+	m_snowDepositVertices.clear();
+	const float width = m_snowDeposit->GetColumnWidth();
+	for (int column = 0; column < m_snowDeposit->GetColumnCount(); ++column)
+	{
+		const float left = m_snowDeposit->GetMinX() + column * width;
+		const float right = left + width;
+		for (int index = 0; index < m_snowDeposit->GetLayerCount(column); ++index)
+		{
+			const ParticleSnowDeposit::Layer& layer = m_snowDeposit->GetLayer(column, index);
+			const VertexPositionColor bottomLeft(Vector3(left, layer.Bottom, 0.f), m_particleColor);
+			const VertexPositionColor bottomRight(Vector3(right, layer.Bottom, 0.f), m_particleColor);
+			const VertexPositionColor topLeft(Vector3(left, layer.Top, 0.f), m_particleColor);
+			const VertexPositionColor topRight(Vector3(right, layer.Top, 0.f), m_particleColor);
+			m_snowDepositVertices.push_back(bottomLeft);
+			m_snowDepositVertices.push_back(topLeft);
+			m_snowDepositVertices.push_back(topRight);
+			m_snowDepositVertices.push_back(bottomLeft);
+			m_snowDepositVertices.push_back(topRight);
+			m_snowDepositVertices.push_back(bottomRight);
+		}
+	}
+	if (m_snowDepositVertices.empty())
+		return;
+
+	m_effect->SetMatrices(Matrix::Identity, camera.GetView(), camera.GetProj());
+	m_effect->Apply(deviceContext);
+
+	// The primitive batch draws at most 2048 vertices at once
+	const size_t maxVertices = 2046;
+	for (size_t first = 0; first < m_snowDepositVertices.size(); first += maxVertices)
+	{
+		m_batch->Begin();
+		m_batch->Draw(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, &m_snowDepositVertices[first], std::min(maxVertices, m_snowDepositVertices.size() - first));
+		m_batch->End();
+	}
+}
+
 void ParticleRenderer::createParticlesVertices()
 {
 	std::vector<Vector2> vertices = createCircleVerticesTriangleList(Vector2::Zero, 0.5f);
@@ -1,5 +1,6 @@
 #pragma once
 class ParticleWorld;
+class ParticleSnowDeposit;
 
 class ParticleRenderer
 {
@@ -12,8 +13,15 @@ public:
 	void Render(ID3D11DeviceContext* deviceContext, const Camera& camera);
 	void SetParticleColor(const DirectX::XMVECTORF32& color);
 
+	/**
+	* The deposit is drawn in the particle color under the particles, the
+	* renderer doesn't own it.
+	*/
+	void SetSnowDeposit(const ParticleSnowDeposit* snowDeposit);
+
 private:
 	void createParticlesVertices();
+	void renderSnowDeposit(ID3D11DeviceContext* deviceContext, const Camera& camera);
 	std::vector<DirectX::SimpleMath::Vector2> createCircleVerticesTriangleList(const DirectX::SimpleMath::Vector2& center, const float& radius) const;
 
 	//rendering
@@ -22,7 +30,9 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_inputLayout;
 	std::unique_ptr<DirectX::CommonStates> m_states;
 	std::vector<DirectX::VertexPositionColor> m_vertices;
+	std::vector<DirectX::VertexPositionColor> m_snowDepositVertices;
 
 	DirectX::XMVECTORF32 m_particleColor = DirectX::Colors::White;
 	ParticleWorld* m_particleWorld = nullptr;
+	const ParticleSnowDeposit* m_snowDeposit = nullptr;
 };
@@ -0,0 +1,324 @@
+#include "pch.h"
+#include "ParticleRewindRecorder.h"
+
+using ParticleBenchmark::BenchmarkClock;
+using ParticleBenchmark::MillisecondsSince;
+
+static void writeVarint(size_t value, std::vector<uint8_t>& outData)
+{
+	while (value >= 0x80)
+	{
+		outData.push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	outData.push_back(static_cast<uint8_t>(value));
+}
+
+static size_t readVarint(const uint8_t*& data)
+{
+	size_t value = 0;
+	for (int shift = 0; ; shift += 7)
+	{
+		const uint8_t byte = *data++;
+		value |= static_cast<size_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+}
+
+ParticleRewindRecorder::ParticleRewindRecorder(ParticleWorld* world, const size_t& memoryBudget, const int& keyframeInterval)
+	: m_world(world), m_keyframeInterval(std::max(1, keyframeInterval)), m_memoryBudget(memoryBudget)
+{
+}
+
+ParticleRewindRecorder::~ParticleRewindRecorder()
+{
+	if (m_encoding)
+		m_encoder.wait();
+}
+
+void ParticleRewindRecorder::Capture()
+{
+	// The frames are deltas of each other, so the previous frame has to
+	// be encoded before the next one starts
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+	if (m_encoding)
+	{
+		m_encoder.wait();
+		m_encoding = false;
+	}
+	const double waitMilliseconds = MillisecondsSince(start);
+
+	if (m_restoredFrame >= 0)
+	{
+		// The frames after the restored one were recorded on a timeline
+		// which is gone
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (!m_frames.empty() && m_frames.back().Number > m_restoredFrame)
+		{
+			m_frames.pop_back();
+		}
+		m_reference.swap(m_decoded);
+		m_decodedFrame = -1;
+		m_nextFrame = m_restoredFrame + 1;
+		m_framesSinceKeyframe = m_keyframeInterval;
+		for (auto frame = m_frames.rbegin(); frame != m_frames.rend(); ++frame)
+		{
+			if (frame->Keyframe)
+			{
+				m_framesSinceKeyframe = m_restoredFrame - frame->Number + 1;
+				break;
+			}
+		}
+		m_restoredFrame = -1;
+	}
+
+	const bool keyframe = m_reference.empty() || m_framesSinceKeyframe >= m_keyframeInterval;
+	m_framesSinceKeyframe = keyframe ? 1 : m_framesSinceKeyframe + 1;
+	const int number = m_nextFrame++;
+	m_world->BeginBackgroundRead();
+	m_encoder.run([this, number, keyframe]()
+	{
+		encode(number, keyframe);
+	});
+	m_encoding = true;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.LastWaitMilliseconds = waitMilliseconds;
+	m_stats.LastCaptureMilliseconds = MillisecondsSince(start);
+	m_stats.TotalCaptureMilliseconds += m_stats.LastCaptureMilliseconds;
+	++m_stats.Captures;
+}
+
+int ParticleRewindRecorder::GetFirstFrame()
+{
+	// The frame still being encoded is in the window, Restore waits for it
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frames.empty() ? m_nextFrame - (m_encoding ? 1 : 0) : m_frames.front().Number;
+}
+
+int ParticleRewindRecorder::GetLastFrame()
+{
+	return m_nextFrame - 1;
+}
+
+bool ParticleRewindRecorder::Restore(const int& frame)
+{
+	const BenchmarkClock::time_point start = BenchmarkClock::now();
+	if (m_encoding)
+	{
+		m_encoder.wait();
+		m_encoding = false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const int index = indexOf(frame);
+	if (index < 0)
+		return false;
+
+	int keyframe = index;
+	while (!m_frames[keyframe].Keyframe)
+	{
+		--keyframe;
+	}
+
+	// Scrubbing forward within a keyframe goes on from the frame decoded
+	// last
+	int from = keyframe;
+	const int decodedIndex = m_decodedFrame >= 0 ? indexOf(m_decodedFrame) : -1;
+	if (decodedIndex >= keyframe && decodedIndex <= index)
+		from = decodedIndex + 1;
+	for (int next = from; next <= index; ++next)
+	{
+		decodeDelta(m_frames[next], m_decoded);
+	}
+	m_decodedFrame = frame;
+	updateWorkingBytes();
+
+	if (!m_world->RestoreSnapshot(m_decoded.data(), m_decoded.size()))
+		return false;
+	m_restoredFrame = frame;
+	m_stats.LastRestoreMilliseconds = MillisecondsSince(start);
+
+	// The decoded snapshot counts against the budget from now on
+	evictFrames();
+	return true;
+}
+
+void ParticleRewindRecorder::Clear()
+{
+	if (m_encoding)
+	{
+		m_encoder.wait();
+		m_encoding = false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_frames.clear();
+	m_reference.clear();
+	updateWorkingBytes();
+	m_framesSinceKeyframe = 0;
+	m_decodedFrame = -1;
+	m_restoredFrame = -1;
+}
+
+void ParticleRewindRecorder::SetMemoryBudget(const size_t& memoryBudget)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_memoryBudget = memoryBudget;
+	evictFrames();
+}
+
+ParticleRewindStats ParticleRewindRecorder::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	ParticleRewindStats stats = m_stats;
+	stats.Frames = static_cast<int>(m_frames.size());
+	stats.Keyframes = 0;
+	stats.FrameBytes = 0;
+	stats.RawBytes = 0;
+	for (const Frame& frame : m_frames)
+	{
+		stats.Keyframes += frame.Keyframe;
+		stats.FrameBytes += frame.Data.capacity();
+		stats.RawBytes += frame.RawSize;
+	}
+	stats.WorkingBytes = m_workingBytes;
+	stats.MemoryBudget = m_memoryBudget;
+	return stats;
+}
+
+void ParticleRewindRecorder::encode(const int& number, const bool& keyframe)
+{
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	m_world->SaveSnapshot(m_pending);
+	m_world->EndBackgroundRead();
+	const double saveMilliseconds = MillisecondsSince(start);
+
+	start = BenchmarkClock::now();
+	encodeDelta(m_pending, keyframe ? nullptr : &m_reference, m_encoded);
+	m_reference.swap(m_pending);
+
+	// The frame only holds what it needs, the scratch keeps its capacity
+	Frame frame;
+	frame.Number = number;
+	frame.Keyframe = keyframe;
+	frame.RawSize = m_reference.size();
+	frame.Data.assign(m_encoded.begin(), m_encoded.end());
+	const double encodeMilliseconds = MillisecondsSince(start);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.LastSaveMilliseconds = saveMilliseconds;
+	m_stats.LastEncodeMilliseconds = encodeMilliseconds;
+	m_stats.LastEncodedBytes = frame.Data.size();
+	m_frames.push_back(std::move(frame));
+	updateWorkingBytes();
+	evictFrames();
+}
+
+void ParticleRewindRecorder::encodeDelta(const std::vector<uint8_t>& snapshot, const std::vector<uint8_t>* reference, std::vector<uint8_t>& outData)
+{
+	// Snapshots are a multiple of their block alignment long
+	assert(snapshot.size() % sizeof(uint64_t) == 0);
+	const size_t words = snapshot.size() / sizeof(uint64_t);
+	const size_t referenceWords = reference ? std::min(words, reference->size() / sizeof(uint64_t)) : 0;
+	const uint64_t* current = reinterpret_cast<const uint64_t*>(snapshot.data());
+	const uint64_t* previous = reference ? reinterpret_cast<const uint64_t*>(reference->data()) : nullptr;
+	auto previousWord = [previous, referenceWords](const size_t& word)
+	{
+		return word < referenceWords ? previous[word] : 0;
+	};
+
+	outData.clear();
+	size_t word = 0;
+	while (word < words)
+	{
+		const size_t unchangedStart = word;
+		while (word < words && current[word] == previousWord(word))
+		{
+			++word;
+		}
+		const size_t changedStart = word;
+		while (word < words && current[word] != previousWord(word))
+		{
+			++word;
+		}
+
+		writeVarint(changedStart - unchangedStart, outData);
+		writeVarint(word - changedStart, outData);
+		const size_t literalsAt = outData.size();
+		outData.resize(literalsAt + (word - changedStart) * sizeof(uint64_t));
+		uint8_t* literals = outData.data() + literalsAt;
+		for (size_t changed = changedStart; changed < word; ++changed)
+		{
+			const uint64_t delta = current[changed] ^ previousWord(changed);
+			memcpy(literals, &delta, sizeof(delta));
+			literals += sizeof(delta);
+		}
+	}
+}
+
+void ParticleRewindRecorder::decodeDelta(const Frame& frame, std::vector<uint8_t>& inOutSnapshot)
+{
+	if (frame.Keyframe)
+		inOutSnapshot.assign(frame.RawSize, 0);
+	else
+		inOutSnapshot.resize(frame.RawSize);
+
+	const size_t words = frame.RawSize / sizeof(uint64_t);
+	uint64_t* snapshot = reinterpret_cast<uint64_t*>(inOutSnapshot.data());
+	const uint8_t* data = frame.Data.data();
+	const uint8_t* end = data + frame.Data.size();
+	size_t word = 0;
+	while (data < end && word < words)
+	{
+		word += readVarint(data);
+		const size_t changed = readVarint(data);
+		for (size_t index = 0; index < changed; ++index, ++word)
+		{
+			uint64_t delta;
+			memcpy(&delta, data, sizeof(delta));
+			snapshot[word] ^= delta;
+			data += sizeof(delta);
+		}
+	}
+}
+
+void ParticleRewindRecorder::evictFrames()
+{
+	size_t bytes = m_workingBytes;
+	for (const Frame& frame : m_frames)
+	{
+		bytes += frame.Data.capacity();
+	}
+
+	while (bytes > m_memoryBudget)
+	{
+		// The front is always a keyframe, it goes up to the next one
+		size_t next = 1;
+		while (next < m_frames.size() && !m_frames[next].Keyframe)
+		{
+			++next;
+		}
+		if (next == m_frames.size())
+			break;
+
+		for (size_t index = 0; index < next; ++index)
+		{
+			bytes -= m_frames.front().Data.capacity();
+			m_frames.pop_front();
+		}
+	}
+}
+
+void ParticleRewindRecorder::updateWorkingBytes()
+{
+	m_workingBytes = m_pending.capacity() + m_reference.capacity() + m_decoded.capacity() + m_encoded.capacity();
+}
+
+int ParticleRewindRecorder::indexOf(const int& frame) const
+{
+	if (m_frames.empty() || frame < m_frames.front().Number || frame > m_frames.back().Number)
+		return -1;
+	return frame - m_frames.front().Number;
+}
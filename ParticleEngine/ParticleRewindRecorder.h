@@ -0,0 +1,156 @@
+#pragma once
+#include "ParticleWorld.h"
+
+/**
+* Memory and time of a ParticleRewindRecorder.
+*/
+struct ParticleRewindStats
+{
+	// Frames in the window, and how many of them are keyframes
+	int Frames = 0;
+	int Keyframes = 0;
+	// Encoded frames and the snapshots the recorder works on besides
+	// them, both held against the memory budget
+	size_t FrameBytes = 0;
+	size_t WorkingBytes = 0;
+	size_t MemoryBudget = 0;
+	// Snapshot bytes of the frames in the window before encoding
+	size_t RawBytes = 0;
+
+	int Captures = 0;
+	// Time Capture took on the thread which runs the world, including
+	// the wait for the encoding of the previous frame
+	double LastCaptureMilliseconds = 0;
+	double LastWaitMilliseconds = 0;
+	double TotalCaptureMilliseconds = 0;
+	// Time the snapshot and the encoding of the last frame took in the
+	// background
+	double LastSaveMilliseconds = 0;
+	double LastEncodeMilliseconds = 0;
+	size_t LastEncodedBytes = 0;
+	double LastRestoreMilliseconds = 0;
+};
+
+/**
+* Records the last frames of a world for rewinding, see
+* ParticleWorld::SaveSnapshot. Capture leaves the snapshot and its
+* encoding to a background task and only waits if the previous frame is
+* still being encoded. The world waits for the snapshot at the next
+* StartFrame or RunPhysics, see ParticleWorld::BeginBackgroundRead, so
+* the copy runs alongside what the game does in between, rendering for
+* one. Every keyframeInterval frames the snapshot is kept whole,
+* in between only the words which changed since the frame before are
+* kept: the snapshot is XORed with the previous one and the runs of
+* zero words are left out.
+*
+* The oldest keyframe goes together with its frames once the frames and
+* the snapshots the recorder works on, about three times the size of a
+* snapshot, use up the memory budget. Restoring a frame decodes it from its keyframe,
+* scrubbing forward within a keyframe goes on from the frame restored
+* last. Capturing after a restore drops the frames after the restored
+* one, the recording goes on from there.
+*/
+class ParticleRewindRecorder
+{
+public:
+	ParticleRewindRecorder(ParticleWorld* world, const size_t& memoryBudget, const int& keyframeInterval = 30);
+	~ParticleRewindRecorder();
+
+	/**
+	* Call after RunPhysics.
+	*/
+	void Capture();
+
+	/**
+	* Frames are numbered by their capture, starting at zero. The window
+	* is empty if the first frame is after the last one.
+	*/
+	int GetFirstFrame();
+	int GetLastFrame();
+
+	/**
+	* False if the frame isn't in the window.
+	*/
+	bool Restore(const int& frame);
+
+	void Clear();
+	void SetMemoryBudget(const size_t& memoryBudget);
+	ParticleRewindStats GetStats();
+
+private:
+	struct Frame
+	{
+		int Number;
+		bool Keyframe;
+		size_t RawSize;
+		std::vector<uint8_t> Data;
+	};
+
+	/**
+	* Runs in the background: saves the world to m_pending, encodes it
+	* against m_reference, or against nothing for a keyframe, and makes it
+	* the new reference.
+	*/
+	void encode(const int& number, const bool& keyframe);
+
+	/**
+	* Appends the words of snapshot which differ from reference to
+	* outData as runs of unchanged and changed words, the changed ones
+	* XORed with the reference. Words beyond the reference count as zero.
+	*/
+	static void encodeDelta(const std::vector<uint8_t>& snapshot, const std::vector<uint8_t>* reference, std::vector<uint8_t>& outData);
+
+	/**
+	* Applies a frame encoded by encodeDelta to the snapshot of the frame
+	* before it.
+	*/
+	static void decodeDelta(const Frame& frame, std::vector<uint8_t>& inOutSnapshot);
+
+	/**
+	* Drops the oldest keyframe with its frames until they fit the budget
+	* next to the working snapshots, the latest keyframe stays. Call with
+	* m_mutex locked.
+	*/
+	void evictFrames();
+
+	/**
+	* Call with m_mutex locked, from the background task or while it
+	* doesn't run.
+	*/
+	void updateWorkingBytes();
+
+	/**
+	* Index of a frame in m_frames, -1 if it isn't in the window. Call
+	* with m_mutex locked.
+	*/
+	int indexOf(const int& frame) const;
+
+	ParticleWorld* m_world;
+	int m_keyframeInterval;
+	size_t m_memoryBudget;
+
+	// The background task saves the world to the pending snapshot and
+	// encodes it against the reference, the snapshot of the frame before
+	std::vector<uint8_t> m_pending;
+	std::vector<uint8_t> m_reference;
+	// Scratch of the background task
+	std::vector<uint8_t> m_encoded;
+	concurrency::task_group m_encoder;
+	bool m_encoding = false;
+
+	int m_nextFrame = 0;
+	int m_framesSinceKeyframe = 0;
+
+	// The snapshot restored last, or scrubbed through
+	std::vector<uint8_t> m_decoded;
+	int m_decodedFrame = -1;
+	// The recording goes on from this frame at the next capture, -1 if
+	// nothing was restored
+	int m_restoredFrame = -1;
+
+	// Guards the frames and the stats, which the background task changes
+	std::mutex m_mutex;
+	std::deque<Frame> m_frames;
+	size_t m_workingBytes = 0;
+	ParticleRewindStats m_stats;
+};
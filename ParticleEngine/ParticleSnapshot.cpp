@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "ParticleSnapshot.h"
+
+static uint64_t alignBlock(const uint64_t& offset)
+{
+	return (offset + ParticleSnapshotHeader::BlockAlignment - 1) & ~(ParticleSnapshotHeader::BlockAlignment - 1);
+}
+
+ParticleSnapshotWriter::ParticleSnapshotWriter(std::vector<uint8_t>& snapshot)
+	: m_snapshot(&snapshot)
+{
+}
+
+void ParticleSnapshotWriter::Finish()
+{
+	uint64_t size = alignBlock(sizeof(ParticleSnapshotHeader) + m_entries.size() * sizeof(ParticleSnapshotBlockEntry));
+	for (ParticleSnapshotBlockEntry& entry : m_entries)
+	{
+		entry.Offset = size;
+		size = alignBlock(size + entry.Count * entry.ElementSize);
+	}
+
+	// Only the padding is cleared, the blocks are written by the caller
+	m_snapshot->resize(static_cast<size_t>(size));
+	uint8_t* data = m_snapshot->data();
+	uint64_t end = 0;
+	for (const ParticleSnapshotBlockEntry& entry : m_entries)
+	{
+		std::fill(data + end, data + entry.Offset, static_cast<uint8_t>(0));
+		end = entry.Offset + entry.Count * entry.ElementSize;
+	}
+	std::fill(data + end, data + size, static_cast<uint8_t>(0));
+
+	ParticleSnapshotHeader header;
+	header.Magic = ParticleSnapshotHeader::CurrentMagic;
+	header.Version = ParticleSnapshotHeader::CurrentVersion;
+	header.ParticleSize = static_cast<uint32_t>(sizeof(Particle));
+	header.BlockCount = static_cast<uint32_t>(m_entries.size());
+	header.Size = size;
+	memcpy(data, &header, sizeof(header));
+	memcpy(data + sizeof(header), m_entries.data(), m_entries.size() * sizeof(ParticleSnapshotBlockEntry));
+}
+
+const ParticleSnapshotBlockEntry* ParticleSnapshotWriter::find(const ParticleSnapshotBlock& block) const
+{
+	for (const ParticleSnapshotBlockEntry& entry : m_entries)
+	{
+		if (entry.Block == static_cast<uint32_t>(block))
+			return &entry;
+	}
+	return nullptr;
+}
+
+bool ParticleSnapshotReader::Open(const void* snapshot, const size_t& size)
+{
+	m_snapshot = nullptr;
+	std::fill(std::begin(m_blocks), std::end(m_blocks), nullptr);
+	if (!snapshot || size < sizeof(ParticleSnapshotHeader))
+		return false;
+
+	const uint8_t* data = static_cast<const uint8_t*>(snapshot);
+	const ParticleSnapshotHeader& header = *reinterpret_cast<const ParticleSnapshotHeader*>(data);
+	if (header.Magic != ParticleSnapshotHeader::CurrentMagic || header.Version != ParticleSnapshotHeader::CurrentVersion ||
+		header.ParticleSize != sizeof(Particle) || header.Size > size)
+		return false;
+	if (header.BlockCount > (size - sizeof(header)) / sizeof(ParticleSnapshotBlockEntry))
+		return false;
+
+	const ParticleSnapshotBlockEntry* entries = reinterpret_cast<const ParticleSnapshotBlockEntry*>(data + sizeof(header));
+	for (uint32_t index = 0; index < header.BlockCount; ++index)
+	{
+		const ParticleSnapshotBlockEntry& entry = entries[index];
+		if (entry.Block >= static_cast<uint32_t>(ParticleSnapshotBlock::Count) || entry.ElementSize == 0 ||
+			entry.Offset % ParticleSnapshotHeader::BlockAlignment != 0 || entry.Offset > header.Size ||
+			entry.Count > (header.Size - entry.Offset) / entry.ElementSize)
+			return false;
+		m_blocks[entry.Block] = &entry;
+	}
+	m_snapshot = data;
+	return true;
+}
+
+ParticleSnapshotFile::~ParticleSnapshotFile()
+{
+	Close();
+}
+
+bool ParticleSnapshotFile::Write(const wchar_t* path, const std::vector<uint8_t>& snapshot)
+{
+	HANDLE file = CreateFileW(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// WriteFile takes at most 4 GB at a time
+	const uint8_t* data = snapshot.data();
+	size_t left = snapshot.size();
+	bool written = true;
+	while (left > 0 && written)
+	{
+		const DWORD chunk = static_cast<DWORD>(std::min<size_t>(left, 1u << 30));
+		DWORD chunkWritten = 0;
+		written = WriteFile(file, data, chunk, &chunkWritten, nullptr) && chunkWritten == chunk;
+		data += chunk;
+		left -= chunk;
+	}
+	CloseHandle(file);
+	return written;
+}
+
+bool ParticleSnapshotFile::Open(const wchar_t* path)
+{
+	Close();
+	m_file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping)
+		m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_view)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void ParticleSnapshotFile::Close()
+{
+	if (m_view)
+		UnmapViewOfFile(m_view);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_view = nullptr;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+	m_size = 0;
+}
+
+const void* ParticleSnapshotFile::GetData() const
+{
+	return m_view;
+}
+
+size_t ParticleSnapshotFile::GetSize() const
+{
+	return m_size;
+}
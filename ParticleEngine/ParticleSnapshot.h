@@ -0,0 +1,183 @@
+#pragma once
+#include "ParticleWorld.h"
+
+/**
+* The blocks of a world snapshot, see ParticleWorld::SaveSnapshot.
+* Particle pointers are stored as indices into the particle storage.
+*/
+enum class ParticleSnapshotBlock : uint32_t
+{
+	// One ParticleSnapshotWorldState
+	World,
+	// The particle storage as it is
+	Particles,
+	// Storage indices of the free particles, in the order of the pool
+	Pool,
+	// Storage indices of the active particles, in their order
+	ActiveParticles,
+	ForceFields,
+	// Storage index of the connected particle of every force generator
+	// the force registry knows, -1 for none or a forgotten generator
+	ForceGenerators,
+	ForceRegistrations,
+	ContactGenerators,
+	// Storage indices of the members of all contact generators, one
+	// after the other
+	ContactGeneratorMembers,
+	TouchingPairs,
+	Count
+};
+
+struct ParticleSnapshotWorldState
+{
+	float Time;
+	unsigned LodStep;
+	unsigned NextLodStagger;
+	int FramesSinceReorder;
+	int MaxPoolSize;
+	unsigned ChangedFieldTypes;
+	ParticlePoolPolicy PoolPolicies[ParticleTypeCount];
+	ParticlePoolTypeReport PoolReports[ParticleTypeCount];
+};
+
+struct ParticleSnapshotForceRegistration
+{
+	int32_t Particle;
+	int32_t ForceGenerator;
+};
+
+struct ParticleSnapshotContactGenerator
+{
+	uint32_t Tag;
+	uint32_t FirstMember;
+	uint32_t MemberCount;
+};
+
+struct ParticleSnapshotPair
+{
+	int32_t First;
+	int32_t Second;
+};
+
+/**
+* A snapshot starts with the header and a table of its blocks. Every
+* block is an array of one element type at an offset aligned to
+* BlockAlignment from the start of the snapshot, so a snapshot which is
+* mapped into memory can be read where it is.
+*/
+struct ParticleSnapshotHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	// sizeof(Particle) of the build which wrote the snapshot, the
+	// particles are stored as they are in memory
+	uint32_t ParticleSize;
+	uint32_t BlockCount;
+	uint64_t Size;
+
+	static const uint32_t CurrentMagic = 0x50534e50; // "PNSP"
+	static const uint32_t CurrentVersion = 2;
+	static const uint64_t BlockAlignment = 64;
+};
+
+struct ParticleSnapshotBlockEntry
+{
+	uint32_t Block;
+	uint32_t ElementSize;
+	uint64_t Offset;
+	uint64_t Count;
+};
+
+/**
+* Lays out the blocks of a snapshot. Reserve every block first, then
+* Finish sizes the snapshot once and writes the header, after which the
+* blocks can be filled.
+*/
+class ParticleSnapshotWriter
+{
+public:
+	explicit ParticleSnapshotWriter(std::vector<uint8_t>& snapshot);
+
+	template<typename T>
+	void Reserve(const ParticleSnapshotBlock& block, const size_t& count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "snapshot blocks are copied as they are");
+		m_entries.push_back(ParticleSnapshotBlockEntry{ static_cast<uint32_t>(block), static_cast<uint32_t>(sizeof(T)), 0, count });
+	}
+
+	void Finish();
+
+	/**
+	* nullptr if the block wasn't reserved.
+	*/
+	template<typename T>
+	T* Get(const ParticleSnapshotBlock& block)
+	{
+		const ParticleSnapshotBlockEntry* entry = find(block);
+		return entry && entry->ElementSize == sizeof(T) ? reinterpret_cast<T*>(m_snapshot->data() + entry->Offset) : nullptr;
+	}
+
+private:
+	const ParticleSnapshotBlockEntry* find(const ParticleSnapshotBlock& block) const;
+
+	std::vector<uint8_t>* m_snapshot;
+	std::vector<ParticleSnapshotBlockEntry> m_entries;
+};
+
+/**
+* Checks a snapshot and hands out its blocks where they are. The
+* snapshot has to stay where it is while the reader is used and should
+* be aligned like memory from new.
+*/
+class ParticleSnapshotReader
+{
+public:
+	/**
+	* False if the data isn't a snapshot of this version and build, or
+	* a block lies outside of it.
+	*/
+	bool Open(const void* snapshot, const size_t& size);
+
+	/**
+	* nullptr if the block is missing or its elements aren't of type T.
+	*/
+	template<typename T>
+	const T* Get(const ParticleSnapshotBlock& block, size_t& outCount) const
+	{
+		const ParticleSnapshotBlockEntry* entry = m_blocks[static_cast<int>(block)];
+		if (!entry || entry->ElementSize != sizeof(T))
+			return nullptr;
+		outCount = static_cast<size_t>(entry->Count);
+		return reinterpret_cast<const T*>(m_snapshot + entry->Offset);
+	}
+
+private:
+	const uint8_t* m_snapshot = nullptr;
+	const ParticleSnapshotBlockEntry* m_blocks[static_cast<int>(ParticleSnapshotBlock::Count)] = {};
+};
+
+/**
+* A snapshot file, written in one go and mapped into memory read only
+* to be restored from.
+*/
+class ParticleSnapshotFile
+{
+public:
+	ParticleSnapshotFile() = default;
+	ParticleSnapshotFile(const ParticleSnapshotFile&) = delete;
+	ParticleSnapshotFile& operator=(const ParticleSnapshotFile&) = delete;
+	~ParticleSnapshotFile();
+
+	static bool Write(const wchar_t* path, const std::vector<uint8_t>& snapshot);
+
+	bool Open(const wchar_t* path);
+	void Close();
+	const void* GetData() const;
+	size_t GetSize() const;
+
+private:
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+	const void* m_view = nullptr;
+	size_t m_size = 0;
+};
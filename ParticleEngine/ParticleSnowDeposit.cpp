@@ -0,0 +1,327 @@
+#include "pch.h"
+#include "ParticleSnowDeposit.h"
+
+using namespace DirectX::SimpleMath;
+
+ParticleSnowDeposit::ParticleSnowDeposit(const float& minX, const float& maxX, const float& columnWidth)
+	: m_minX(minX), m_columnWidth(columnWidth)
+{
+	assert(maxX > minX && columnWidth > 0);
+	m_columnCount = static_cast<int>(std::ceil((maxX - minX) / columnWidth));
+	m_layers.resize(m_columnCount * MaxLayers);
+	m_layerCounts.resize(m_columnCount, 0);
+}
+
+void ParticleSnowDeposit::AddSupport(const ParticlePlatformContactsGenerator* support)
+{
+	m_supports.push_back(support);
+}
+
+void ParticleSnowDeposit::SetBakeFrames(const int& frames)
+{
+	m_bakeFrames = frames;
+}
+
+void ParticleSnowDeposit::SetMaxStep(const float& step)
+{
+	m_maxStep = step;
+}
+
+int ParticleSnowDeposit::AddContact(ParticleContact* contact, const int& limit)
+{
+	int used = 0;
+	for (Particle* particle : m_particles)
+	{
+		if (used >= limit) break;
+
+		// The world runs the generator again when it grows the contact
+		// arena, baked particles are already inactive then
+		if (!particle->IsActive() || particle->IsBallistic()) continue;
+
+		const Vector3 position = particle->GetPosition();
+		const float radius = particle->GetWorldSpaceRadius();
+		const bool rested = !particle->IsAwake() || particle->GetRestingFrames() >= m_bakeFrames;
+		if (particle->GetType() == ParticleTypes::Snow && rested && isSupported(position, radius) && bake(particle))
+		{
+			// The world returns the particle to the pool in the next frame
+			particle->SetActive(false);
+			++m_bakedParticles;
+			continue;
+		}
+
+		if (!particle->IsAwake()) continue;
+
+		float top;
+		if (!findPenetratedTop(position, radius, top))
+			continue;
+
+		contact->ContactNormal = Vector3::Up;
+		contact->Restitution = particle->GetBouncinessFactor();
+		contact->ContactParticles[0] = particle;
+		contact->ContactParticles[1] = nullptr;
+		contact->Penetration = top - (position.y - radius);
+		used++;
+		contact++;
+	}
+	return used;
+}
+
+bool ParticleSnowDeposit::GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const
+{
+	bool found = false;
+	for (int column = 0; column < m_columnCount; ++column)
+	{
+		const Layer* columnLayers = layers(column);
+		for (int layer = 0; layer < m_layerCounts[column]; ++layer)
+		{
+			const float left = m_minX + column * m_columnWidth;
+			const Vector3 low(left, columnLayers[layer].Bottom, 0);
+			const Vector3 high(left + m_columnWidth, columnLayers[layer].Top, 0);
+			outMin = found ? Vector3::Min(outMin, low) : low;
+			outMax = found ? Vector3::Max(outMax, high) : high;
+			found = true;
+		}
+	}
+
+	// The deposit keeps growing while the world relies on the bounds
+	outMax.y += m_maxStep;
+	return found;
+}
+
+void ParticleSnowDeposit::Clear()
+{
+	std::fill(m_layerCounts.begin(), m_layerCounts.end(), 0);
+}
+
+float ParticleSnowDeposit::GetMinX() const
+{
+	return m_minX;
+}
+
+float ParticleSnowDeposit::GetColumnWidth() const
+{
+	return m_columnWidth;
+}
+
+int ParticleSnowDeposit::GetColumnCount() const
+{
+	return m_columnCount;
+}
+
+int ParticleSnowDeposit::GetLayerCount(const int& column) const
+{
+	return m_layerCounts[column];
+}
+
+const ParticleSnowDeposit::Layer& ParticleSnowDeposit::GetLayer(const int& column, const int& layer) const
+{
+	return layers(column)[layer];
+}
+
+int ParticleSnowDeposit::GetBakedParticleCount() const
+{
+	return m_bakedParticles;
+}
+
+int ParticleSnowDeposit::columnOf(const float& x) const
+{
+	const float column = std::floor((x - m_minX) / m_columnWidth);
+	if (column < 0 || column >= m_columnCount)
+		return -1;
+	return static_cast<int>(column);
+}
+
+void ParticleSnowDeposit::footprint(const float& x, const float& radius, int& outFirst, int& outLast) const
+{
+	// The bottom half of the particle, which rests on the deposit
+	outFirst = std::max(0, static_cast<int>(std::floor((x - radius * 0.5f - m_minX) / m_columnWidth)));
+	outLast = std::min(m_columnCount - 1, static_cast<int>(std::floor((x + radius * 0.5f - m_minX) / m_columnWidth)));
+}
+
+ParticleSnowDeposit::Layer* ParticleSnowDeposit::layers(const int& column)
+{
+	return &m_layers[column * MaxLayers];
+}
+
+const ParticleSnowDeposit::Layer* ParticleSnowDeposit::layers(const int& column) const
+{
+	return &m_layers[column * MaxLayers];
+}
+
+bool ParticleSnowDeposit::isSupported(const DirectX::SimpleMath::Vector3& position, const float& radius) const
+{
+	// Resting particles sink into their support a little or float just
+	// above it, depending on how the contacts were resolved. Snow which
+	// fell asleep on the deposit may have been buried by the snow baked
+	// around it since
+	const float tolerance = radius * 0.5f;
+	for (const ParticlePlatformContactsGenerator* support : m_supports)
+	{
+		if (support->GetDistance(position) <= radius + tolerance)
+			return true;
+	}
+
+	int first, last;
+	footprint(position.x, radius, first, last);
+	const float bottom = position.y - radius;
+	for (int column = first; column <= last; ++column)
+	{
+		const Layer* columnLayers = layers(column);
+		for (int layer = 0; layer < m_layerCounts[column]; ++layer)
+		{
+			if (bottom >= columnLayers[layer].Bottom - tolerance && bottom <= columnLayers[layer].Top + tolerance)
+				return true;
+		}
+	}
+	return false;
+}
+
+ParticleSnowDeposit::Layer* ParticleSnowDeposit::findSurface(const int& column, const float& bottom, const float& tolerance)
+{
+	Layer* columnLayers = layers(column);
+	for (int layer = 0; layer < m_layerCounts[column]; ++layer)
+	{
+		if (bottom >= columnLayers[layer].Bottom - tolerance && bottom <= columnLayers[layer].Top + tolerance)
+			return &columnLayers[layer];
+	}
+	return nullptr;
+}
+
+bool ParticleSnowDeposit::bake(Particle* particle)
+{
+	const Vector3 position = particle->GetPosition();
+	const float radius = particle->GetWorldSpaceRadius();
+	int column = columnOf(position.x);
+	if (column < 0)
+		return false;
+
+	const float bottom = position.y - radius;
+	Layer* layer = findSurface(column, bottom, radius);
+	if (!layer)
+	{
+		// The snow may lie on the deposit of a column next to its own
+		int first, last;
+		footprint(position.x, radius, first, last);
+		for (int other = first; other <= last && !layer; ++other)
+		{
+			layer = findSurface(other, bottom, radius * 0.5f);
+			if (layer)
+				column = other;
+		}
+	}
+	if (!layer)
+	{
+		// Snow on a new surface
+		layer = insertLayer(column, bottom);
+		if (!layer)
+			return false;
+	}
+
+	// The snow slides down to a neighbour which is more than the max step
+	// lower, a few columns at most
+	const int maxSlide = 8;
+	for (int slide = 0; slide < maxSlide; ++slide)
+	{
+		int lowestColumn = -1;
+		Layer* lowest = nullptr;
+		float lowestTop = layer->Top - m_maxStep;
+		for (int neighbour = column - 1; neighbour <= column + 1; neighbour += 2)
+		{
+			if (neighbour < 0 || neighbour >= m_columnCount)
+				continue;
+
+			// The drift continues in the neighbour if it has a deposit on
+			// about the same height, or bare support there
+			Layer* other = findSurface(neighbour, layer->Bottom, m_maxStep);
+			float top = layer->Bottom;
+			if (other)
+				top = other->Top;
+			else if (m_layerCounts[neighbour] == MaxLayers ||
+				!isSupported(Vector3(m_minX + (neighbour + 0.5f) * m_columnWidth, layer->Bottom + radius, 0), radius))
+				continue;
+
+			if (top < lowestTop)
+			{
+				lowestTop = top;
+				lowest = other;
+				lowestColumn = neighbour;
+			}
+		}
+		if (lowestColumn < 0)
+			break;
+
+		if (!lowest)
+			lowest = insertLayer(lowestColumn, layer->Bottom);
+		layer = lowest;
+		column = lowestColumn;
+	}
+
+	// The deposit grows by the cross section of the particle
+	layer->Top += DirectX::XM_PI * radius * radius / m_columnWidth;
+	mergeLayers(column);
+	return true;
+}
+
+ParticleSnowDeposit::Layer* ParticleSnowDeposit::insertLayer(const int& column, const float& bottom)
+{
+	// The layers of a column stay sorted from the lowest to the highest
+	int& count = m_layerCounts[column];
+	if (count == MaxLayers)
+		return nullptr;
+
+	Layer* columnLayers = layers(column);
+	int index = count;
+	while (index > 0 && columnLayers[index - 1].Bottom > bottom)
+	{
+		columnLayers[index] = columnLayers[index - 1];
+		--index;
+	}
+	columnLayers[index] = Layer{ bottom, bottom };
+	++count;
+	return &columnLayers[index];
+}
+
+void ParticleSnowDeposit::mergeLayers(const int& column)
+{
+	Layer* columnLayers = layers(column);
+	int& count = m_layerCounts[column];
+	for (int layer = 0; layer + 1 < count; )
+	{
+		if (columnLayers[layer].Top < columnLayers[layer + 1].Bottom)
+		{
+			++layer;
+			continue;
+		}
+
+		// The lower deposit grew into the one above it
+		columnLayers[layer].Top = std::max(columnLayers[layer].Top, columnLayers[layer + 1].Top);
+		for (int index = layer + 1; index + 1 < count; ++index)
+		{
+			columnLayers[index] = columnLayers[index + 1];
+		}
+		--count;
+	}
+}
+
+bool ParticleSnowDeposit::findPenetratedTop(const DirectX::SimpleMath::Vector3& position, const float& radius, float& outTop) const
+{
+	const float bottom = position.y - radius;
+	bool found = false;
+	int first, last;
+	footprint(position.x, radius, first, last);
+	for (int column = first; column <= last; ++column)
+	{
+		const Layer* columnLayers = layers(column);
+		for (int layer = 0; layer < m_layerCounts[column]; ++layer)
+		{
+			// Particles below the bottom of a deposit pass under it
+			const Layer& deposit = columnLayers[layer];
+			if (position.y <= deposit.Bottom || bottom >= deposit.Top)
+				continue;
+
+			outTop = found ? std::max(outTop, deposit.Top) : deposit.Top;
+			found = true;
+		}
+	}
+	return found;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+/**
+* Snow which rested on static geometry for a while is baked into this
+* heightfield of columns and its particle goes back to the pool, so the
+* snow lying around doesn't use up the particles. A column holds up to
+* MaxLayers separate deposits, one for every surface the snow lies on
+* in it, and the deposits are collision geometry for all particles
+* which are still moving.
+*
+* The deposit is a contact generator: it needs the snow and the
+* particles which should collide with the snow as its particles. It
+* uses the resting frames of the particles, which the world only counts
+* while sleeping is enabled.
+*/
+class ParticleSnowDeposit : public ParticleContactGenerator
+{
+public:
+	struct Layer
+	{
+		float Bottom;
+		float Top;
+	};
+
+	ParticleSnowDeposit(const float& minX, const float& maxX, const float& columnWidth);
+
+	/**
+	* Snow only bakes while it rests on a support or on the deposit. The
+	* deposit doesn't own its supports.
+	*/
+	void AddSupport(const ParticlePlatformContactsGenerator* support);
+
+	/**
+	* Snow bakes once it rested this many frames, or fell asleep.
+	*/
+	void SetBakeFrames(const int& frames);
+
+	/**
+	* A column may be at most this much higher than its neighbour, more
+	* snow slides down to the neighbour.
+	*/
+	void SetMaxStep(const float& step);
+
+	int AddContact(ParticleContact* contact, const int& limit) override;
+	bool GetSceneryBounds(DirectX::SimpleMath::Vector3& outMin, DirectX::SimpleMath::Vector3& outMax) const override;
+
+	/**
+	* Removes all deposits.
+	*/
+	void Clear();
+
+	float GetMinX() const;
+	float GetColumnWidth() const;
+	int GetColumnCount() const;
+	int GetLayerCount(const int& column) const;
+	const Layer& GetLayer(const int& column, const int& layer) const;
+	int GetBakedParticleCount() const;
+
+	static const int MaxLayers = 4;
+
+private:
+	int columnOf(const float& x) const;
+
+	/**
+	* The columns under a particle, empty if it is outside the deposit.
+	*/
+	void footprint(const float& x, const float& radius, int& outFirst, int& outLast) const;
+	Layer* layers(const int& column);
+	const Layer* layers(const int& column) const;
+
+	bool isSupported(const DirectX::SimpleMath::Vector3& position, const float& radius) const;
+
+	/**
+	* The layer of the column whose top is within tolerance of bottom,
+	* nullptr if there is none.
+	*/
+	Layer* findSurface(const int& column, const float& bottom, const float& tolerance);
+
+	/**
+	* Bakes a resting snow particle into the deposit, returns false if
+	* it has no room for it.
+	*/
+	bool bake(Particle* particle);
+
+	/**
+	* Adds an empty layer to a column, nullptr if the column is full.
+	*/
+	Layer* insertLayer(const int& column, const float& bottom);
+	void mergeLayers(const int& column);
+
+	/**
+	* The highest top of the layers under a particle which it sinks
+	* into, returns false if it doesn't touch the deposit.
+	*/
+	bool findPenetratedTop(const DirectX::SimpleMath::Vector3& position, const float& radius, float& outTop) const;
+
+	float m_minX;
+	float m_columnWidth;
+	int m_columnCount;
+	std::vector<Layer> m_layers;
+	std::vector<int> m_layerCounts;
+	std::vector<const ParticlePlatformContactsGenerator*> m_supports;
+	int m_bakeFrames = 60;
+	float m_maxStep = 4.f;
+	int m_bakedParticles = 0;
+};
@@ -0,0 +1,348 @@
+#include "pch.h"
+#include "ParticleSpatialIndex.h"
+
+using namespace DirectX::SimpleMath;
+
+void ParticleSpatialIndex::Build(const std::vector<Particle*>& particles, const float& cellSize)
+{
+	// The grid covers the spheres of all particles
+	float minX = 0, minY = 0, maxX = 0, maxY = 0;
+	m_maxRadius = 0;
+	for (size_t i = 0; i < particles.size(); i++)
+	{
+		const Vector3 position = particles[i]->GetPosition();
+		minX = i == 0 ? position.x : std::min(minX, position.x);
+		minY = i == 0 ? position.y : std::min(minY, position.y);
+		maxX = i == 0 ? position.x : std::max(maxX, position.x);
+		maxY = i == 0 ? position.y : std::max(maxY, position.y);
+		m_maxRadius = std::max(m_maxRadius, particles[i]->GetWorldSpaceRadius());
+	}
+	minX -= m_maxRadius;
+	minY -= m_maxRadius;
+	maxX += m_maxRadius;
+	maxY += m_maxRadius;
+
+	const float width = std::max(maxX - minX, 1.f);
+	const float height = std::max(maxY - minY, 1.f);
+	m_cellSize = std::max(cellSize, std::sqrt(width * height / MaxCells));
+	m_inverseCellSize = 1.f / m_cellSize;
+	m_origin = Vector2(minX, minY);
+	m_cellsX = std::max(1, static_cast<int>(std::ceil(width * m_inverseCellSize)));
+	m_cellsY = std::max(1, static_cast<int>(std::ceil(height * m_inverseCellSize)));
+	// Rounding may leave a long, thin grid with a few cells too many
+	while (static_cast<long long>(m_cellsX) * m_cellsY > MaxCells)
+	{
+		m_cellsX = std::max(1, m_cellsX / 2);
+		m_cellsY = std::max(1, m_cellsY / 2);
+		m_cellSize *= 2;
+		m_inverseCellSize = 1.f / m_cellSize;
+	}
+	const int cells = m_cellsX * m_cellsY;
+
+	// Counting sort by cell, row by row
+	const int count = static_cast<int>(particles.size());
+	m_cellStart.assign(cells + 1, 0);
+	m_entryCells.resize(count);
+	for (int index = 0; index < count; ++index)
+	{
+		const Vector3 position = particles[index]->GetPosition();
+		const int cell = cellY(position.y) * m_cellsX + cellX(position.x);
+		m_entryCells[index] = cell;
+		++m_cellStart[cell + 1];
+	}
+	for (int cell = 0; cell < cells; ++cell)
+	{
+		m_cellStart[cell + 1] += m_cellStart[cell];
+	}
+
+	m_positions.resize(count);
+	m_radii.resize(count);
+	m_categories.resize(count);
+	m_particles.resize(count);
+	for (int index = 0; index < count; ++index)
+	{
+		Particle* particle = particles[index];
+		// m_cellStart runs one cell behind while it is used to scatter, so
+		// it ends up at the start of every cell
+		const int entry = m_cellStart[m_entryCells[index]]++;
+		m_positions[entry] = particle->GetPosition();
+		m_radii[entry] = particle->GetWorldSpaceRadius();
+		m_categories[entry] = ParticleCollisionFilter::GetCategory(particle->GetType());
+		m_particles[entry] = particle;
+	}
+	for (int cell = cells; cell > 0; --cell)
+	{
+		m_cellStart[cell] = m_cellStart[cell - 1];
+	}
+	m_cellStart[0] = 0;
+
+	m_cellStamps.assign(cells, 0);
+	m_stamp = 0;
+}
+
+int ParticleSpatialIndex::QueryRadius(const DirectX::SimpleMath::Vector3& center, const float& radius, const unsigned& typeMask, std::vector<Particle*>& outParticles) const
+{
+	const size_t before = outParticles.size();
+	const float radiusSquared = radius * radius;
+	const int fromX = cellX(center.x - radius), toX = cellX(center.x + radius);
+	const int fromY = cellY(center.y - radius), toY = cellY(center.y + radius);
+	for (int y = fromY; y <= toY; ++y)
+	{
+		// The cells of a row are next to each other
+		const int end = m_cellStart[y * m_cellsX + toX + 1];
+		for (int entry = m_cellStart[y * m_cellsX + fromX]; entry < end; ++entry)
+		{
+			if ((m_categories[entry] & typeMask) && (m_positions[entry] - center).LengthSquared() <= radiusSquared)
+				outParticles.push_back(m_particles[entry]);
+		}
+	}
+	return static_cast<int>(outParticles.size() - before);
+}
+
+int ParticleSpatialIndex::QueryBox(const DirectX::SimpleMath::Vector3& minimum, const DirectX::SimpleMath::Vector3& maximum, const unsigned& typeMask, std::vector<Particle*>& outParticles) const
+{
+	const size_t before = outParticles.size();
+	const int fromX = cellX(minimum.x), toX = cellX(maximum.x);
+	const int fromY = cellY(minimum.y), toY = cellY(maximum.y);
+	for (int y = fromY; y <= toY; ++y)
+	{
+		const int end = m_cellStart[y * m_cellsX + toX + 1];
+		for (int entry = m_cellStart[y * m_cellsX + fromX]; entry < end; ++entry)
+		{
+			const Vector3& position = m_positions[entry];
+			if ((m_categories[entry] & typeMask) &&
+				position.x >= minimum.x && position.y >= minimum.y && position.z >= minimum.z &&
+				position.x <= maximum.x && position.y <= maximum.y && position.z <= maximum.z)
+				outParticles.push_back(m_particles[entry]);
+		}
+	}
+	return static_cast<int>(outParticles.size() - before);
+}
+
+int ParticleSpatialIndex::QueryNearest(const DirectX::SimpleMath::Vector3& point, const int& count, const unsigned& typeMask, std::vector<Particle*>& outParticles)
+{
+	if (count <= 0)
+		return 0;
+
+	// Max-heap of the closest entries so far, by squared distance
+	m_nearest.clear();
+	const int centerX = cellX(point.x);
+	const int centerY = cellY(point.y);
+	const int rings = std::max(m_cellsX, m_cellsY);
+	for (int ring = 0; ring <= rings; ++ring)
+	{
+		// Every cell of this ring is at least ring - 1 cells away
+		const float reach = (ring - 1) * m_cellSize;
+		if (static_cast<int>(m_nearest.size()) == count && ring > 0 && m_nearest.front().first <= reach * reach)
+			break;
+
+		for (int y = centerY - ring; y <= centerY + ring; ++y)
+		{
+			if (y < 0 || y >= m_cellsY)
+				continue;
+			// Inside the ring only its two end cells belong to it
+			const bool edgeRow = y == centerY - ring || y == centerY + ring;
+			const int step = edgeRow ? 1 : std::max(2 * ring, 1);
+			for (int x = centerX - ring; x <= centerX + ring; x += step)
+			{
+				if (x < 0 || x >= m_cellsX)
+					continue;
+				const int cell = y * m_cellsX + x;
+				for (int entry = m_cellStart[cell]; entry < m_cellStart[cell + 1]; ++entry)
+				{
+					if (!(m_categories[entry] & typeMask))
+						continue;
+					const float distanceSquared = (m_positions[entry] - point).LengthSquared();
+					if (static_cast<int>(m_nearest.size()) < count)
+					{
+						m_nearest.push_back(std::make_pair(distanceSquared, entry));
+						std::push_heap(m_nearest.begin(), m_nearest.end());
+					}
+					else if (distanceSquared < m_nearest.front().first)
+					{
+						std::pop_heap(m_nearest.begin(), m_nearest.end());
+						m_nearest.back() = std::make_pair(distanceSquared, entry);
+						std::push_heap(m_nearest.begin(), m_nearest.end());
+					}
+				}
+			}
+		}
+	}
+
+	std::sort_heap(m_nearest.begin(), m_nearest.end());
+	for (const std::pair<float, int>& nearest : m_nearest)
+	{
+		outParticles.push_back(m_particles[nearest.second]);
+	}
+	return static_cast<int>(m_nearest.size());
+}
+
+ParticleRayHit ParticleSpatialIndex::Raycast(const ParticleRay& ray, const unsigned& typeMask)
+{
+	ParticleRayHit hit;
+	hit.Distance = ray.MaxDistance;
+	walkRay(ray, [&](const int& cell, const float& enter)
+	{
+		// A particle the ray hits is found from the cell the hit is in,
+		// the ones in later cells can't be any closer
+		if (hit.Target && enter > hit.Distance)
+			return false;
+
+		for (int entry = m_cellStart[cell]; entry < m_cellStart[cell + 1]; ++entry)
+		{
+			float distance;
+			if ((m_categories[entry] & typeMask) && hitsParticle(ray, entry, distance) && distance <= hit.Distance)
+			{
+				hit.Target = m_particles[entry];
+				hit.Distance = distance;
+			}
+		}
+		return true;
+	});
+	if (!hit.Target)
+		hit.Distance = 0;
+	return hit;
+}
+
+int ParticleSpatialIndex::RaycastAll(const ParticleRay& ray, const unsigned& typeMask, std::vector<ParticleRayHit>& outHits)
+{
+	const size_t before = outHits.size();
+	walkRay(ray, [&](const int& cell, const float& enter)
+	{
+		for (int entry = m_cellStart[cell]; entry < m_cellStart[cell + 1]; ++entry)
+		{
+			ParticleRayHit hit;
+			if ((m_categories[entry] & typeMask) && hitsParticle(ray, entry, hit.Distance))
+			{
+				hit.Target = m_particles[entry];
+				outHits.push_back(hit);
+			}
+		}
+		return true;
+	});
+	std::sort(outHits.begin() + before, outHits.end(), [](const ParticleRayHit& first, const ParticleRayHit& second)
+	{
+		return first.Distance < second.Distance;
+	});
+	return static_cast<int>(outHits.size() - before);
+}
+
+int ParticleSpatialIndex::GetParticleCount() const
+{
+	return static_cast<int>(m_particles.size());
+}
+
+float ParticleSpatialIndex::GetCellSize() const
+{
+	return m_cellSize;
+}
+
+int ParticleSpatialIndex::cellX(const float& x) const
+{
+	const int cell = static_cast<int>(std::floor((x - m_origin.x) * m_inverseCellSize));
+	return std::min(std::max(cell, 0), m_cellsX - 1);
+}
+
+int ParticleSpatialIndex::cellY(const float& y) const
+{
+	const int cell = static_cast<int>(std::floor((y - m_origin.y) * m_inverseCellSize));
+	return std::min(std::max(cell, 0), m_cellsY - 1);
+}
+
+template<typename Visit>
+void ParticleSpatialIndex::walkRay(const ParticleRay& ray, Visit visit)
+{
+	if (m_particles.empty())
+		return;
+
+	// Clip the ray to the grid
+	const float boundsMax[2] = { m_origin.x + m_cellsX * m_cellSize, m_origin.y + m_cellsY * m_cellSize };
+	const float boundsMin[2] = { m_origin.x, m_origin.y };
+	const float origin[2] = { ray.Origin.x, ray.Origin.y };
+	const float direction[2] = { ray.Direction.x, ray.Direction.y };
+	float start = 0, end = ray.MaxDistance;
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		if (std::abs(direction[axis]) < 1e-8f)
+		{
+			if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+				return;
+			continue;
+		}
+		float nearDistance = (boundsMin[axis] - origin[axis]) / direction[axis];
+		float farDistance = (boundsMax[axis] - origin[axis]) / direction[axis];
+		if (nearDistance > farDistance)
+			std::swap(nearDistance, farDistance);
+		start = std::max(start, nearDistance);
+		end = std::min(end, farDistance);
+	}
+	if (start > end)
+		return;
+
+	// Amanatides and Woo: step into the neighbour cell whose border the
+	// ray crosses first
+	const Vector3 entry = ray.Origin + ray.Direction * start;
+	int cell[2] = { cellX(entry.x), cellY(entry.y) };
+	int step[2];
+	float next[2], delta[2];
+	for (int axis = 0; axis < 2; ++axis)
+	{
+		if (std::abs(direction[axis]) < 1e-8f)
+		{
+			step[axis] = 0;
+			next[axis] = std::numeric_limits<float>::max();
+			delta[axis] = std::numeric_limits<float>::max();
+			continue;
+		}
+		step[axis] = direction[axis] > 0 ? 1 : -1;
+		const float border = boundsMin[axis] + (cell[axis] + (step[axis] > 0 ? 1 : 0)) * m_cellSize;
+		next[axis] = (border - origin[axis]) / direction[axis];
+		delta[axis] = m_cellSize / std::abs(direction[axis]);
+	}
+
+	// A particle can stick out of its cell by its radius
+	const int ring = static_cast<int>(std::ceil(m_maxRadius * m_inverseCellSize));
+	++m_stamp;
+	float enter = start;
+	for (;;)
+	{
+		for (int y = std::max(cell[1] - ring, 0); y <= std::min(cell[1] + ring, m_cellsY - 1); ++y)
+		{
+			for (int x = std::max(cell[0] - ring, 0); x <= std::min(cell[0] + ring, m_cellsX - 1); ++x)
+			{
+				const int visited = y * m_cellsX + x;
+				if (m_cellStamps[visited] == m_stamp)
+					continue;
+				m_cellStamps[visited] = m_stamp;
+				if (!visit(visited, enter))
+					return;
+			}
+		}
+
+		const int axis = next[0] < next[1] ? 0 : 1;
+		enter = next[axis];
+		if (enter > end || step[axis] == 0)
+			return;
+		cell[axis] += step[axis];
+		next[axis] += delta[axis];
+		if (cell[axis] < 0 || cell[axis] >= (axis == 0 ? m_cellsX : m_cellsY))
+			return;
+	}
+}
+
+bool ParticleSpatialIndex::hitsParticle(const ParticleRay& ray, const int& entry, float& outDistance) const
+{
+	const Vector3 offset = ray.Origin - m_positions[entry];
+	const float radius = m_radii[entry];
+	const float along = offset.Dot(ray.Direction);
+	const float outside = offset.LengthSquared() - radius * radius;
+	if (outside > 0 && along > 0)
+		return false;
+
+	const float discriminant = along * along - outside;
+	if (discriminant < 0)
+		return false;
+
+	outDistance = std::max(0.f, -along - std::sqrt(discriminant));
+	return outDistance <= ray.MaxDistance;
+}
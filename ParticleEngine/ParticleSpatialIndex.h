@@ -0,0 +1,105 @@
+#pragma once
+
+struct ParticleRayHit
+{
+	// nullptr if the ray hit nothing
+	Particle* Target = nullptr;
+	// Along the ray to where it enters the particle, zero if it starts
+	// inside
+	float Distance = 0;
+};
+
+struct ParticleRadiusQuery
+{
+	DirectX::SimpleMath::Vector3 Center;
+	float Radius;
+};
+
+struct ParticleBoxQuery
+{
+	DirectX::SimpleMath::Vector3 Minimum;
+	DirectX::SimpleMath::Vector3 Maximum;
+};
+
+struct ParticleRay
+{
+	DirectX::SimpleMath::Vector3 Origin;
+	// Normalized
+	DirectX::SimpleMath::Vector3 Direction;
+	float MaxDistance;
+};
+
+/**
+* Uniform grid over the xy plane around the particles for queries.
+* Building it sorts the particles by their cell in linear time and
+* copies their position, radius and type next to each other, so a query
+* only reads the cells it overlaps.
+*
+* Radius, box and nearest queries look at the position of a particle,
+* rays at its sphere. Every query takes a mask of the categories of the
+* types it wants, see ParticleCollisionFilter::GetCategory, and appends
+* its results to the given vector.
+*/
+class ParticleSpatialIndex
+{
+public:
+	/**
+	* The grid has at most MaxCells cells, its cells grow beyond the
+	* given size if the particles are spread too far for that.
+	*/
+	void Build(const std::vector<Particle*>& particles, const float& cellSize);
+
+	int QueryRadius(const DirectX::SimpleMath::Vector3& center, const float& radius, const unsigned& typeMask, std::vector<Particle*>& outParticles) const;
+	int QueryBox(const DirectX::SimpleMath::Vector3& minimum, const DirectX::SimpleMath::Vector3& maximum, const unsigned& typeMask, std::vector<Particle*>& outParticles) const;
+
+	/**
+	* The count particles closest to the point, the closest first.
+	*/
+	int QueryNearest(const DirectX::SimpleMath::Vector3& point, const int& count, const unsigned& typeMask, std::vector<Particle*>& outParticles);
+
+	/**
+	* RaycastAll sorts its hits by distance.
+	*/
+	ParticleRayHit Raycast(const ParticleRay& ray, const unsigned& typeMask);
+	int RaycastAll(const ParticleRay& ray, const unsigned& typeMask, std::vector<ParticleRayHit>& outHits);
+
+	int GetParticleCount() const;
+	float GetCellSize() const;
+
+	static const int MaxCells = 1 << 20;
+
+private:
+	int cellX(const float& x) const;
+	int cellY(const float& y) const;
+
+	/**
+	* Walks the cells the ray crosses and visits every cell within the
+	* largest radius of them once, in the order the ray reaches them.
+	* Stops when visit returns false for the distance the ray entered
+	* the crossed cell at.
+	*/
+	template<typename Visit>
+	void walkRay(const ParticleRay& ray, Visit visit);
+
+	bool hitsParticle(const ParticleRay& ray, const int& entry, float& outDistance) const;
+
+	float m_cellSize = 1;
+	float m_inverseCellSize = 1;
+	DirectX::SimpleMath::Vector2 m_origin = DirectX::SimpleMath::Vector2::Zero;
+	int m_cellsX = 0;
+	int m_cellsY = 0;
+	float m_maxRadius = 0;
+
+	// The entries of cell c are m_cellStart[c] .. m_cellStart[c + 1]
+	std::vector<int> m_cellStart;
+	std::vector<DirectX::SimpleMath::Vector3> m_positions;
+	std::vector<float> m_radii;
+	std::vector<unsigned> m_categories;
+	std::vector<Particle*> m_particles;
+	std::vector<int> m_entryCells;
+
+	// Cells a ray has visited carry its stamp
+	std::vector<uint32_t> m_cellStamps;
+	uint32_t m_stamp = 0;
+	std::vector<std::pair<float, int>> m_nearest;
+};
@@ -27,6 +27,16 @@ void ParticleSpringForceGenerator::UpdateForce(Particle* particle, const float&
 	particle->AddForce(force);
 }
 
+Particle* ParticleSpringForceGenerator::GetConnectedParticle() const
+{
+	return m_other;
+}
+
+void ParticleSpringForceGenerator::RemapParticles(const ParticleRemap& remap)
+{
+	m_other = remap(m_other);
+}
+
 void ParticleSpringForceGenerator::Initialize(Particle* other, const float& springConstant, const float& restLength)
 {
 	m_other = other;
@@ -85,6 +95,16 @@ void ParticleFakeStiffSpringForceGenerator::Initialize(Particle* other, const fl
 	m_damping = damping;
 }
 
+Particle* ParticleFakeStiffSpringForceGenerator::GetConnectedParticle() const
+{
+	return m_other;
+}
+
+void ParticleFakeStiffSpringForceGenerator::RemapParticles(const ParticleRemap& remap)
+{
+	m_other = remap(m_other);
+}
+
 void ParticleFakeStiffSpringForceGenerator::UpdateForce(Particle* particle, const float& deltaTime)
 {
 	// Check that we do not have infinite mass
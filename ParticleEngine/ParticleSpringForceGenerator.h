@@ -7,6 +7,8 @@ public:
 	ParticleSpringForceGenerator(Particle* other, const float& springConstant, const float& restLength);
 
 	virtual void UpdateForce(Particle* particle, const float& deltaTime) override;
+	Particle* GetConnectedParticle() const override;
+	void RemapParticles(const ParticleRemap& remap) override;
 	void Initialize(Particle* other, const float& springConstant, const float& restLength);
 
 protected:
@@ -39,6 +41,8 @@ public:
 
 	void Initialize(Particle* other, const float& springConstant, const float& damping);
 	void UpdateForce(Particle* particle, const float& deltaTime) override;
+	Particle* GetConnectedParticle() const override;
+	void RemapParticles(const ParticleRemap& remap) override;
 
 protected:
 	Particle* m_other = nullptr;
@@ -3,129 +3,1958 @@
 
 using namespace DirectX::SimpleMath;
 
+// The contact arena starts with this many contacts and grows on demand
+static const int initialContactCapacity = 1024;
+// Initial size of the per-step scratch memory in bytes
+static const size_t frameAllocatorCapacity = 256 * 1024;
+// Measuring the locality needs a sort, so the threshold is only checked
+// every this many frames
+static const int localityCheckInterval = 30;
+
 ParticleWorld::ParticleWorld(const int& maxContactsPerFrame, const int& poolSize, const LevelBounds& levelBounds, const int& contactResolutionIterations)
-: m_contactResolver(contactResolutionIterations), m_maxContacts(maxContactsPerFrame), m_levelBounds(levelBounds)
+: m_contactResolver(contactResolutionIterations), m_frameAllocator(frameAllocatorCapacity), m_contactArena(initialContactCapacity, maxContactsPerFrame), m_levelBounds(levelBounds)
+{
+	m_contactResolver.SetFrameAllocator(&m_frameAllocator);
+	m_shouldCalculateIterations = (contactResolutionIterations == 0);
+	createParticlePool(poolSize);
+}
+
+ParticleWorld::~ParticleWorld()
+{
+	waitForBackgroundRead();
+}
+
+void ParticleWorld::StartFrame()
+{
+	waitForBackgroundRead();
+	m_frameAllocator.Reset();
+	m_spatialIndexValid = false;
+	applyCommands();
+	expireParticles();
+	disableActiveParticleOutOfLevelBounds();
+	releaseInactiveParticles();
+	if (shouldReorderParticles())
+	{
+		ReorderParticles();
+	}
+	for (Particle* particle : m_activeParticles)
+	{
+		particle->ClearForceAccumulator();
+	}
+}
+
+void ParticleWorld::RunPhysics(const float& deltaTime)
+{
+	waitForBackgroundRead();
+
+	// Commands queued since StartFrame, before anything iterates over the
+	// particles
+	applyCommands();
+
+#ifdef PARTICLE_ASSERT_NO_STEP_HEAP_ALLOCATIONS
+	const unsigned long long heapAllocationsBefore = ParticleHeapGuard::GetAllocationCount();
+	const int contactArenaGrowCount = m_contactArena.GetGrowCount();
+#endif
+
+	// First apply the force generators
+	m_registry.UpdateForces(deltaTime);
+
+	// Then integrate the objects
+	integrateAllParticles(deltaTime);
+
+	// Generate contacts, then apply the rules to the touching pairs
+	m_contactEvents.DiscardUntil(m_contactEventsNotified);
+	const uint32_t stepEvents = m_contactEvents.GetWritePosition();
+	int usedContacts = generateContactsWithRegisteredContactGeneratorsAndReturnNumOfContacts();
+	processContactEvents(stepEvents);
+	if (m_lastContactDestroyed || m_pendingReleases)
+		usedContacts = removeContactsOfInactiveParticles(usedContacts);
+
+	// And process them
+	m_lastIsolatedContacts = 0;
+	if (usedContacts)
+	{
+		wakeTouchedParticles(usedContacts);
+
+		int coupledContacts = usedContacts;
+		if (m_isolatedContactFastPath)
+		{
+			coupledContacts = partitionIsolatedContacts(usedContacts);
+			m_lastIsolatedContacts = usedContacts - coupledContacts;
+			m_contactResolver.ResolveIsolatedContacts(m_contactArena.GetContacts() + coupledContacts, m_lastIsolatedContacts, deltaTime);
+		}
+
+		if (m_shouldCalculateIterations)
+		{
+			m_contactResolver.SetIterations(coupledContacts * 2);
+		}
+		m_contactResolver.ResolveContacts(m_contactArena.GetContacts(), coupledContacts, deltaTime);
+	}
+
+	updateSleepingParticles(usedContacts, deltaTime);
+	m_spatialIndexValid = false;
+
+#ifdef PARTICLE_ASSERT_NO_STEP_HEAP_ALLOCATIONS
+	const bool steadyState = isSteadyStateStep(usedContacts, contactArenaGrowCount);
+	assert((!steadyState || ParticleHeapGuard::GetAllocationCount() == heapAllocationsBefore) && "a steady-state physics step allocated on the heap");
+#endif
+}
+
+void ParticleWorld::integrateAllParticles(const float& deltaTime)
+{
+	const float time = m_time + deltaTime;
+	ParticleFrameVector<SceneryBox> scenery(&m_frameAllocator);
+	bool sceneryGathered = false;
+	m_lastLodDeferred = 0;
+	m_lastBallistic = 0;
+
+	++m_lodStep;
+	for (Particle* particle : m_activeParticles)
+	{
+		const bool fieldChanged = (m_changedFieldTypes & ParticleCollisionFilter::GetCategory(particle->GetType())) != 0;
+		if (fieldChanged)
+			particle->SetAwake(true);
+		// Released particles wait here for the next sweep
+		if (!particle->IsAwake() || !particle->IsActive())
+			continue;
+
+		if (particle->IsBallistic())
+		{
+			// The flight was launched under the old fields
+			if (fieldChanged)
+				particle->Launch(m_time, m_uniformFieldAcceleration[static_cast<int>(particle->GetType())]);
+			if (time > particle->GetFlightClearUntil())
+			{
+				if (!sceneryGathered)
+				{
+					gatherSceneryBounds(scenery);
+					sceneryGathered = true;
+				}
+				if (!clearFlight(particle, m_time, std::max(time, m_time + m_ballisticHorizon), scenery))
+					particle->EndFlight();
+			}
+			if (particle->IsBallistic())
+			{
+				particle->EvaluateFlight(time);
+				++m_lastBallistic;
+				continue;
+			}
+		}
+
+		if (!m_lodEnabled)
+		{
+			particle->Integrate(deltaTime + particle->TakeDeferredTime(), fieldAccelerationOf(particle));
+			continue;
+		}
+
+		const int interval = lodIntervalOf(particle);
+		particle->SetLodInterval(interval);
+		if (((m_lodStep + particle->GetLodStagger()) & (interval - 1)) == 0)
+		{
+			particle->Integrate(deltaTime + particle->TakeDeferredTime(), fieldAccelerationOf(particle));
+		}
+		else
+		{
+			particle->DeferIntegration(deltaTime);
+			++m_lastLodDeferred;
+		}
+	}
+	m_time = time;
+	m_changedFieldTypes = 0;
+}
+
+DirectX::SimpleMath::Vector3 ParticleWorld::fieldAccelerationOf(const Particle* particle) const
+{
+	Vector3 acceleration = m_uniformFieldAcceleration[static_cast<int>(particle->GetType())];
+	if (m_spatialForceFields == 0)
+		return acceleration;
+
+	const Vector3 position = particle->GetPosition();
+	for (const ParticleForceField& field : m_forceFields)
+	{
+		if (field.Enabled && field.Shape != ParticleForceFieldShape::Uniform && field.Affects(particle->GetType()))
+			acceleration += field.AccelerationAt(position);
+	}
+	return acceleration;
+}
+
+void ParticleWorld::gatherSceneryBounds(ParticleFrameVector<SceneryBox>& outBoxes) const
+{
+	outBoxes.clear();
+	SceneryBox box;
+	for (const ParticleContactGenerator* contactGenerator : m_contactGenerators)
+	{
+		if (contactGenerator->GetSceneryBounds(box.first, box.second))
+			outBoxes.push_back(box);
+	}
+	// A flight can't follow the acceleration of a field which changes
+	// along the way
+	for (const ParticleForceField& field : m_forceFields)
+	{
+		if (field.Enabled && field.GetBounds(box.first, box.second))
+			outBoxes.push_back(box);
+	}
+}
+
+bool ParticleWorld::clearFlight(Particle* particle, const float& from, const float& to, const ParticleFrameVector<SceneryBox>& scenery) const
+{
+	Vector3 minimum, maximum;
+	particle->GetFlightBounds(from, to, minimum, maximum);
+	for (const SceneryBox& box : scenery)
+	{
+		if (minimum.x <= box.second.x && maximum.x >= box.first.x &&
+			minimum.y <= box.second.y && maximum.y >= box.first.y &&
+			minimum.z <= box.second.z && maximum.z >= box.first.z)
+			return false;
+	}
+	particle->SetFlightClearUntil(to);
+	return true;
+}
+
+int ParticleWorld::lodIntervalOf(const Particle* particle) const
+{
+	if (!m_lodTypes[static_cast<int>(particle->GetType())])
+		return 1;
+
+	const Vector3 position = particle->GetPosition();
+	const float dx = std::max(std::max(m_lodView.MinX - position.x, position.x - m_lodView.MaxX), 0.f);
+	const float dy = std::max(std::max(m_lodView.MinY - position.y, position.y - m_lodView.MaxY), 0.f);
+	const float band = std::sqrt(dx * dx + dy * dy) / m_lodBandWidth;
+
+	int interval = 1;
+	for (int level = 1; band >= level && interval < m_lodMaxInterval; ++level)
+	{
+		interval *= 2;
+	}
+	return interval;
+}
+
+int ParticleWorld::generateContactsWithRegisteredContactGeneratorsAndReturnNumOfContacts()
+{
+	// Contacts change little from one step to the next, so the arena
+	// grows ahead to the load of the last step and the generators rarely
+	// have to run again as it grows
+	const int expectedContacts = m_contactArena.GetUsed() + m_contactArena.GetUsed() / 4;
+	m_contactArena.Reset();
+	while (m_contactArena.GetCapacity() < expectedContacts && m_contactArena.Grow())
+	{
+	}
+	m_contactGeneratorReports.resize(m_contactGenerators.size());
+
+	for (size_t index = 0; index < m_contactGenerators.size(); ++index)
+	{
+		ParticleContactGenerator* contactGenerator = m_contactGenerators[index];
+		ParticleContactGeneratorReport& report = m_contactGeneratorReports[index];
+
+		int used = 0;
+		int freeContacts = m_contactArena.GetFreeCapacity();
+		report.Regenerations = 0;
+		const uint32_t events = m_contactEvents.GetWritePosition();
+		for (;;)
+		{
+			// A generator which runs again pushes its events again
+			m_contactEvents.Rewind(events);
+			if (freeContacts > 0)
+				used = contactGenerator->AddContact(m_contactArena.GetFreeContacts(), freeContacts);
+
+			// A generator which fills all of the free contacts may have had
+			// more, so grow the arena and let it run again
+			if (used < freeContacts || !m_contactArena.Grow())
+				break;
+
+			++report.Regenerations;
+			contactGenerator->DiscardLastRun();
+			freeContacts = m_contactArena.GetFreeCapacity();
+		}
+		m_contactArena.Commit(used);
+
+		report.Contacts = used;
+		bool truncated = used >= freeContacts;
+		if (truncated && !report.Truncated)
+		{
+			reportTruncatedContactGenerator(index);
+		}
+		report.Truncated = truncated;
+		report.TruncatedSteps += truncated ? 1 : 0;
+	}
+
+	// Return the number of contacts used.
+	return m_contactArena.GetUsed();
+}
+
+void ParticleWorld::processContactEvents(const uint32_t& stepBegin)
+{
+	typedef std::pair<Particle*, Particle*> TouchingPair;
+
+	// The touches of this step sorted by their pair, a pair may have been
+	// pushed more than once
+	const uint32_t stepEnd = m_contactEvents.End();
+	ParticleFrameVector<std::pair<TouchingPair, uint32_t>> touches(&m_frameAllocator);
+	touches.reserve(stepEnd - stepBegin);
+	for (uint32_t position = stepBegin; position != stepEnd; ++position)
+	{
+		touches.push_back(std::make_pair(touchingPairOf(m_contactEvents.At(position)), position));
+	}
+	std::sort(touches.begin(), touches.end());
+
+	// Both lists are sorted, so one walk over them tells the new pairs,
+	// the persisting ones and the ended ones apart
+	ParticleFrameVector<TouchingPair> touching(&m_frameAllocator);
+	touching.reserve(touches.size() + m_touchingPairs.size());
+	size_t previous = 0;
+	for (size_t index = 0; index < touches.size(); ++index)
+	{
+		const TouchingPair& pair = touches[index].first;
+		for (; previous < m_touchingPairs.size() && m_touchingPairs[previous] < pair; ++previous)
+		{
+			const TouchingPair& ended = m_touchingPairs[previous];
+			if (keepsTouching(ended))
+				touching.push_back(ended);
+			else
+				m_contactEvents.Push(ParticleContactEvent{ ended.first, ended.second, Vector3::Zero, 0.f, ParticleContactEventKind::End });
+		}
+		const bool persists = previous < m_touchingPairs.size() && m_touchingPairs[previous] == pair;
+		m_contactEvents.At(touches[index].second).Kind = persists ? ParticleContactEventKind::Persist : ParticleContactEventKind::Begin;
+		if (touching.empty() || touching.back() != pair)
+			touching.push_back(pair);
+
+		// The previous pair is done with once the last of its touches is
+		const bool lastTouch = index + 1 == touches.size() || touches[index + 1].first != pair;
+		if (persists && lastTouch)
+			++previous;
+	}
+	for (; previous < m_touchingPairs.size(); ++previous)
+	{
+		const TouchingPair& ended = m_touchingPairs[previous];
+		if (keepsTouching(ended))
+			touching.push_back(ended);
+		else
+			m_contactEvents.Push(ParticleContactEvent{ ended.first, ended.second, Vector3::Zero, 0.f, ParticleContactEventKind::End });
+	}
+	for (size_t index = 1; index < touches.size(); ++index)
+	{
+		// A pair which persists also counts as persisting for its further
+		// events in the same step
+		if (touches[index].first == touches[index - 1].first)
+			m_contactEvents.At(touches[index].second).Kind = ParticleContactEventKind::Persist;
+	}
+	// The pairs which keep touching were carried over out of order
+	std::sort(touching.begin(), touching.end());
+	m_touchingPairs.assign(touching.begin(), touching.end());
+
+	m_lastContactDestroyed = 0;
+	for (uint32_t position = stepBegin; position != stepEnd; ++position)
+	{
+		ParticleContactEvent& event = m_contactEvents.At(position);
+		Particle* particle = event.First;
+		Particle* other = event.Second;
+
+		const float totalInverseMass = particle->GetInverseMass() + other->GetInverseMass();
+		const float separatingVelocity = (particle->GetVelocity() - other->GetVelocity()).Dot(event.Normal);
+		const float restitution = particle->GetBouncinessFactor() + other->GetBouncinessFactor();
+		event.Impulse = separatingVelocity < 0 && totalInverseMass > 0 ? -(1 + restitution) * separatingVelocity / totalInverseMass : 0.f;
+
+		switch (ParticleCollisionFilter::GetInteraction(particle->GetType(), other->GetType()))
+		{
+		case ParticleInteraction::DestroyFirst:
+			m_lastContactDestroyed += particle->IsActive() ? 1 : 0;
+			particle->SetActive(false);
+			break;
+		case ParticleInteraction::DestroySecond:
+			m_lastContactDestroyed += other->IsActive() ? 1 : 0;
+			other->SetActive(false);
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Reported when the stream starts to overflow, as the arena is
+	const int dropped = m_contactEvents.GetDroppedCount();
+	if (dropped && !m_lastDroppedContactEvents)
+		reportDroppedContactEvents(dropped);
+	m_lastDroppedContactEvents = dropped;
+
+	for (ParticleContactEventListener* listener : m_contactEventListeners)
+	{
+		listener->OnContactEvents(m_contactEvents);
+	}
+	// The dropped events were never readable, the next ones start behind
+	// them
+	m_contactEventsNotified = m_contactEvents.GetWritePosition();
+}
+
+void ParticleWorld::endTouchingPairsOfInactiveParticles()
+{
+	size_t kept = 0;
+	for (const std::pair<Particle*, Particle*>& pair : m_touchingPairs)
+	{
+		if (pair.first->IsActive() && pair.second->IsActive())
+			m_touchingPairs[kept++] = pair;
+		else
+			m_contactEvents.Push(ParticleContactEvent{ pair.first, pair.second, Vector3::Zero, 0.f, ParticleContactEventKind::End });
+	}
+	m_touchingPairs.resize(kept);
+}
+
+bool ParticleWorld::keepsTouching(const std::pair<Particle*, Particle*>& pair) const
+{
+	if (!pair.first->IsActive() || !pair.second->IsActive())
+		return false;
+	if (!pair.first->IsAwake() && !pair.second->IsAwake())
+		return true;
+
+	const float reach = pair.first->GetWorldSpaceRadius() + pair.second->GetWorldSpaceRadius() + m_contactEventSlop;
+	return (pair.first->GetPosition() - pair.second->GetPosition()).LengthSquared() < reach * reach;
+}
+
+std::pair<Particle*, Particle*> ParticleWorld::touchingPairOf(const ParticleContactEvent& event)
+{
+	return event.First < event.Second ? std::make_pair(event.First, event.Second) : std::make_pair(event.Second, event.First);
+}
+
+void ParticleWorld::reportTruncatedContactGenerator(const size_t& generatorIndex)
+{
+	char message[256];
+	sprintf_s(message, "ParticleWorld: contact generator %u lost contacts, the contact arena is full (%d contacts)\n",
+		static_cast<unsigned>(generatorIndex), m_contactArena.GetMaxCapacity());
+	OutputDebugStringA(message);
+}
+
+void ParticleWorld::reportDroppedContactEvents(const int& dropped)
+{
+	char message[256];
+	sprintf_s(message, "ParticleWorld: %d contact events were dropped, the contact event stream is full (%d events)\n",
+		dropped, m_contactEvents.GetCapacity());
+	OutputDebugStringA(message);
+}
+
+int ParticleWorld::removeContactsOfInactiveParticles(const int& usedContacts)
+{
+	ParticleContact* contacts = m_contactArena.GetContacts();
+	int kept = 0;
+	for (int index = 0; index < usedContacts; ++index)
+	{
+		const ParticleContact& contact = contacts[index];
+		const bool destroyed = std::any_of(std::begin(contact.ContactParticles), std::end(contact.ContactParticles),
+			[](const Particle* particle) { return particle && !particle->IsActive(); });
+		if (destroyed)
+			continue;
+		if (kept != index)
+			contacts[kept] = contact;
+		++kept;
+	}
+	m_contactArena.Truncate(kept);
+	return kept;
+}
+
+int ParticleWorld::partitionIsolatedContacts(const int& usedContacts)
+{
+	ParticleContact* contacts = m_contactArena.GetContacts();
+	ParticleFrameStdAllocator<int> scratch(&m_frameAllocator);
+
+	// The particles of the world live in the storage, so their index
+	// there counts their contacts. A contact with a particle from
+	// anywhere else counts as coupled
+	ParticleFrameVector<int> contactCounts(m_particleStorage.size(), 0, scratch);
+	for (int index = 0; index < usedContacts; ++index)
+	{
+		for (Particle* particle : contacts[index].ContactParticles)
+		{
+			const int storageIndex = storageIndexOf(particle);
+			if (storageIndex >= 0)
+				++contactCounts[storageIndex];
+		}
+	}
+
+	ParticleFrameVector<ParticleContact> isolated(scratch);
+	int coupled = 0;
+	for (int index = 0; index < usedContacts; ++index)
+	{
+		const ParticleContact& contact = contacts[index];
+		const int storageIndex = storageIndexOf(contact.ContactParticles[0]);
+		if (!contact.ContactParticles[1] && storageIndex >= 0 && contactCounts[storageIndex] == 1)
+		{
+			isolated.push_back(contact);
+			continue;
+		}
+		if (coupled != index)
+			contacts[coupled] = contact;
+		++coupled;
+	}
+	std::copy(isolated.begin(), isolated.end(), contacts + coupled);
+	return coupled;
+}
+
+void ParticleWorld::wakeTouchedParticles(const int& usedContacts)
+{
+	if (!m_sleepEnabled)
+		return;
+
+	// The generators only write contacts with at least one awake
+	// particle. Contacts between resting particles come and go from one
+	// step to the next, so a sleeping particle touched by a resting one
+	// keeps its resting frames and the two can fall asleep together
+	// instead of waking each other up again
+	ParticleContact* contacts = m_contactArena.GetContacts();
+	for (int index = 0; index < usedContacts; ++index)
+	{
+		Particle* particle = contacts[index].ContactParticles[0];
+		Particle* other = contacts[index].ContactParticles[1];
+		if (!other)
+			continue;
+
+		if (!particle->IsAwake())
+			particle->SetAwake(true, other->GetRestingFrames() > 1);
+		else if (!other->IsAwake())
+			other->SetAwake(true, particle->GetRestingFrames() > 1);
+	}
+}
+
+static int findIsland(ParticleFrameVector<int>& parents, int index)
+{
+	while (parents[index] != index)
+	{
+		parents[index] = parents[parents[index]];
+		index = parents[index];
+	}
+	return index;
+}
+
+void ParticleWorld::updateSleepingParticles(const int& usedContacts, const float& deltaTime)
+{
+	if (!m_sleepEnabled)
+		return;
+
+	const float maxDrift = m_sleepSpeed * deltaTime * m_sleepFrames;
+	ParticleFrameStdAllocator<int> scratch(&m_frameAllocator);
+
+	// The island of every awake particle by its storage index, -1 for
+	// the others
+	ParticleFrameVector<int> islands(m_particleStorage.size(), -1, scratch);
+	ParticleFrameVector<int> parents(scratch);
+	ParticleFrameVector<Particle*> members(scratch);
+	parents.reserve(m_activeParticles.size());
+	members.reserve(m_activeParticles.size());
+	for (Particle* particle : m_activeParticles)
+	{
+		// Ballistic particles are flying
+		if (!particle->IsAwake() || particle->IsBallistic())
+			continue;
+
+		particle->UpdateRestingFrames(maxDrift);
+		islands[storageIndexOf(particle)] = static_cast<int>(parents.size());
+		parents.push_back(static_cast<int>(parents.size()));
+		members.push_back(particle);
+	}
+
+	auto join = [this, &islands, &parents](Particle* one, Particle* two)
+	{
+		const int firstIndex = storageIndexOf(one);
+		const int secondIndex = storageIndexOf(two);
+		if (firstIndex < 0 || secondIndex < 0 || islands[firstIndex] < 0 || islands[secondIndex] < 0)
+			return;
+		parents[findIsland(parents, islands[firstIndex])] = findIsland(parents, islands[secondIndex]);
+	};
+
+	ParticleContact* contacts = m_contactArena.GetContacts();
+	for (int index = 0; index < usedContacts; ++index)
+	{
+		if (contacts[index].ContactParticles[1])
+			join(contacts[index].ContactParticles[0], contacts[index].ContactParticles[1]);
+	}
+
+	// A sleeping particle connected to an awake one is woken by the
+	// registry, so connected particles have to sleep as one island
+	ParticleFrameVector<std::pair<Particle*, Particle*>> connections(scratch);
+	m_registry.GetConnections(connections);
+	for (const std::pair<Particle*, Particle*>& connection : connections)
+	{
+		join(connection.first, connection.second);
+	}
+
+	// An island sleeps once its most restless particle has been resting
+	// long enough
+	ParticleFrameVector<int> islandRestingFrames(parents.size(), std::numeric_limits<int>::max(), scratch);
+	for (size_t member = 0; member < members.size(); ++member)
+	{
+		int& restingFrames = islandRestingFrames[findIsland(parents, static_cast<int>(member))];
+		restingFrames = std::min(restingFrames, members[member]->GetRestingFrames());
+	}
+	for (size_t member = 0; member < members.size(); ++member)
+	{
+		if (islandRestingFrames[findIsland(parents, static_cast<int>(member))] >= m_sleepFrames)
+			members[member]->SetAwake(false);
+	}
+}
+
+int ParticleWorld::storageIndexOf(const Particle* particle) const
+{
+	// Compared as addresses, the difference of pointers into different
+	// arrays is undefined
+	const uintptr_t offset = reinterpret_cast<uintptr_t>(particle) - reinterpret_cast<uintptr_t>(m_particleStorage.data());
+	return particle && offset < m_particleStorage.size() * sizeof(Particle) ? static_cast<int>(offset / sizeof(Particle)) : -1;
+}
+
+std::vector<Particle*>& ParticleWorld::GetActiveParticles()
+{
+	return m_activeParticles;
+}
+
+const std::vector<ParticleContactGenerator*>& ParticleWorld::GetContactGenerators() const
+{
+	return m_contactGenerators;
+}
+
+void ParticleWorld::AddContactGenerator(ParticleContactGenerator* contactGenerator)
+{
+	contactGenerator->SetFrameAllocator(&m_frameAllocator);
+	contactGenerator->SetContactEvents(&m_contactEvents);
+	// The lowest free bit
+	const uint32_t tag = m_freeTags & (~m_freeTags + 1);
+	m_freeTags &= ~tag;
+	contactGenerator->SetTag(tag);
+	m_contactGenerators.push_back(contactGenerator);
+}
+
+void ParticleWorld::RemoveContactGenerator(ParticleContactGenerator* contactGenerator)
+{
+	std::vector<ParticleContactGenerator*>::iterator it = std::find(m_contactGenerators.begin(), m_contactGenerators.end(), contactGenerator);
+	if (it == m_contactGenerators.end())
+		return;
+
+	const size_t index = it - m_contactGenerators.begin();
+	if (index < m_contactGeneratorReports.size())
+		m_contactGeneratorReports.erase(m_contactGeneratorReports.begin() + index);
+	m_contactGenerators.erase(it);
+
+	// Taking the tag away clears it from all the particles of the list
+	m_freeTags |= contactGenerator->GetTag();
+	contactGenerator->SetTag(0);
+}
+
+ParticleFrameAllocator& ParticleWorld::GetFrameAllocator()
+{
+	return m_frameAllocator;
+}
+
+ParticleForceRegistry& ParticleWorld::GetForceRegistry()
+{
+	return m_registry;
+}
+
+const ParticleContactArena& ParticleWorld::GetContactArena() const
+{
+	return m_contactArena;
+}
+
+const std::vector<ParticleContactGeneratorReport>& ParticleWorld::GetContactGeneratorReports() const
+{
+	return m_contactGeneratorReports;
+}
+
+void ParticleWorld::SetContactResolverMode(const ParticleContactResolverMode& mode, const unsigned& batchSweeps)
+{
+	m_contactResolver.SetMode(mode);
+	m_contactResolver.SetBatchSweeps(batchSweeps);
+}
+
+ParticleContactResolverMode ParticleWorld::GetContactResolverMode() const
+{
+	return m_contactResolver.GetMode();
+}
+
+void ParticleWorld::SetContactResolutionTolerance(const float& penetration, const float& closingVelocity)
+{
+	m_contactResolver.SetConvergenceTolerance(penetration, closingVelocity);
+}
+
+void ParticleWorld::SetContactResolutionBudget(const float& seconds)
+{
+	m_contactResolver.SetTimeBudget(seconds);
+}
+
+ParticleContactResolverStopReason ParticleWorld::GetLastContactResolutionStopReason() const
+{
+	return m_contactResolver.GetLastStopReason();
+}
+
+unsigned ParticleWorld::GetLastContactResolutionIterations() const
+{
+	return m_contactResolver.GetIterationsUsed();
+}
+
+void ParticleWorld::SetIsolatedContactFastPathEnabled(const bool& enabled)
+{
+	m_isolatedContactFastPath = enabled;
+}
+
+int ParticleWorld::GetLastIsolatedContactCount() const
+{
+	return m_lastIsolatedContacts;
+}
+
+void ParticleWorld::SetSleepEnabled(const bool& enabled)
+{
+	m_sleepEnabled = enabled;
+	if (!enabled)
+		WakeAllParticles();
+}
+
+void ParticleWorld::SetSleepThreshold(const float& sleepSpeed, const int& sleepFrames)
+{
+	m_sleepSpeed = sleepSpeed;
+	m_sleepFrames = sleepFrames;
+}
+
+void ParticleWorld::WakeAllParticles()
+{
+	for (Particle* particle : m_activeParticles)
+	{
+		particle->SetAwake(true);
+	}
+}
+
+int ParticleWorld::GetSleepingParticleCount() const
+{
+	int sleeping = 0;
+	for (Particle* particle : m_activeParticles)
+	{
+		sleeping += particle->IsAwake() ? 0 : 1;
+	}
+	return sleeping;
+}
+
+void ParticleWorld::SetLodEnabled(const bool& enabled)
+{
+	m_lodEnabled = enabled;
+	if (enabled)
+		return;
+
+	// The deferred time is integrated in the next step
+	for (Particle* particle : m_activeParticles)
+	{
+		particle->SetLodInterval(1);
+	}
+}
+
+void ParticleWorld::SetLodView(const LevelBounds& view)
+{
+	m_lodView = view;
+}
+
+void ParticleWorld::SetLodBands(const float& bandWidth, const int& maxInterval)
+{
+	assert(bandWidth > 0 && maxInterval > 0 && (maxInterval & (maxInterval - 1)) == 0 && "the max interval has to be a power of two");
+	m_lodBandWidth = bandWidth;
+	m_lodMaxInterval = maxInterval;
+}
+
+void ParticleWorld::SetLodTypeEnabled(const ParticleTypes& type, const bool& enabled)
+{
+	m_lodTypes[static_cast<int>(type)] = enabled;
+}
+
+int ParticleWorld::GetLastLodDeferredCount() const
+{
+	return m_lastLodDeferred;
+}
+
+bool ParticleWorld::LaunchBallistic(Particle* particle)
+{
+	return LaunchBallistic(&particle, 1) == 1;
+}
+
+int ParticleWorld::LaunchBallistic(Particle* const* particles, const int& count)
+{
+	ParticleFrameVector<SceneryBox> scenery(&m_frameAllocator);
+	gatherSceneryBounds(scenery);
+
+	int launched = 0;
+	for (int index = 0; index < count; ++index)
+	{
+		Particle* particle = particles[index];
+		particle->Launch(m_time, m_uniformFieldAcceleration[static_cast<int>(particle->GetType())]);
+		if (clearFlight(particle, m_time, m_time + m_ballisticHorizon, scenery))
+			++launched;
+		else
+			particle->EndFlight();
+	}
+	return launched;
+}
+
+void ParticleWorld::SetBallisticHorizon(const float& seconds)
+{
+	m_ballisticHorizon = seconds;
+}
+
+int ParticleWorld::GetLastBallisticCount() const
+{
+	return m_lastBallistic;
+}
+
+int ParticleWorld::AddForceField(const ParticleForceField& field)
+{
+	m_forceFields.push_back(ParticleForceField());
+	const int handle = static_cast<int>(m_forceFields.size()) - 1;
+	SetForceField(handle, field);
+	return handle;
+}
+
+void ParticleWorld::SetForceField(const int& handle, const ParticleForceField& field)
+{
+	replaceForceField(handle, field);
+	updateUniformFieldAcceleration();
+}
+
+void ParticleWorld::SetForceFieldEnabled(const int& handle, const bool& enabled)
+{
+	if (m_forceFields[handle].Enabled == enabled)
+		return;
+	ParticleForceField field = m_forceFields[handle];
+	field.Enabled = enabled;
+	SetForceField(handle, field);
+}
+
+const ParticleForceField& ParticleWorld::GetForceField(const int& handle) const
+{
+	return m_forceFields[handle];
+}
+
+DirectX::SimpleMath::Vector3 ParticleWorld::GetUniformFieldAcceleration(const ParticleTypes& type) const
+{
+	return m_uniformFieldAcceleration[static_cast<int>(type)];
+}
+
+void ParticleWorld::replaceForceField(const int& handle, const ParticleForceField& field)
+{
+	ParticleForceField& current = m_forceFields[handle];
+	if (current.Enabled)
+		m_changedFieldTypes |= current.TypeMask;
+	if (field.Enabled)
+		m_changedFieldTypes |= field.TypeMask;
+	current = field;
+}
+
+void ParticleWorld::updateUniformFieldAcceleration()
+{
+	for (Vector3& acceleration : m_uniformFieldAcceleration)
+	{
+		acceleration = Vector3::Zero;
+	}
+	m_spatialForceFields = 0;
+	for (const ParticleForceField& field : m_forceFields)
+	{
+		if (!field.Enabled)
+			continue;
+		if (field.Shape != ParticleForceFieldShape::Uniform)
+		{
+			++m_spatialForceFields;
+			continue;
+		}
+		for (int type = 0; type < ParticleTypeCount; ++type)
+		{
+			if (field.Affects(static_cast<ParticleTypes>(type)))
+				m_uniformFieldAcceleration[type] += field.Acceleration;
+		}
+	}
+}
+
+int ParticleWorld::QueryRadius(const DirectX::SimpleMath::Vector3& center, const float& radius, std::vector<Particle*>& outParticles, const unsigned& typeMask)
+{
+	return spatialIndex().QueryRadius(center, radius, typeMask, outParticles);
+}
+
+int ParticleWorld::QueryBox(const DirectX::SimpleMath::Vector3& minimum, const DirectX::SimpleMath::Vector3& maximum, std::vector<Particle*>& outParticles, const unsigned& typeMask)
+{
+	return spatialIndex().QueryBox(minimum, maximum, typeMask, outParticles);
+}
+
+int ParticleWorld::QueryNearest(const DirectX::SimpleMath::Vector3& point, const int& count, std::vector<Particle*>& outParticles, const unsigned& typeMask)
+{
+	return spatialIndex().QueryNearest(point, count, typeMask, outParticles);
+}
+
+ParticleRayHit ParticleWorld::Raycast(const ParticleRay& ray, const unsigned& typeMask)
+{
+	return spatialIndex().Raycast(ray, typeMask);
+}
+
+int ParticleWorld::RaycastAll(const ParticleRay& ray, std::vector<ParticleRayHit>& outHits, const unsigned& typeMask)
+{
+	return spatialIndex().RaycastAll(ray, typeMask, outHits);
+}
+
+void ParticleWorld::QueryRadius(const ParticleRadiusQuery* queries, const int& queryCount, std::vector<Particle*>& outParticles, std::vector<int>& outOffsets, const unsigned& typeMask)
+{
+	ParticleSpatialIndex& index = spatialIndex();
+	outParticles.clear();
+	outOffsets.resize(queryCount + 1);
+	for (int query = 0; query < queryCount; ++query)
+	{
+		outOffsets[query] = static_cast<int>(outParticles.size());
+		index.QueryRadius(queries[query].Center, queries[query].Radius, typeMask, outParticles);
+	}
+	outOffsets[queryCount] = static_cast<int>(outParticles.size());
+}
+
+void ParticleWorld::QueryBox(const ParticleBoxQuery* queries, const int& queryCount, std::vector<Particle*>& outParticles, std::vector<int>& outOffsets, const unsigned& typeMask)
+{
+	ParticleSpatialIndex& index = spatialIndex();
+	outParticles.clear();
+	outOffsets.resize(queryCount + 1);
+	for (int query = 0; query < queryCount; ++query)
+	{
+		outOffsets[query] = static_cast<int>(outParticles.size());
+		index.QueryBox(queries[query].Minimum, queries[query].Maximum, typeMask, outParticles);
+	}
+	outOffsets[queryCount] = static_cast<int>(outParticles.size());
+}
+
+void ParticleWorld::QueryNearest(const DirectX::SimpleMath::Vector3* points, const int& queryCount, const int& count, std::vector<Particle*>& outParticles, std::vector<int>& outOffsets, const unsigned& typeMask)
+{
+	ParticleSpatialIndex& index = spatialIndex();
+	outParticles.clear();
+	outOffsets.resize(queryCount + 1);
+	for (int query = 0; query < queryCount; ++query)
+	{
+		outOffsets[query] = static_cast<int>(outParticles.size());
+		index.QueryNearest(points[query], count, typeMask, outParticles);
+	}
+	outOffsets[queryCount] = static_cast<int>(outParticles.size());
+}
+
+void ParticleWorld::Raycast(const ParticleRay* rays, const int& queryCount, std::vector<ParticleRayHit>& outHits, const unsigned& typeMask)
+{
+	ParticleSpatialIndex& index = spatialIndex();
+	outHits.resize(queryCount);
+	for (int query = 0; query < queryCount; ++query)
+	{
+		outHits[query] = index.Raycast(rays[query], typeMask);
+	}
+}
+
+void ParticleWorld::RaycastAll(const ParticleRay* rays, const int& queryCount, std::vector<ParticleRayHit>& outHits, std::vector<int>& outOffsets, const unsigned& typeMask)
+{
+	ParticleSpatialIndex& index = spatialIndex();
+	outHits.clear();
+	outOffsets.resize(queryCount + 1);
+	for (int query = 0; query < queryCount; ++query)
+	{
+		outOffsets[query] = static_cast<int>(outHits.size());
+		index.RaycastAll(rays[query], typeMask, outHits);
+	}
+	outOffsets[queryCount] = static_cast<int>(outHits.size());
+}
+
+void ParticleWorld::SetSpatialIndexCellSize(const float& cellSize)
+{
+	m_spatialIndexCellSize = cellSize;
+	m_spatialIndexValid = false;
+}
+
+ParticleSpatialIndex& ParticleWorld::spatialIndex()
+{
+	if (!m_spatialIndexValid)
+	{
+		m_spatialIndex.Build(m_activeParticles, m_spatialIndexCellSize);
+		m_spatialIndexValid = true;
+	}
+	return m_spatialIndex;
+}
+
+void ParticleWorld::SaveSnapshot(std::vector<uint8_t>& outSnapshot) const
+{
+	static_assert(std::is_trivially_copyable<Particle>::value, "snapshots copy the particle storage as it is");
+
+	const Particle* storage = m_particleStorage.data();
+	const size_t storageSize = m_particleStorage.size();
+	auto indexOf = [storage, storageSize](const Particle* particle)
+	{
+		const uintptr_t offset = reinterpret_cast<uintptr_t>(particle) - reinterpret_cast<uintptr_t>(storage);
+		return particle && offset < storageSize * sizeof(Particle) ? static_cast<int32_t>(particle - storage) : -1;
+	};
+
+	auto isActive = [](const Particle* particle) { return particle->IsActive(); };
+	auto isStopped = [](const Particle* particle) { return !particle->IsActive(); };
+
+	// The particles which stopped since the last sweep are saved as the
+	// sweep will leave them
+	const std::vector<ParticleForceGenerator*>& forceGenerators = m_registry.GetForceGenerators();
+	const std::vector<ParticleForceRegistry::ParticleForceRegistration>& registrations = m_registry.GetRegistrations();
+	const size_t stoppedCount = std::count_if(m_activeParticles.begin(), m_activeParticles.end(), isStopped);
+	const size_t registrationCount = std::count_if(registrations.begin(), registrations.end(),
+		[](const ParticleForceRegistry::ParticleForceRegistration& registration) { return registration.Particle->IsActive(); });
+	const size_t touchingPairCount = std::count_if(m_touchingPairs.begin(), m_touchingPairs.end(),
+		[](const std::pair<Particle*, Particle*>& pair) { return pair.first->IsActive() && pair.second->IsActive(); });
+	size_t memberCount = 0;
+	for (ParticleContactGenerator* contactGenerator : m_contactGenerators)
+	{
+		memberCount += std::count_if(contactGenerator->GetParticles().begin(), contactGenerator->GetParticles().end(), isActive);
+	}
+
+	ParticleSnapshotWriter writer(outSnapshot);
+	writer.Reserve<ParticleSnapshotWorldState>(ParticleSnapshotBlock::World, 1);
+	writer.Reserve<Particle>(ParticleSnapshotBlock::Particles, storageSize);
+	writer.Reserve<int32_t>(ParticleSnapshotBlock::Pool, m_particlePool.size() + stoppedCount);
+	writer.Reserve<int32_t>(ParticleSnapshotBlock::ActiveParticles, m_activeParticles.size() - stoppedCount);
+	writer.Reserve<ParticleForceField>(ParticleSnapshotBlock::ForceFields, m_forceFields.size());
+	writer.Reserve<int32_t>(ParticleSnapshotBlock::ForceGenerators, forceGenerators.size());
+	writer.Reserve<ParticleSnapshotForceRegistration>(ParticleSnapshotBlock::ForceRegistrations, registrationCount);
+	writer.Reserve<ParticleSnapshotContactGenerator>(ParticleSnapshotBlock::ContactGenerators, m_contactGenerators.size());
+	writer.Reserve<int32_t>(ParticleSnapshotBlock::ContactGeneratorMembers, memberCount);
+	writer.Reserve<ParticleSnapshotPair>(ParticleSnapshotBlock::TouchingPairs, touchingPairCount);
+	writer.Finish();
+
+	ParticleSnapshotWorldState& state = *writer.Get<ParticleSnapshotWorldState>(ParticleSnapshotBlock::World);
+	state.Time = m_time;
+	state.LodStep = m_lodStep;
+	state.NextLodStagger = m_nextLodStagger;
+	state.FramesSinceReorder = m_framesSinceReorder;
+	state.MaxPoolSize = m_maxPoolSize;
+	state.ChangedFieldTypes = m_changedFieldTypes;
+	std::copy(std::begin(m_poolPolicies), std::end(m_poolPolicies), state.PoolPolicies);
+	std::copy(std::begin(m_poolReports), std::end(m_poolReports), state.PoolReports);
+
+	Particle* savedParticles = writer.Get<Particle>(ParticleSnapshotBlock::Particles);
+	memcpy(savedParticles, storage, storageSize * sizeof(Particle));
+	int32_t* pool = std::transform(m_particlePool.begin(), m_particlePool.end(), writer.Get<int32_t>(ParticleSnapshotBlock::Pool), indexOf);
+	int32_t* active = writer.Get<int32_t>(ParticleSnapshotBlock::ActiveParticles);
+	for (const Particle* particle : m_activeParticles)
+	{
+		if (particle->IsActive())
+		{
+			*active++ = indexOf(particle);
+			continue;
+		}
+		// The sweep takes it out of all of its generators
+		Particle& saved = savedParticles[indexOf(particle)];
+		saved.RemoveMembershipTags(saved.GetMembershipTags());
+		*pool++ = indexOf(particle);
+	}
+	std::copy(m_forceFields.begin(), m_forceFields.end(), writer.Get<ParticleForceField>(ParticleSnapshotBlock::ForceFields));
+
+	int32_t* connected = writer.Get<int32_t>(ParticleSnapshotBlock::ForceGenerators);
+	for (size_t index = 0; index < forceGenerators.size(); ++index)
+	{
+		connected[index] = forceGenerators[index] ? indexOf(forceGenerators[index]->GetConnectedParticle()) : -1;
+	}
+	ParticleSnapshotForceRegistration* savedRegistration = writer.Get<ParticleSnapshotForceRegistration>(ParticleSnapshotBlock::ForceRegistrations);
+	for (const ParticleForceRegistry::ParticleForceRegistration& registration : registrations)
+	{
+		if (registration.Particle->IsActive())
+			*savedRegistration++ = ParticleSnapshotForceRegistration{ indexOf(registration.Particle), registration.ForceGeneratorIndex };
+	}
+
+	ParticleSnapshotContactGenerator* contactGenerators = writer.Get<ParticleSnapshotContactGenerator>(ParticleSnapshotBlock::ContactGenerators);
+	int32_t* members = writer.Get<int32_t>(ParticleSnapshotBlock::ContactGeneratorMembers);
+	uint32_t firstMember = 0;
+	for (size_t index = 0; index < m_contactGenerators.size(); ++index)
+	{
+		uint32_t lastMember = firstMember;
+		for (const Particle* particle : m_contactGenerators[index]->GetParticles())
+		{
+			if (particle->IsActive())
+				members[lastMember++] = indexOf(particle);
+		}
+		contactGenerators[index] = ParticleSnapshotContactGenerator{ m_contactGenerators[index]->GetTag(), firstMember, lastMember - firstMember };
+		firstMember = lastMember;
+	}
+
+	ParticleSnapshotPair* touchingPair = writer.Get<ParticleSnapshotPair>(ParticleSnapshotBlock::TouchingPairs);
+	for (const std::pair<Particle*, Particle*>& pair : m_touchingPairs)
+	{
+		if (pair.first->IsActive() && pair.second->IsActive())
+			*touchingPair++ = ParticleSnapshotPair{ indexOf(pair.first), indexOf(pair.second) };
+	}
+}
+
+bool ParticleWorld::RestoreSnapshot(const void* snapshot, const size_t& size)
+{
+	waitForBackgroundRead();
+
+	ParticleSnapshotReader reader;
+	if (!reader.Open(snapshot, size))
+		return false;
+
+	size_t stateCount = 0, particleCount = 0, poolCount = 0, activeCount = 0, fieldCount = 0, forceGeneratorCount = 0;
+	size_t registrationCount = 0, contactGeneratorCount = 0, memberCount = 0, touchingPairCount = 0;
+	const ParticleSnapshotWorldState* state = reader.Get<ParticleSnapshotWorldState>(ParticleSnapshotBlock::World, stateCount);
+	const Particle* particles = reader.Get<Particle>(ParticleSnapshotBlock::Particles, particleCount);
+	const int32_t* pool = reader.Get<int32_t>(ParticleSnapshotBlock::Pool, poolCount);
+	const int32_t* active = reader.Get<int32_t>(ParticleSnapshotBlock::ActiveParticles, activeCount);
+	const ParticleForceField* fields = reader.Get<ParticleForceField>(ParticleSnapshotBlock::ForceFields, fieldCount);
+	const int32_t* connected = reader.Get<int32_t>(ParticleSnapshotBlock::ForceGenerators, forceGeneratorCount);
+	const ParticleSnapshotForceRegistration* registrations = reader.Get<ParticleSnapshotForceRegistration>(ParticleSnapshotBlock::ForceRegistrations, registrationCount);
+	const ParticleSnapshotContactGenerator* contactGenerators = reader.Get<ParticleSnapshotContactGenerator>(ParticleSnapshotBlock::ContactGenerators, contactGeneratorCount);
+	const int32_t* members = reader.Get<int32_t>(ParticleSnapshotBlock::ContactGeneratorMembers, memberCount);
+	const ParticleSnapshotPair* touchingPairs = reader.Get<ParticleSnapshotPair>(ParticleSnapshotBlock::TouchingPairs, touchingPairCount);
+	if (!state || stateCount != 1 || !particles || !pool || !active || !fields || !connected || !registrations ||
+		!contactGenerators || !members || !touchingPairs)
+		return false;
+
+	// Everything is checked before the world changes
+	const std::vector<ParticleForceGenerator*>& forceGenerators = m_registry.GetForceGenerators();
+	if (particleCount > static_cast<size_t>(std::numeric_limits<int32_t>::max()) || poolCount + activeCount != particleCount ||
+		forceGeneratorCount != forceGenerators.size() || contactGeneratorCount != m_contactGenerators.size())
+		return false;
+
+	auto validIndex = [particleCount](const int32_t& index) { return index >= 0 && static_cast<size_t>(index) < particleCount; };
+	auto activeIndex = [particles, &validIndex](const int32_t& index) { return validIndex(index) && particles[index].IsActive(); };
+
+	// Every slot is listed exactly once, in the pool if it is stopped and
+	// in the active list if it isn't
+	ParticleFrameVector<bool> listed(&m_frameAllocator);
+	listed.resize(particleCount, false);
+	auto listOnce = [&listed](const int32_t& index)
+	{
+		if (listed[index])
+			return false;
+		listed[index] = true;
+		return true;
+	};
+	for (size_t index = 0; index < poolCount; ++index)
+	{
+		if (!validIndex(pool[index]) || particles[pool[index]].IsActive() || !listOnce(pool[index]))
+			return false;
+	}
+	for (size_t index = 0; index < activeCount; ++index)
+	{
+		if (!activeIndex(active[index]) || !listOnce(active[index]))
+			return false;
+	}
+
+	// Only active particles may be in the generators and the registry
+	if (!std::all_of(members, members + memberCount, activeIndex))
+		return false;
+	for (size_t index = 0; index < registrationCount; ++index)
+	{
+		if (!activeIndex(registrations[index].Particle) || registrations[index].ForceGenerator < 0 ||
+			static_cast<size_t>(registrations[index].ForceGenerator) >= forceGeneratorCount)
+			return false;
+	}
+	for (size_t index = 0; index < touchingPairCount; ++index)
+	{
+		if (!activeIndex(touchingPairs[index].First) || !activeIndex(touchingPairs[index].Second))
+			return false;
+	}
+	for (size_t index = 0; index < contactGeneratorCount; ++index)
+	{
+		const ParticleSnapshotContactGenerator& contactGenerator = contactGenerators[index];
+		if (contactGenerator.Tag != m_contactGenerators[index]->GetTag() || contactGenerator.FirstMember > memberCount ||
+			contactGenerator.MemberCount > memberCount - contactGenerator.FirstMember)
+			return false;
+	}
+
+	// Force generators which connect two particles point into the
+	// storage themselves, they are remapped from the particle they
+	// point at now to the one they pointed at in the snapshot
+	Particle* oldStorage = m_particleStorage.data();
+	const size_t oldSize = m_particleStorage.size();
+	m_reorderNewIndices.resize(oldSize);
+	for (size_t index = 0; index < oldSize; ++index)
+	{
+		m_reorderNewIndices[index] = static_cast<int>(index);
+	}
+	ParticleFrameVector<bool> remapped(&m_frameAllocator);
+	remapped.resize(oldSize, false);
+	for (size_t index = 0; index < forceGeneratorCount; ++index)
+	{
+		// A forgotten generator has nothing to remap
+		if (!forceGenerators[index])
+			continue;
+		Particle* current = forceGenerators[index]->GetConnectedParticle();
+		const uintptr_t offset = reinterpret_cast<uintptr_t>(current) - reinterpret_cast<uintptr_t>(oldStorage);
+		const int32_t currentIndex = current && offset < oldSize * sizeof(Particle) ? static_cast<int32_t>(current - oldStorage) : -1;
+		if (currentIndex < 0 || connected[index] < 0)
+		{
+			// Pointers outside of the storage can't be moved into it
+			if (currentIndex != connected[index])
+				return false;
+			continue;
+		}
+		if (!validIndex(connected[index]) || (remapped[currentIndex] && m_reorderNewIndices[currentIndex] != connected[index]))
+			return false;
+		m_reorderNewIndices[currentIndex] = connected[index];
+		remapped[currentIndex] = true;
+	}
+
+	// The storage only grows, the slots beyond the snapshot are handed
+	// out last
+	const size_t newSize = std::max(oldSize, particleCount);
+	if (newSize > oldSize)
+	{
+		// The particles of the queued commands keep their slots
+		std::vector<int> sameIndices(oldSize);
+		for (size_t index = 0; index < oldSize; ++index)
+		{
+			sameIndices[index] = static_cast<int>(index);
+		}
+		m_particleStorage.resize(newSize);
+		m_particlePool.reserve(newSize);
+		m_activeParticles.reserve(newSize);
+		m_commandBuffer.RemapParticles(ParticleRemap(oldStorage, m_particleStorage.data(), sameIndices));
+	}
+	Particle* storage = m_particleStorage.data();
+	std::fill(m_particleStorage.begin() + particleCount, m_particleStorage.end(), Particle());
+
+	// The particles with a lifetime are scheduled while their chunk is
+	// still in the cache
+	m_lifetimeWheel.Reset(state->Time);
+	const size_t chunkSize = std::max<size_t>(1, (256 * 1024) / sizeof(Particle));
+	for (size_t first = 0; first < particleCount; first += chunkSize)
+	{
+		const size_t last = std::min(particleCount, first + chunkSize);
+		memcpy(storage + first, particles + first, (last - first) * sizeof(Particle));
+		for (size_t index = first; index < last; ++index)
+		{
+			if (storage[index].IsActive())
+				m_lifetimeWheel.Schedule(storage + index);
+		}
+	}
+
+	m_particlePool.clear();
+	for (size_t index = particleCount; index < newSize; ++index)
+	{
+		m_particlePool.push_back(storage + index);
+	}
+	for (size_t index = 0; index < poolCount; ++index)
+	{
+		m_particlePool.push_back(storage + pool[index]);
+	}
+	m_activeParticles.resize(activeCount);
+	for (size_t index = 0; index < activeCount; ++index)
+	{
+		m_activeParticles[index] = storage + active[index];
+	}
+
+	const ParticleRemap connectedRemap(oldStorage, storage, m_reorderNewIndices);
+	for (ParticleForceGenerator* forceGenerator : forceGenerators)
+	{
+		if (forceGenerator)
+			forceGenerator->RemapParticles(connectedRemap);
+	}
+	m_registry.Clear();
+	for (size_t index = 0; index < registrationCount; ++index)
+	{
+		// The registrations of generators forgotten since the snapshot
+		// went with them
+		if (ParticleForceGenerator* forceGenerator = forceGenerators[registrations[index].ForceGenerator])
+			m_registry.Add(storage + registrations[index].Particle, forceGenerator);
+	}
+
+	ParticleFrameVector<Particle*> generatorMembers(&m_frameAllocator);
+	for (size_t index = 0; index < contactGeneratorCount; ++index)
+	{
+		const ParticleSnapshotContactGenerator& contactGenerator = contactGenerators[index];
+		generatorMembers.resize(contactGenerator.MemberCount);
+		for (uint32_t member = 0; member < contactGenerator.MemberCount; ++member)
+		{
+			generatorMembers[member] = storage + members[contactGenerator.FirstMember + member];
+		}
+		m_contactGenerators[index]->ReplaceParticles(generatorMembers.data(), generatorMembers.size());
+	}
+
+	m_forceFields.assign(fields, fields + fieldCount);
+	updateUniformFieldAcceleration();
+	m_changedFieldTypes = state->ChangedFieldTypes;
+
+	m_time = state->Time;
+	m_lodStep = state->LodStep;
+	m_nextLodStagger = state->NextLodStagger;
+	rebuildSpawnOrder();
+	m_pendingReleases = 0;
+	m_framesSinceReorder = state->FramesSinceReorder;
+	m_maxPoolSize = std::max(state->MaxPoolSize, static_cast<int>(newSize));
+	std::copy(std::begin(state->PoolPolicies), std::end(state->PoolPolicies), m_poolPolicies);
+	std::copy(std::begin(state->PoolReports), std::end(state->PoolReports), m_poolReports);
+
+	m_touchingPairs.resize(touchingPairCount);
+	for (size_t index = 0; index < touchingPairCount; ++index)
+	{
+		m_touchingPairs[index] = std::make_pair(storage + touchingPairs[index].First, storage + touchingPairs[index].Second);
+	}
+	m_contactEvents.DiscardUntil(m_contactEvents.End());
+	m_contactEventsNotified = m_contactEvents.End();
+
+	m_spatialIndexValid = false;
+	m_previousStepContacts = -1;
+	m_previousStepParticles = 0;
+	return true;
+}
+
+void ParticleWorld::BeginBackgroundRead()
 {
-	m_contacts = new ParticleContact[maxContactsPerFrame];
-	m_shouldCalculateIterations = (contactResolutionIterations == 0);
-	createParticlePool(poolSize);
+	std::lock_guard<std::mutex> lock(m_backgroundReadMutex);
+	assert(!m_backgroundRead && "one background read at a time");
+	m_backgroundRead = true;
 }
 
-ParticleWorld::~ParticleWorld()
+void ParticleWorld::EndBackgroundRead()
 {
-	delete[] m_contacts;
-	for(Particle* particle : m_activeParticles)
 	{
-		delete particle;
-	}
-	for (Particle* particle : m_particlePool)
-	{
-		delete particle;
+		std::lock_guard<std::mutex> lock(m_backgroundReadMutex);
+		m_backgroundRead = false;
 	}
+	m_backgroundReadDone.notify_all();
 }
 
-void ParticleWorld::StartFrame()
+void ParticleWorld::AddContactEventListener(ParticleContactEventListener* listener)
 {
-	disableActiveParticleOutOfLevelBounds();
-	releaseInactiveParticles();
-	for (Particle* particle : m_activeParticles)
+	m_contactEventListeners.push_back(listener);
+}
+
+const ParticleContactEventStream& ParticleWorld::GetContactEvents() const
+{
+	return m_contactEvents;
+}
+
+void ParticleWorld::SetContactEventCapacity(const int& capacity)
+{
+	m_contactEvents.SetCapacity(capacity);
+	m_contactEventsNotified = m_contactEvents.Begin();
+}
+
+int ParticleWorld::GetLastContactDestroyedCount() const
+{
+	return m_lastContactDestroyed;
+}
+
+int ParticleWorld::GetLastDroppedContactEventCount() const
+{
+	return m_lastDroppedContactEvents;
+}
+
+void ParticleWorld::SetContactEventSlop(const float& slop)
+{
+	m_contactEventSlop = slop;
+}
+
+ParticleCommandBuffer& ParticleWorld::GetCommandBuffer()
+{
+	return m_commandBuffer;
+}
+
+int ParticleWorld::GetLastAppliedCommandCount() const
+{
+	return m_lastAppliedCommands;
+}
+
+void ParticleWorld::applyCommands()
+{
+	m_commandBuffer.Take(m_commandBatch);
+	m_lastAppliedCommands = 0;
+	if (m_commandBatch.IsEmpty())
+		return;
+
+	const ParticleCommandBuffer::Batch& batch = m_commandBatch;
+	m_lastAppliedCommands = static_cast<int>(batch.Despawns.size() + batch.ForceFields.size() + batch.Edits.size() +
+		batch.ParticleVelocities.size() + batch.Spawns.size());
+
+	// Despawns first, so the spawns can take their slots
+	bool despawned = false;
+	for (Particle* particle : batch.Despawns)
 	{
-		particle->ClearForceAccumulator();
+		despawned |= particle->IsActive();
+		particle->SetActive(false);
+	}
+	if (batch.DespawnTypes)
+	{
+		++m_lastAppliedCommands;
+		for (Particle* particle : m_activeParticles)
+		{
+			if (batch.DespawnTypes & ParticleCollisionFilter::GetCategory(particle->GetType()))
+			{
+				particle->SetActive(false);
+				despawned = true;
+			}
+		}
+	}
+	if (despawned)
+		releaseInactiveParticles();
+
+	// The sums of the uniform fields once for all of the changes
+	for (const ParticleCommandBuffer::ForceFieldCommand& command : batch.ForceFields)
+	{
+		ParticleForceField field = command.Field;
+		if (command.EnabledOnly)
+		{
+			if (m_forceFields[command.Handle].Enabled == field.Enabled)
+				continue;
+			field = m_forceFields[command.Handle];
+			field.Enabled = command.Field.Enabled;
+		}
+		replaceForceField(command.Handle, field);
+	}
+	if (!batch.ForceFields.empty())
+		updateUniformFieldAcceleration();
+
+	// All edits in one pass over the particles
+	if (!batch.Edits.empty())
+	{
+		for (Particle* particle : m_activeParticles)
+		{
+			const unsigned category = ParticleCollisionFilter::GetCategory(particle->GetType());
+			for (const ParticleCommandBuffer::EditCommand& edit : batch.Edits)
+			{
+				if (!(edit.TypeMask & category))
+					continue;
+				if (edit.Kind == ParticleCommandBuffer::EditKind::SetAcceleration)
+					particle->SetAcceleration(edit.Value);
+				else
+					particle->SetVelocity(particle->GetVelocity() + edit.Value);
+			}
+		}
+	}
+	for (const ParticleCommandBuffer::ParticleVelocityCommand& command : batch.ParticleVelocities)
+	{
+		if (command.Target->IsActive())
+			command.Target->SetVelocity(command.Target->GetVelocity() + command.Velocity);
 	}
+
+	if (!batch.Spawns.empty())
+		applySpawnCommands();
+
+	m_commandBatch.Clear();
 }
 
-void ParticleWorld::RunPhysics(const float& deltaTime)
+void ParticleWorld::applySpawnCommands()
 {
-	// First apply the force generators
-	m_registry.UpdateForces(deltaTime);
-
-	// Then integrate the objects
-	integrateAllParticles(deltaTime);
+	const ParticleCommandBuffer::Batch& batch = m_commandBatch;
 
-	// Generate contacts
-	int usedContacts = generateContactsWithRegisteredContactGeneratorsAndReturnNumOfContacts();
+	// Growing the pool moves the storage, so the spawned particles are
+	// kept by their index until all of them are taken, together with the
+	// index of their command
+	ParticleFrameVector<std::pair<int, int>> spawned(&m_frameAllocator);
+	spawned.reserve(batch.Spawns.size());
+	for (size_t index = 0; index < batch.Spawns.size(); ++index)
+	{
+		const ParticleCommandBuffer::SpawnCommand& command = batch.Spawns[index];
+		Particle* particle;
+		if (GetNewParticles(command.Prototype, 1, &particle) == 0)
+			continue;
+		if (command.Lifetime > 0)
+			SetParticleLifetime(particle, command.Lifetime);
+		spawned.push_back(std::make_pair(static_cast<int>(particle - m_particleStorage.data()), static_cast<int>(index)));
+	}
 
-	// And process them
-	if (usedContacts)
+	// Every contact generator gets its particles at once
+	Particle* storage = m_particleStorage.data();
+	ParticleFrameVector<Particle*> particles(&m_frameAllocator);
+	particles.reserve(spawned.size());
+	for (ParticleContactGenerator* contactGenerator : m_contactGenerators)
 	{
-		if (m_shouldCalculateIterations)
+		const uint32_t tag = contactGenerator->GetTag();
+		particles.clear();
+		for (const std::pair<int, int>& particle : spawned)
 		{
-			m_contactResolver.SetIterations(usedContacts * 2);
+			if (tag == 0 || (batch.Spawns[particle.second].ContactGeneratorTags & tag))
+				particles.push_back(storage + particle.first);
 		}
-		m_contactResolver.ResolveContacts(m_contacts, usedContacts, deltaTime);
+		contactGenerator->AddParticle(particles.data(), particles.size());
+	}
+
+	for (const std::pair<int, int>& particle : spawned)
+	{
+		if (batch.Spawns[particle.second].Ballistic)
+			LaunchBallistic(storage + particle.first);
 	}
 }
 
-void ParticleWorld::integrateAllParticles(const float& deltaTime)
+void ParticleWorld::SetParticleLifetime(Particle* particle, const float& seconds)
+{
+	particle->SetExpiryTime(m_time + std::max(0.f, seconds));
+	m_lifetimeWheel.Schedule(particle);
+}
+
+void ParticleWorld::ClearParticleLifetime(Particle* particle)
+{
+	// Its entry in the wheel goes stale
+	particle->ClearExpiryTime();
+}
+
+int ParticleWorld::GetLastExpiredCount() const
+{
+	return m_lastExpired;
+}
+
+void ParticleWorld::SetParticleReorderInterval(const int& frames)
+{
+	m_reorderInterval = frames;
+}
+
+void ParticleWorld::SetParticleReorderLocalityThreshold(const float& locality)
+{
+	m_reorderLocalityThreshold = locality;
+}
+
+// Spreads the lower 16 bits of value to the even bits
+static uint32_t spreadBits(uint32_t value)
+{
+	value &= 0x0000ffff;
+	value = (value | (value << 8)) & 0x00ff00ff;
+	value = (value | (value << 4)) & 0x0f0f0f0f;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+static uint32_t mortonCode(const Vector3& position, const LevelBounds& bounds)
+{
+	// The level is two dimensional, so the code interleaves x and y
+	// quantized to 16 bits within the level bounds
+	const float scale = 65535.f;
+	float x = (position.x - bounds.MinX) / (bounds.MaxX - bounds.MinX);
+	float y = (position.y - bounds.MinY) / (bounds.MaxY - bounds.MinY);
+	uint32_t cellX = static_cast<uint32_t>(std::min(std::max(x, 0.f), 1.f) * scale);
+	uint32_t cellY = static_cast<uint32_t>(std::min(std::max(y, 0.f), 1.f) * scale);
+	return spreadBits(cellX) | (spreadBits(cellY) << 1);
+}
+
+void ParticleWorld::sortActiveParticlesAlongZOrder(ParticleFrameVector<std::pair<uint32_t, int>>& outOrder) const
 {
+	const Particle* storage = m_particleStorage.data();
+	outOrder.clear();
+	outOrder.reserve(m_activeParticles.size());
 	for (Particle* particle : m_activeParticles)
 	{
-		particle->Integrate(deltaTime);
+		outOrder.push_back(std::make_pair(mortonCode(particle->GetPosition(), m_levelBounds), static_cast<int>(particle - storage)));
 	}
+	std::sort(outOrder.begin(), outOrder.end());
 }
 
-int ParticleWorld::generateContactsWithRegisteredContactGeneratorsAndReturnNumOfContacts()
+float ParticleWorld::measureLocality(const ParticleFrameVector<std::pair<uint32_t, int>>& order) const
 {
-	int limitOfContacts = m_maxContacts;
-	ParticleContact* nextContact = m_contacts;
+	if (order.size() < 2)
+		return 1.f;
 
-	for (ParticleContactGenerator* contactGenerator : m_contactGenerators)
+	int local = 0;
+	for (size_t index = 1; index < order.size(); ++index)
+	{
+		local += std::abs(order[index].second - order[index - 1].second) <= LocalityWindow ? 1 : 0;
+	}
+	return static_cast<float>(local) / static_cast<float>(order.size() - 1);
+}
+
+float ParticleWorld::MeasureParticleLocality()
+{
+	ParticleFrameVector<std::pair<uint32_t, int>> order(&m_frameAllocator);
+	sortActiveParticlesAlongZOrder(order);
+	return measureLocality(order);
+}
+
+bool ParticleWorld::shouldReorderParticles()
+{
+	++m_framesSinceReorder;
+	if (m_reorderInterval > 0 && m_framesSinceReorder >= m_reorderInterval)
+		return true;
+
+	return m_reorderLocalityThreshold > 0 && m_framesSinceReorder % localityCheckInterval == 0 &&
+		MeasureParticleLocality() < m_reorderLocalityThreshold;
+}
+
+void ParticleWorld::ReorderParticles()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	ParticleFrameStdAllocator<int> scratch(&m_frameAllocator);
+	ParticleFrameVector<std::pair<uint32_t, int>> order(scratch);
+	sortActiveParticlesAlongZOrder(order);
+	m_reorderStats.LocalityBefore = measureLocality(order);
+
+	// The active particles move to the front in Z-order, the pooled ones
+	// fill the rest of the storage
+	const int storageSize = static_cast<int>(m_particleStorage.size());
+	m_reorderNewIndices.assign(storageSize, -1);
+	int nextIndex = 0;
+	for (const std::pair<uint32_t, int>& entry : order)
+	{
+		m_reorderNewIndices[entry.second] = nextIndex++;
+	}
+	for (int& newIndex : m_reorderNewIndices)
 	{
-		removeInactiveParticles(contactGenerator->GetParticles());
-		int used = contactGenerator->AddContact(nextContact, limitOfContacts);
-		limitOfContacts -= used;
-		nextContact += used;
+		if (newIndex < 0)
+			newIndex = nextIndex++;
+	}
 
-		// We've run out of contacts to fill. This means we're missing
-		// contacts.
-		if (limitOfContacts <= 0) break;
+	// Move the particles in place by following the cycles of the
+	// permutation, every swap puts one particle at its final slot
+	ParticleFrameVector<int> permutation(m_reorderNewIndices.begin(), m_reorderNewIndices.end(), scratch);
+	for (int index = 0; index < storageSize; ++index)
+	{
+		while (permutation[index] != index)
+		{
+			const int target = permutation[index];
+			std::swap(m_particleStorage[index], m_particleStorage[target]);
+			std::swap(permutation[index], permutation[target]);
+		}
 	}
 
-	// Return the number of contacts used.
-	return m_maxContacts - limitOfContacts;
+	remapParticles(ParticleRemap(m_particleStorage.data(), m_reorderNewIndices));
+	std::sort(m_activeParticles.begin(), m_activeParticles.end(), std::less<Particle*>());
+
+	sortActiveParticlesAlongZOrder(order);
+	m_reorderStats.LocalityAfter = measureLocality(order);
+	m_reorderStats.LastMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	m_reorderStats.TotalMilliseconds += m_reorderStats.LastMilliseconds;
+	++m_reorderStats.Reorders;
+	m_framesSinceReorder = 0;
 }
 
-std::vector<Particle*>& ParticleWorld::GetActiveParticles()
+const ParticleReorderStats& ParticleWorld::GetParticleReorderStats() const
 {
-	return m_activeParticles;
+	return m_reorderStats;
 }
 
-std::vector<ParticleContactGenerator*>& ParticleWorld::GetContactGenerators()
+Particle* ParticleWorld::GetNewParticle(const ParticleTypes& type)
 {
-	return m_contactGenerators;
+	Particle prototype;
+	prototype.SetType(type);
+	Particle* particle = nullptr;
+	GetNewParticles(prototype, 1, &particle);
+	return particle;
 }
 
-ParticleForceRegistry& ParticleWorld::GetForceRegistry()
+int ParticleWorld::GetNewParticles(const Particle& prototype, const int& count, Particle** outParticles)
 {
-	return m_registry;
+	const ParticleTypes type = prototype.GetType();
+	const ParticlePoolPolicy& policy = m_poolPolicies[static_cast<int>(type)];
+	const bool recycle = policy.OnExhausted == ParticlePoolExhaustionPolicy::RecycleOldest ||
+		policy.OnExhausted == ParticlePoolExhaustionPolicy::RecycleFurthest;
+
+	const int active = m_poolReports[static_cast<int>(type)].Active;
+	const int allowed = std::max(0, std::min(count, policy.Quota - active));
+	int taken = takeFromPool(prototype, std::min(allowed, freeSlotsFor(type)), outParticles);
+	if (taken < allowed)
+	{
+		const Particle* oldStorage = m_particleStorage.data();
+		if (policy.OnExhausted == ParticlePoolExhaustionPolicy::Grow && growPool(allowed - taken))
+		{
+			// The particles which were taken before moved with the storage
+			for (int index = 0; index < taken; ++index)
+			{
+				outParticles[index] = m_particleStorage.data() + (outParticles[index] - oldStorage);
+			}
+			taken += takeFromPool(prototype, std::min(allowed - taken, freeSlotsFor(type)), outParticles + taken);
+		}
+		else if (recycle)
+			taken += recycleParticles(prototype, allowed - taken, false, outParticles + taken);
+	}
+	if (taken < count && recycle && allowed < count)
+	{
+		// The type reached its quota and makes room among its own
+		taken += recycleParticles(prototype, count - taken, true, outParticles + taken);
+	}
+
+	m_poolReports[static_cast<int>(type)].Failed += count - taken;
+	return taken;
+}
+
+void ParticleWorld::SetPoolPolicy(const ParticleTypes& type, const ParticlePoolPolicy& policy)
+{
+	m_poolPolicies[static_cast<int>(type)] = policy;
 }
 
-Particle* ParticleWorld::GetNewParticle()
+const ParticlePoolPolicy& ParticleWorld::GetPoolPolicy(const ParticleTypes& type) const
 {
-	if (m_particlePool.size() <= 0)
-		return nullptr;
+	return m_poolPolicies[static_cast<int>(type)];
+}
 
-	Particle* particle = m_particlePool.back();
-	m_particlePool.pop_back();
-	particle->SetActive(true);
-	particle->SetType(ParticleTypes::None);
-	m_activeParticles.push_back(particle);
-	return particle;
+void ParticleWorld::SetMaxPoolSize(const int& size)
+{
+	m_maxPoolSize = size;
+}
+
+int ParticleWorld::GetPoolCapacity() const
+{
+	return static_cast<int>(m_particleStorage.size());
+}
+
+int ParticleWorld::GetFreePoolCount() const
+{
+	return static_cast<int>(m_particlePool.size());
+}
+
+const ParticlePoolTypeReport& ParticleWorld::GetPoolReport(const ParticleTypes& type) const
+{
+	return m_poolReports[static_cast<int>(type)];
 }
 
 void ParticleWorld::ReleaseParticle(Particle* particle)
 {
+	if (!particle->IsActive())
+		return;
+
+	// The sweep of the next frame puts it back into the pool with all the
+	// others, until then it only stops counting against its type
 	particle->SetActive(false);
-	removeInactiveParticles(m_activeParticles);
-	m_particlePool.push_back(particle);
+	--m_poolReports[static_cast<int>(particle->GetType())].Active;
+	++m_pendingReleases;
+	m_spatialIndexValid = false;
 }
 
 void ParticleWorld::createParticlePool(const int& poolSize)
 {
+	m_maxPoolSize = poolSize * 4;
+
+	// Releasing and spawning particles never has to reallocate
+	m_particleStorage.resize(poolSize);
+	m_particlePool.reserve(poolSize);
+	m_activeParticles.reserve(poolSize);
+	m_reorderNewIndices.reserve(poolSize);
+	m_spawnOrder.reserve(poolSize * 2);
 	for(int i = 0; i < poolSize; ++i)
 	{
-		m_particlePool.push_back(new Particle);
+		m_particlePool.push_back(&m_particleStorage[i]);
+	}
+}
+
+int ParticleWorld::freeSlotsFor(const ParticleTypes& type) const
+{
+	int reservedForOthers = 0;
+	for (int other = 0; other < ParticleTypeCount; ++other)
+	{
+		if (other != static_cast<int>(type))
+			reservedForOthers += std::max(0, m_poolPolicies[other].Reserved - m_poolReports[other].Active);
+	}
+	return std::max(0, static_cast<int>(m_particlePool.size()) - reservedForOthers);
+}
+
+int ParticleWorld::takeFromPool(const Particle& prototype, const int& count, Particle** outParticles)
+{
+	Particle* const* first = m_particlePool.data() + m_particlePool.size() - count;
+	spawnParticles(prototype, first, count, outParticles);
+	m_activeParticles.insert(m_activeParticles.end(), first, first + count);
+	m_particlePool.resize(m_particlePool.size() - count);
+	m_spatialIndexValid = false;
+	m_poolReports[static_cast<int>(prototype.GetType())].Active += count;
+	return count;
+}
+
+void ParticleWorld::spawnParticles(const Particle& prototype, Particle* const* slots, const int& count, Particle** outParticles)
+{
+	Particle spawned = prototype;
+	spawned.SetActive(true);
+	spawned.SetAwake(true);
+	spawned.ClearExpiryTime();
+	spawned.RemoveMembershipTags(spawned.GetMembershipTags());
+	spawned.SetSpawnTime(m_time);
+
+	int runStart = 0;
+	while (runStart < count)
+	{
+		// The pool hands out the slots of a fresh or grown storage one
+		// after the other, upwards or downwards
+		int runLength = 1;
+		const ptrdiff_t step = runStart + 1 < count ? slots[runStart + 1] - slots[runStart] : 0;
+		if (step == 1 || step == -1)
+		{
+			while (runStart + runLength < count && slots[runStart + runLength] - slots[runStart + runLength - 1] == step)
+			{
+				++runLength;
+			}
+		}
+		std::fill_n(step < 0 ? slots[runStart + runLength - 1] : slots[runStart], runLength, spawned);
+
+		for (int index = runStart; index < runStart + runLength; ++index)
+		{
+			if (m_spawnOrder.size() == m_spawnOrder.capacity())
+				compactSpawnOrder();
+			m_spawnOrder.push_back(ParticleSpawnRecord{ slots[index], m_nextLodStagger });
+			slots[index]->SetLodStagger(m_nextLodStagger++);
+			outParticles[index] = slots[index];
+		}
+		runStart += runLength;
+	}
+}
+
+bool ParticleWorld::growPool(const int& extra)
+{
+	const int oldSize = static_cast<int>(m_particleStorage.size());
+	const int newSize = std::min(m_maxPoolSize, std::max(oldSize * 2, oldSize + extra));
+	if (newSize <= oldSize)
+		return false;
+
+	// The particles move to the new storage in the same order
+	Particle* oldStorage = m_particleStorage.data();
+	m_reorderNewIndices.resize(oldSize);
+	for (int index = 0; index < oldSize; ++index)
+	{
+		m_reorderNewIndices[index] = index;
+	}
+	m_particleStorage.resize(newSize);
+	remapParticles(ParticleRemap(oldStorage, m_particleStorage.data(), m_reorderNewIndices));
+
+	m_particlePool.reserve(newSize);
+	m_activeParticles.reserve(newSize);
+	m_reorderNewIndices.reserve(newSize);
+	m_spawnOrder.reserve(newSize * 2);
+	for (int index = oldSize; index < newSize; ++index)
+	{
+		m_particlePool.push_back(&m_particleStorage[index]);
+	}
+	return true;
+}
+
+int ParticleWorld::recycleParticles(const Particle& prototype, const int& count, const bool& sameType, Particle** outParticles)
+{
+	const ParticleTypes type = prototype.GetType();
+	const ParticlePoolPolicy& policy = m_poolPolicies[static_cast<int>(type)];
+	auto isCandidate = [&](const Particle* particle)
+	{
+		const ParticleTypes candidateType = particle->GetType();
+		return sameType ? candidateType == type : m_poolPolicies[static_cast<int>(candidateType)].Priority < policy.Priority;
+	};
+
+	int recycled = 0;
+	if (policy.OnExhausted == ParticlePoolExhaustionPolicy::RecycleOldest)
+	{
+		// The spawn order is the order of age, the first candidates are
+		// the oldest
+		while (m_spawnOrderHead < m_spawnOrder.size() && !isCurrentSpawn(m_spawnOrder[m_spawnOrderHead]))
+		{
+			++m_spawnOrderHead;
+		}
+		for (size_t index = m_spawnOrderHead; index < m_spawnOrder.size() && recycled < count; ++index)
+		{
+			const ParticleSpawnRecord& record = m_spawnOrder[index];
+			if (!isCurrentSpawn(record))
+				continue;
+			// The particles of this frame may still be in the hands of
+			// whoever spawned them, all the ones after are of this frame
+			// too
+			if (record.Spawned->GetSpawnTime() == m_time)
+				break;
+			if (isCandidate(record.Spawned))
+				outParticles[recycled++] = record.Spawned;
+		}
+	}
+	else
+	{
+		// The candidates sorted by how far they are from the view
+		const Vector3 viewCenter((m_lodView.MinX + m_lodView.MaxX) * 0.5f, (m_lodView.MinY + m_lodView.MaxY) * 0.5f, 0);
+		ParticleFrameVector<std::pair<float, Particle*>> candidates(&m_frameAllocator);
+		for (Particle* particle : m_activeParticles)
+		{
+			if (!particle->IsActive() || particle->GetSpawnTime() == m_time || !isCandidate(particle))
+				continue;
+			candidates.push_back(std::make_pair(-(particle->GetPosition() - viewCenter).LengthSquared(), particle));
+		}
+
+		recycled = std::min(count, static_cast<int>(candidates.size()));
+		if (recycled == 0)
+			return 0;
+		std::nth_element(candidates.begin(), candidates.begin() + (recycled - 1), candidates.end());
+		for (int index = 0; index < recycled; ++index)
+		{
+			outParticles[index] = candidates[index].second;
+		}
+	}
+	if (recycled == 0)
+		return 0;
+
+	// Nothing may keep the recycled particles from their old life
+	uint32_t recycledTags = 0;
+	for (int index = 0; index < recycled; ++index)
+	{
+		Particle* particle = outParticles[index];
+		ParticlePoolTypeReport& report = m_poolReports[static_cast<int>(particle->GetType())];
+		--report.Active;
+		++report.Recycled;
+		recycledTags |= particle->GetMembershipTags();
+		particle->SetActive(false);
+	}
+	detachInactiveParticles(recycledTags);
+
+	spawnParticles(prototype, outParticles, recycled, outParticles);
+	m_poolReports[static_cast<int>(type)].Active += recycled;
+	return recycled;
+}
+
+bool ParticleWorld::isCurrentSpawn(const ParticleSpawnRecord& record)
+{
+	return record.Spawned->IsActive() && record.Spawned->GetLodStagger() == record.Serial;
+}
+
+void ParticleWorld::compactSpawnOrder()
+{
+	m_spawnOrder.erase(std::remove_if(m_spawnOrder.begin(), m_spawnOrder.end(),
+		[](const ParticleSpawnRecord& record) { return !isCurrentSpawn(record); }), m_spawnOrder.end());
+	m_spawnOrderHead = 0;
+}
+
+void ParticleWorld::rebuildSpawnOrder()
+{
+	m_spawnOrder.clear();
+	m_spawnOrder.reserve(m_particleStorage.size() * 2);
+	m_spawnOrderHead = 0;
+	for (Particle* particle : m_activeParticles)
+	{
+		m_spawnOrder.push_back(ParticleSpawnRecord{ particle, particle->GetLodStagger() });
+	}
+
+	// The serials count up from the oldest particle to the next one
+	const unsigned next = m_nextLodStagger;
+	std::sort(m_spawnOrder.begin(), m_spawnOrder.end(),
+		[next](const ParticleSpawnRecord& a, const ParticleSpawnRecord& b) { return a.Serial - next < b.Serial - next; });
+}
+
+void ParticleWorld::detachInactiveParticles(const uint32_t& tags)
+{
+	endTouchingPairsOfInactiveParticles();
+	m_spatialIndexValid = false;
+	for (ParticleContactGenerator* contactGenerator : m_contactGenerators)
+	{
+		const uint32_t tag = contactGenerator->GetTag();
+		if (tag == 0 || (tags & tag))
+			contactGenerator->RemoveInactiveParticles();
+	}
+	m_registry.RemoveInactiveParticles();
+}
+
+void ParticleWorld::countActiveParticlesByType()
+{
+	for (ParticlePoolTypeReport& report : m_poolReports)
+	{
+		report.Active = 0;
+	}
+	for (Particle* particle : m_activeParticles)
+	{
+		++m_poolReports[static_cast<int>(particle->GetType())].Active;
+	}
+}
+
+void ParticleWorld::remapParticles(const ParticleRemap& remap)
+{
+	for (Particle*& particle : m_activeParticles)
+	{
+		particle = remap(particle);
+	}
+	for (Particle*& particle : m_particlePool)
+	{
+		particle = remap(particle);
+	}
+	for (ParticleContactGenerator* contactGenerator : m_contactGenerators)
+	{
+		contactGenerator->RemapParticles(remap);
+	}
+	m_registry.RemapParticles(remap, &m_frameAllocator);
+	m_lifetimeWheel.RemapParticles(remap);
+	for (ParticleSpawnRecord& record : m_spawnOrder)
+	{
+		record.Spawned = remap(record.Spawned);
+	}
+	m_commandBuffer.RemapParticles(remap);
+	m_contactEvents.RemapParticles(remap);
+	m_spatialIndexValid = false;
+	for (std::pair<Particle*, Particle*>& pair : m_touchingPairs)
+	{
+		pair = std::make_pair(remap(pair.first), remap(pair.second));
+		if (pair.second < pair.first)
+			std::swap(pair.first, pair.second);
 	}
+	std::sort(m_touchingPairs.begin(), m_touchingPairs.end());
 }
 
 void ParticleWorld::removeInactiveParticles(std::vector<Particle*>& particles)
@@ -142,12 +1971,38 @@ void ParticleWorld::removeInactiveParticles(std::vector<Particle*>& particles)
 void ParticleWorld::releaseInactiveParticles()
 {
 
+	const size_t poolSize = m_particlePool.size();
+	uint32_t releasedTags = 0;
 	for (Particle* particle : m_activeParticles)
 	{
-		if (!particle->IsActive())	
+		if (!particle->IsActive())
+		{
 			m_particlePool.push_back(particle);
+			releasedTags |= particle->GetMembershipTags();
+		}
 	}
 	removeInactiveParticles(m_activeParticles);
+	m_pendingReleases = 0;
+	m_spatialIndexValid = false;
+
+	// A released particle may be spawned again before the next step, its
+	// contact generators and forces mustn't follow it into its new life
+	if (m_particlePool.size() > poolSize)
+		detachInactiveParticles(releasedTags);
+
+	// Particles may change their type after they were spawned
+	countActiveParticlesByType();
+}
+
+void ParticleWorld::expireParticles()
+{
+	ParticleFrameVector<Particle*> expired(&m_frameAllocator);
+	m_lifetimeWheel.Advance(m_time, expired);
+	for (Particle* particle : expired)
+	{
+		particle->SetActive(false);
+	}
+	m_lastExpired = static_cast<int>(expired.size());
 }
 
 void ParticleWorld::disableActiveParticleOutOfLevelBounds()
@@ -182,3 +2037,23 @@ void ParticleWorld::DestroyAllBalls()
 {
 	destroyAllOfType(ParticleTypes::Ball);
 }
+
+bool ParticleWorld::isSteadyStateStep(const int& usedContacts, const int& contactArenaGrowCount)
+{
+	// Same load as in the step before and none of the scratch memory had
+	// to grow
+	const bool steadyState = usedContacts == m_previousStepContacts &&
+		m_activeParticles.size() == m_previousStepParticles &&
+		m_contactArena.GetGrowCount() == contactArenaGrowCount &&
+		!m_frameAllocator.HasOverflowed();
+
+	m_previousStepContacts = usedContacts;
+	m_previousStepParticles = m_activeParticles.size();
+	return steadyState;
+}
+
+void ParticleWorld::waitForBackgroundRead()
+{
+	std::unique_lock<std::mutex> lock(m_backgroundReadMutex);
+	m_backgroundReadDone.wait(lock, [this]() { return !m_backgroundRead; });
+}
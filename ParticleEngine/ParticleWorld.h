@@ -2,6 +2,13 @@
 #include "ParticleContact.h"
 #include "ParticleContactGenerators.h"
 #include "ParticleContactResolver.h"
+#include "ParticleContactArena.h"
+#include "ParticleFrameAllocator.h"
+#include "ParticleLifetimeWheel.h"
+#include "ParticleForceField.h"
+#include "ParticleCommandBuffer.h"
+#include "ParticleContactEvents.h"
+#include "ParticleSpatialIndex.h"
 
 struct LevelBounds
 {
@@ -10,9 +17,105 @@ struct LevelBounds
 	float MinY;
 	float MaxY;
 };
+
+/**
+* Contact telemetry of one registered contact generator.
+*/
+struct ParticleContactGeneratorReport
+{
+	// Contacts written in the last step
+	int Contacts = 0;
+	// How often the generator had to run again in the last step because
+	// the contact arena had to grow
+	int Regenerations = 0;
+	// True if the arena was at its maximum capacity and the generator
+	// may have lost contacts in the last step
+	bool Truncated = false;
+	// Steps with lost contacts since the world was created
+	int TruncatedSteps = 0;
+};
+
+/**
+* Work and effect of the Z-order reordering of the particle storage.
+* Locality is the share of active particles whose successor along the
+* Z-order curve is stored at most ParticleWorld::LocalityWindow slots
+* away, 1 right after a reorder.
+*/
+struct ParticleReorderStats
+{
+	int Reorders = 0;
+	float LocalityBefore = 0;
+	float LocalityAfter = 0;
+	double LastMilliseconds = 0;
+	double TotalMilliseconds = 0;
+};
+
+/**
+* What the pool does when a particle type can't get a particle, because
+* the pool is empty apart from the slots reserved for other types or the
+* type reached its quota.
+*/
+enum class ParticlePoolExhaustionPolicy
+{
+	// No particle
+	Fail,
+	// The pool grows, up to its maximum size. Doesn't help against the
+	// quota
+	Grow,
+	// Recycles the particles which were spawned first, of types with a
+	// lower priority, or of the same type when the quota is reached
+	RecycleOldest,
+	// The same with the particles furthest from the level of detail view
+	RecycleFurthest
+};
+
+/**
+* How a particle type shares the pool. Recycled particles are taken out
+* of the contact generators and the force registry of the world at once,
+* particles which are connected to others by force generators should
+* have a type which nothing recycles.
+*/
+struct ParticlePoolPolicy
+{
+	// Most particles of the type which may be active at once
+	int Quota = std::numeric_limits<int>::max();
+	// Free slots no other type may take
+	int Reserved = 0;
+	// Types only recycle the particles of types with a lower priority
+	int Priority = 0;
+	ParticlePoolExhaustionPolicy OnExhausted = ParticlePoolExhaustionPolicy::Fail;
+};
+
+/**
+* Pool occupancy of one particle type.
+*/
+struct ParticlePoolTypeReport
+{
+	int Active = 0;
+	// Particles which were asked for but not handed out, since the world
+	// was created
+	int Failed = 0;
+	// Particles of the type which were recycled for others
+	int Recycled = 0;
+};
+
+/**
+* A particle and the serial it was spawned with, see
+* ParticleWorld::recycleParticles.
+*/
+struct ParticleSpawnRecord
+{
+	Particle* Spawned;
+	unsigned Serial;
+};
+
 class ParticleWorld
 {
 public:
+	/**
+	* maxContactsPerFrame is the hard limit of the contact arena, which
+	* starts small and grows on demand.
+	*/
 	ParticleWorld(const int& maxContactsPerFrame, const int& poolSize, const LevelBounds& levelBounds, const int& contactResolutionIterations = 0);
 	~ParticleWorld();
 
@@ -20,10 +123,279 @@ public:
 	void RunPhysics(const float& deltaTime);
 
 	std::vector<Particle*>& GetActiveParticles();
-	std::vector<ParticleContactGenerator*>& GetContactGenerators();
+	const std::vector<ParticleContactGenerator*>& GetContactGenerators() const;
+
+	/**
+	* Registers a contact generator and hands it the frame allocator and
+	* its membership tag, see ParticleManagement. The tag is the lowest
+	* one no other generator holds, a generator gets none once all are
+	* taken. Inactive particles stay in the generators until StartFrame
+	* releases them, so a generator which deactivates particles should be
+	* registered last.
+	*/
+	void AddContactGenerator(ParticleContactGenerator* contactGenerator);
+
+	/**
+	* Unregisters a contact generator. Its particles lose its tag and the
+	* tag is free for the next generator.
+	*/
+	void RemoveContactGenerator(ParticleContactGenerator* contactGenerator);
+
+	/**
+	* Scratch memory of the current step, reset by StartFrame.
+	*/
+	ParticleFrameAllocator& GetFrameAllocator();
 	ParticleForceRegistry& GetForceRegistry();
+	const ParticleContactArena& GetContactArena() const;
+
+	/**
+	* Reports of the contact generators, in the order of
+	* GetContactGenerators().
+	*/
+	const std::vector<ParticleContactGeneratorReport>& GetContactGeneratorReports() const;
+
+	void SetContactResolverMode(const ParticleContactResolverMode& mode, const unsigned& batchSweeps = 4);
+	ParticleContactResolverMode GetContactResolverMode() const;
+
+	/**
+	* Bounds the work of the contact resolution per step: contacts below
+	* the tolerances count as resolved and the resolver stops when the
+	* budget (in seconds, zero for none) is used up, even if it hasn't
+	* used all of its iterations yet.
+	*/
+	void SetContactResolutionTolerance(const float& penetration, const float& closingVelocity);
+	void SetContactResolutionBudget(const float& seconds);
+	ParticleContactResolverStopReason GetLastContactResolutionStopReason() const;
+	unsigned GetLastContactResolutionIterations() const;
+
+	/**
+	* Contacts of a particle with the scenery which share their particle
+	* with no other contact are resolved in closed form, only the coupled
+	* contacts go through the contact resolver. Enabled by default.
+	*/
+	void SetIsolatedContactFastPathEnabled(const bool& enabled);
+	int GetLastIsolatedContactCount() const;
+
+	/**
+	* Particles fall asleep together with everything they touch or are
+	* connected to by a force generator once all of them moved slower
+	* than sleepSpeed on average for sleepFrames frames in a row, that is
+	* none of them left the circle it would cover at that speed. Enabled
+	* by default.
+	*/
+	void SetSleepEnabled(const bool& enabled);
+	void SetSleepThreshold(const float& sleepSpeed, const int& sleepFrames);
+	void WakeAllParticles();
+	int GetSleepingParticleCount() const;
+
+	/**
+	* Level of detail by the distance to the view, usually the part of
+	* the level the camera shows. Particles within bandWidth of the view
+	* are integrated in every step, every band further away doubles
+	* their interval up to maxInterval, which has to be a power of two.
+	* They are integrated over the time of the skipped steps and don't
+	* collide with other particles while their interval is above one.
+	* Particles are staggered by the order they were spawned in, see
+	* Particle::SetLodStagger, so every step integrates the same share of
+	* the far ones. Types which matter for the game can opt out. Disabled
+	* by default.
+	*/
+	void SetLodEnabled(const bool& enabled);
+	void SetLodView(const LevelBounds& view);
+	void SetLodBands(const float& bandWidth, const int& maxInterval);
+	void SetLodTypeEnabled(const ParticleTypes& type, const bool& enabled);
+	int GetLastLodDeferredCount() const;
+
+	/**
+	* Launches a particle on a ballistic flight, see Particle::Launch,
+	* and returns false if it is too close to the scenery of a contact
+	* generator to fly. The world checks the flight against the
+	* scenery bounds of its generators for horizon seconds ahead at a
+	* time and integrates the particle again once it comes close.
+	*/
+	bool LaunchBallistic(Particle* particle);
+	int LaunchBallistic(Particle* const* particles, const int& count);
+	void SetBallisticHorizon(const float& seconds);
+	int GetLastBallisticCount() const;
+
+	/**
+	* The particle expires after the given seconds of world time and
+	* StartFrame returns it to the pool, zero or less expires it in the
+	* next frame. Expiries are kept in a timing wheel, so a frame only
+	* pays for the particles which expire in it.
+	*/
+	void SetParticleLifetime(Particle* particle, const float& seconds);
+	void ClearParticleLifetime(Particle* particle);
+	int GetLastExpiredCount() const;
+
+	/**
+	* Queries over the active particles, see ParticleSpatialIndex. The
+	* first query after the particles were stepped, spawned or released
+	* builds the index, so particles moved by hand since are found where
+	* they were. The single queries append to their output, the batched
+	* ones replace it and write where the results of every query start,
+	* one more offset than queries at the end.
+	*/
+	int QueryRadius(const DirectX::SimpleMath::Vector3& center, const float& radius, std::vector<Particle*>& outParticles, const unsigned& typeMask = ~0u);
+	int QueryBox(const DirectX::SimpleMath::Vector3& minimum, const DirectX::SimpleMath::Vector3& maximum, std::vector<Particle*>& outParticles, const unsigned& typeMask = ~0u);
+	int QueryNearest(const DirectX::SimpleMath::Vector3& point, const int& count, std::vector<Particle*>& outParticles, const unsigned& typeMask = ~0u);
+	ParticleRayHit Raycast(const ParticleRay& ray, const unsigned& typeMask = ~0u);
+	int RaycastAll(const ParticleRay& ray, std::vector<ParticleRayHit>& outHits, const unsigned& typeMask = ~0u);
+
+	void QueryRadius(const ParticleRadiusQuery* queries, const int& queryCount, std::vector<Particle*>& outParticles, std::vector<int>& outOffsets, const unsigned& typeMask = ~0u);
+	void QueryBox(const ParticleBoxQuery* queries, const int& queryCount, std::vector<Particle*>& outParticles, std::vector<int>& outOffsets, const unsigned& typeMask = ~0u);
+	void QueryNearest(const DirectX::SimpleMath::Vector3* points, const int& queryCount, const int& count, std::vector<Particle*>& outParticles, std::vector<int>& outOffsets, const unsigned& typeMask = ~0u);
+
+	/**
+	* One hit for every ray, without a target if it missed.
+	*/
+	void Raycast(const ParticleRay* rays, const int& queryCount, std::vector<ParticleRayHit>& outHits, const unsigned& typeMask = ~0u);
+	void RaycastAll(const ParticleRay* rays, const int& queryCount, std::vector<ParticleRayHit>& outHits, std::vector<int>& outOffsets, const unsigned& typeMask = ~0u);
+
+	/**
+	* 32 by default.
+	*/
+	void SetSpatialIndexCellSize(const float& cellSize);
+
+	/**
+	* Touching pairs of the contact generators which collide particles
+	* with each other, as Begin, Persist and End events. The narrowphase
+	* only records the pairs; after all contacts are generated the world
+	* tells the new pairs from the persisting ones, works out their
+	* impulse, destroys particles as the interaction table says and
+	* hands the events to the listeners. Particles of the events are
+	* valid until the next StartFrame.
+	*
+	* Resting particles keep coming in and out of touch by a tiny bit,
+	* so a pair only ends once its particles are further apart than the
+	* slop. Pairs of two sleeping particles keep touching.
+	*/
+	void AddContactEventListener(ParticleContactEventListener* listener);
+	const ParticleContactEventStream& GetContactEvents() const;
+	void SetContactEventCapacity(const int& capacity);
+	int GetLastContactDestroyedCount() const;
+
+	/**
+	* Events of the last step which didn't fit into the stream. The world
+	* reports the first step which drops events, as it reports a full
+	* contact arena.
+	*/
+	int GetLastDroppedContactEventCount() const;
+	void SetContactEventSlop(const float& slop);
+
+	/**
+	* Commands queued here are applied at the start of StartFrame and of
+	* RunPhysics. The buffer may be used from any thread, the world
+	* itself only from the one which runs it.
+	*/
+	ParticleCommandBuffer& GetCommandBuffer();
+	int GetLastAppliedCommandCount() const;
+
+	/**
+	* Force fields accelerate the particles of their types while the
+	* world integrates them, on top of the acceleration of each particle.
+	* The uniform fields of a type are summed up whenever a field changes,
+	* so switching a field on or off doesn't touch the particles. The
+	* next step wakes the sleeping particles of the types whose fields
+	* changed and launches their ballistic particles anew. Ballistic
+	* flights end where they would enter a field which isn't uniform.
+	* Returns the handle of the field.
+	*/
+	int AddForceField(const ParticleForceField& field);
+	void SetForceField(const int& handle, const ParticleForceField& field);
+	void SetForceFieldEnabled(const int& handle, const bool& enabled);
+	const ParticleForceField& GetForceField(const int& handle) const;
+
+	/**
+	* The sum of the enabled uniform fields which act on the type.
+	*/
+	DirectX::SimpleMath::Vector3 GetUniformFieldAcceleration(const ParticleTypes& type) const;
 
-	Particle* GetNewParticle();
+	/**
+	* Writes the particle storage, the pool, the force fields, the force
+	* registrations, the members of the contact generators and the
+	* touching pairs to a snapshot of contiguous blocks, see
+	* ParticleSnapshotHeader. The settings of the world aren't part of it.
+	*
+	* The generators belong to the game and keep their own state, for
+	* example the snow a deposit baked. A snapshot is restored into a
+	* world with the same contact generators in the same order, whose
+	* force registry knows the same force generators, as a world set up
+	* by the same code has. Otherwise, or if the snapshot is broken or of
+	* another build, RestoreSnapshot returns false and leaves the world
+	* as it is. The storage grows to the size of the snapshot but doesn't
+	* shrink, queued commands stay queued and the unread contact events
+	* are dropped. The snapshot may be a mapped file, see
+	* ParticleSnapshotFile.
+	*
+	* Particles which stopped since the last StartFrame are saved as the
+	* next sweep leaves them, in the pool and out of the generators, the
+	* registry and the touching pairs. A restore checks that every slot
+	* is either in the pool and stopped or active and listed once.
+	*/
+	void SaveSnapshot(std::vector<uint8_t>& outSnapshot) const;
+	bool RestoreSnapshot(const void* snapshot, const size_t& size);
+
+	/**
+	* A task may read the world in the background between the two calls,
+	* SaveSnapshot for one, while the thread which runs the world goes on
+	* with other work. StartFrame, RunPhysics and RestoreSnapshot wait
+	* for EndBackgroundRead, nothing else may change the world before.
+	*/
+	void BeginBackgroundRead();
+	void EndBackgroundRead();
+
+	/**
+	* Particles are stored in spawn order, so after a while neighbours in
+	* the level are scattered all over the storage. Reordering moves the
+	* active particles to the front of the storage along a Z-order curve
+	* over the level bounds and remaps every particle pointer held by the
+	* world, its contact generators and the force registry. Pointers to
+	* particles kept anywhere else are invalid afterwards.
+	*
+	* StartFrame reorders every interval frames and when the locality
+	* drops below the threshold; zero disables either trigger. Both are
+	* disabled by default.
+	*/
+	void SetParticleReorderInterval(const int& frames);
+	void SetParticleReorderLocalityThreshold(const float& locality);
+	void ReorderParticles();
+	float MeasureParticleLocality();
+	const ParticleReorderStats& GetParticleReorderStats() const;
+
+	static const int LocalityWindow = 8;
+
+	/**
+	* A particle of the given type with the default state of a particle,
+	* nullptr if the pool policy of the type doesn't give one.
+	*/
+	Particle* GetNewParticle(const ParticleTypes& type = ParticleTypes::None);
+
+	/**
+	* Takes up to count particles of the type of the prototype from the
+	* pool at once, copies the prototype into them, active and awake, and
+	* writes them to outParticles. Returns how many particles the pool
+	* policy of the type gave.
+	*/
+	int GetNewParticles(const Particle& prototype, const int& count, Particle** outParticles);
+
+	/**
+	* Every type has its own pool policy, all of them fail by default.
+	* Growing the pool moves the particle storage and remaps the particle
+	* pointers like ReorderParticles does. The pool grows to at most four
+	* times its initial size by default.
+	*/
+	void SetPoolPolicy(const ParticleTypes& type, const ParticlePoolPolicy& policy);
+	const ParticlePoolPolicy& GetPoolPolicy(const ParticleTypes& type) const;
+	void SetMaxPoolSize(const int& size);
+	int GetPoolCapacity() const;
+	int GetFreePoolCount() const;
+	const ParticlePoolTypeReport& GetPoolReport(const ParticleTypes& type) const;
+
+	/**
+	* The particle stops at once, the next StartFrame returns it to the
+	* pool together with all other inactive particles.
+	*/
 	void ReleaseParticle(Particle* particle);
 
 	void DestroyAllSnow();
@@ -31,22 +403,237 @@ public:
 
 protected:
 	void integrateAllParticles(const float& deltaTime);
+
+	/**
+	* The spatial index, built if it isn't up to date.
+	*/
+	ParticleSpatialIndex& spatialIndex();
+	DirectX::SimpleMath::Vector3 fieldAccelerationOf(const Particle* particle) const;
+
+	/**
+	* Replaces a field and remembers the types it changed for, the sums
+	* of the uniform fields are left to updateUniformFieldAcceleration.
+	*/
+	void replaceForceField(const int& handle, const ParticleForceField& field);
+	void updateUniformFieldAcceleration();
+
+	/**
+	* Applies the queued commands, see ParticleCommandBuffer.
+	*/
+	void applyCommands();
+	void applySpawnCommands();
+	int lodIntervalOf(const Particle* particle) const;
+
+	typedef std::pair<DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3> SceneryBox;
+	void gatherSceneryBounds(ParticleFrameVector<SceneryBox>& outBoxes) const;
+
+	/**
+	* Checks the flight of a ballistic particle between the two times
+	* against the scenery, on success the particle may fly until then.
+	*/
+	bool clearFlight(Particle* particle, const float& from, const float& to, const ParticleFrameVector<SceneryBox>& scenery) const;
 	int generateContactsWithRegisteredContactGeneratorsAndReturnNumOfContacts();
 
+	/**
+	* Turns the pairs the narrowphase pushed since the given position into
+	* Begin and Persist events, ends the pairs which stopped touching,
+	* applies the interaction table and notifies the listeners.
+	*/
+	void processContactEvents(const uint32_t& stepBegin);
+	bool keepsTouching(const std::pair<Particle*, Particle*>& pair) const;
+	void endTouchingPairsOfInactiveParticles();
+	static std::pair<Particle*, Particle*> touchingPairOf(const ParticleContactEvent& event);
+	void reportTruncatedContactGenerator(const size_t& generatorIndex);
+	void reportDroppedContactEvents(const int& dropped);
+
+	/**
+	* Takes the contacts of particles the interaction table destroyed out
+	* of the arena, the others keep their order. Returns the number of
+	* contacts left.
+	*/
+	int removeContactsOfInactiveParticles(const int& usedContacts);
+
+	/**
+	* Moves the isolated contacts of a particle with the scenery behind
+	* the coupled ones, which keep their order, and returns the number
+	* of coupled contacts. Contacts of particles which don't live in the
+	* storage are coupled.
+	*/
+	int partitionIsolatedContacts(const int& usedContacts);
+
+	/**
+	* Wakes sleeping particles which are touched by an awake particle,
+	* before the contacts are resolved.
+	*/
+	void wakeTouchedParticles(const int& usedContacts);
+
+	/**
+	* Groups the awake particles into islands of touching and connected
+	* particles and puts the islands to sleep which have been resting
+	* long enough.
+	*/
+	void updateSleepingParticles(const int& usedContacts, const float& deltaTime);
+
+	/**
+	* Index of the particle in the storage, -1 if it doesn't live there.
+	*/
+	int storageIndexOf(const Particle* particle) const;
+
+	/**
+	* Fills outOrder with the Morton code and storage index of every
+	* active particle, sorted by the code.
+	*/
+	void sortActiveParticlesAlongZOrder(ParticleFrameVector<std::pair<uint32_t, int>>& outOrder) const;
+	float measureLocality(const ParticleFrameVector<std::pair<uint32_t, int>>& order) const;
+	bool shouldReorderParticles();
+
 	void createParticlePool(const int& poolSize);
+
+	/**
+	* Free slots the type may take, the ones reserved for the other types
+	* excluded.
+	*/
+	int freeSlotsFor(const ParticleTypes& type) const;
+	int takeFromPool(const Particle& prototype, const int& count, Particle** outParticles);
+
+	/**
+	* Turns the slots into freshly spawned copies of the prototype. The
+	* prototype is made ready to spawn once and copied over each run of
+	* slots lying next to each other in the storage in one write, only
+	* the LOD stagger differs between them.
+	*/
+	void spawnParticles(const Particle& prototype, Particle* const* slots, const int& count, Particle** outParticles);
+	bool growPool(const int& extra);
+
+	/**
+	* Turns up to count active particles into copies of the prototype,
+	* the oldest or furthest ones of the types with a lower priority, or
+	* of the type of the prototype if sameType is set. The oldest are
+	* taken from the front of the spawn order, the furthest are searched
+	* among all active particles.
+	*/
+	int recycleParticles(const Particle& prototype, const int& count, const bool& sameType, Particle** outParticles);
+
+	/**
+	* A record of the spawn order is current while its particle is active
+	* and wasn't spawned again, its LOD stagger is the serial of its
+	* spawn.
+	*/
+	static bool isCurrentSpawn(const ParticleSpawnRecord& record);
+	void compactSpawnOrder();
+	void rebuildSpawnOrder();
+	void countActiveParticlesByType();
+
+	/**
+	* Takes the inactive particles out of the contact generators with one
+	* of the tags, or without a tag, and out of the force registry.
+	*/
+	void detachInactiveParticles(const uint32_t& tags);
+
+	/**
+	* Replaces the particle pointers of the world, its contact generators,
+	* the force registry and the lifetime wheel.
+	*/
+	void remapParticles(const ParticleRemap& remap);
 	static void removeInactiveParticles(std::vector<Particle*>& particles);
 	void releaseInactiveParticles();
+	void expireParticles();
 	void disableActiveParticleOutOfLevelBounds();
 	void destroyAllOfType(ParticleTypes type);
+	bool isSteadyStateStep(const int& usedContacts, const int& contactArenaGrowCount);
+	void waitForBackgroundRead();
 
+	// All particles live in this storage, the pool and the active list
+	// point into it
+	std::vector<Particle> m_particleStorage;
 	std::vector<Particle*> m_particlePool;
 	std::vector<Particle*> m_activeParticles;
+	// Every spawn in the order it happened, the records before the head
+	// are stale. Compacted when it would have to grow, it never holds more
+	// than twice the storage
+	std::vector<ParticleSpawnRecord> m_spawnOrder;
+	size_t m_spawnOrderHead = 0;
+	// Particles ReleaseParticle stopped since the last sweep
+	int m_pendingReleases = 0;
 	bool m_shouldCalculateIterations = false;
 	ParticleForceRegistry m_registry;
 	ParticleContactResolver m_contactResolver;
 	std::vector<ParticleContactGenerator*> m_contactGenerators;
-	ParticleContact* m_contacts = nullptr;
-	int m_maxContacts = 0;
+	// Membership tags no contact generator holds
+	uint32_t m_freeTags = ~0u;
+	ParticleFrameAllocator m_frameAllocator;
+	ParticleContactArena m_contactArena;
+	std::vector<ParticleContactGeneratorReport> m_contactGeneratorReports;
 	LevelBounds m_levelBounds;
+
+	bool m_isolatedContactFastPath = true;
+	int m_lastIsolatedContacts = 0;
+
+	bool m_sleepEnabled = true;
+	float m_sleepSpeed = 10.f;
+	int m_sleepFrames = 30;
+
+	bool m_lodEnabled = false;
+	LevelBounds m_lodView = {};
+	float m_lodBandWidth = 200.f;
+	int m_lodMaxInterval = 8;
+	bool m_lodTypes[ParticleTypeCount] = { true, true, true, true };
+	unsigned m_lodStep = 0;
+	unsigned m_nextLodStagger = 0;
+	int m_lastLodDeferred = 0;
+
+	// Time since the world was created, ballistic flights start from it
+	float m_time = 0;
+	float m_ballisticHorizon = 0.25f;
+	int m_lastBallistic = 0;
+
+	std::vector<ParticleForceField> m_forceFields;
+	DirectX::SimpleMath::Vector3 m_uniformFieldAcceleration[ParticleTypeCount];
+	// Enabled fields which aren't uniform, the integration only looks
+	// them up if there are any
+	int m_spatialForceFields = 0;
+	// Categories of the types whose fields changed since the last step
+	unsigned m_changedFieldTypes = 0;
+
+	ParticleSpatialIndex m_spatialIndex;
+	bool m_spatialIndexValid = false;
+	float m_spatialIndexCellSize = 32.f;
+
+	ParticleContactEventStream m_contactEvents;
+	std::vector<ParticleContactEventListener*> m_contactEventListeners;
+	// The pairs which touched in the last step, lower address first,
+	// sorted
+	std::vector<std::pair<Particle*, Particle*>> m_touchingPairs;
+	// Where the events the listeners haven't heard of yet start
+	uint32_t m_contactEventsNotified = 0;
+	int m_lastContactDestroyed = 0;
+	int m_lastDroppedContactEvents = 0;
+	float m_contactEventSlop = 0.5f;
+
+	ParticleCommandBuffer m_commandBuffer;
+	ParticleCommandBuffer::Batch m_commandBatch;
+	int m_lastAppliedCommands = 0;
+
+	ParticleLifetimeWheel m_lifetimeWheel;
+	int m_lastExpired = 0;
+
+	ParticlePoolPolicy m_poolPolicies[ParticleTypeCount];
+	ParticlePoolTypeReport m_poolReports[ParticleTypeCount];
+	int m_maxPoolSize = 0;
+
+	int m_reorderInterval = 0;
+	float m_reorderLocalityThreshold = 0;
+	int m_framesSinceReorder = 0;
+	std::vector<int> m_reorderNewIndices;
+	ParticleReorderStats m_reorderStats;
+
+	// Load of the previous step, to tell if a step is in a steady state
+	int m_previousStepContacts = -1;
+	size_t m_previousStepParticles = 0;
+
+	// Set while a task reads the world in the background
+	std::mutex m_backgroundReadMutex;
+	std::condition_variable m_backgroundReadDone;
+	bool m_backgroundRead = false;
 };
 
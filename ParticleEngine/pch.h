@@ -39,6 +39,14 @@
 #include <exception>
 #include <memory>
 #include <stdexcept>
+#include <unordered_map>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <ppl.h>
 
 #include <stdio.h>
 
@@ -95,7 +103,14 @@ namespace DX
 //my own classes
 #include "Camera.h"
 #include "Particle.h"
+#include "ParticleCollisionFilter.h"
+#include "ParticleFrameAllocator.h"
 #include "ParticleForceRegistry.h"
+#include "ParticleLifetimeWheel.h"
+#include "ParticleForceField.h"
+#include "ParticleCommandBuffer.h"
+#include "ParticleContactEvents.h"
+#include "ParticleSpatialIndex.h"
 #include "ParticleRenderer.h"
 #include "ParticleForceGenerator.h"
 #include "ParticleGravityForceGenerator.h"
@@ -103,8 +118,15 @@ namespace DX
 #include "ParticleDragForceGenerator.h"
 #include "ParticleBungeeForceGenerator.h"
 #include "ParticleWorld.h"
+#include "ParticleSnapshot.h"
+#include "ParticleRewindRecorder.h"
 #include "ParticleContact.h"
 #include "ParticleContactResolver.h"
+#include "ParticleContactArena.h"
+#include "ParticleNarrowphase.h"
 #include "ParticleContactGenerators.h"
+#include "ParticleSnowDeposit.h"
 #include "Platform.h"
+#include "ParticleEmitter.h"
 #include "BlizzardParticleEmitter.h"
+#include "ParticleBenchmark.h"